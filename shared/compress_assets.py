@@ -0,0 +1,41 @@
+Import("env")
+import gzip
+import os
+import shutil
+
+# Web UI sources live in src/data. The filesystem image is built from a
+# copy where text assets are gzip-compressed, so the firmware can send
+# them as-is with Content-Encoding: gzip.
+source_dir = os.path.join(env["PROJECT_DIR"], "src", "data")
+output_dir = os.path.join(env["PROJECT_DIR"], ".pio", "data")
+compressed_types = (".html", ".js", ".css")
+
+os.makedirs(output_dir, exist_ok=True)
+produced = set()
+
+for name in sorted(os.listdir(source_dir)):
+  source = os.path.join(source_dir, name)
+  if not os.path.isfile(source):
+    continue
+
+  if name.endswith(compressed_types):
+    target_name = name + ".gz"
+    target = os.path.join(output_dir, target_name)
+    if not os.path.exists(target) or os.path.getmtime(target) < os.path.getmtime(source):
+      with open(source, "rb") as src, open(target, "wb") as raw:
+        # mtime=0 keeps the output byte-identical between builds
+        with gzip.GzipFile(filename="", mode="wb", compresslevel=9, fileobj=raw, mtime=0) as dst:
+          shutil.copyfileobj(src, dst)
+      print(f'Compressed {name}: {os.path.getsize(source)} -> {os.path.getsize(target)} bytes')
+  else:
+    target_name = name
+    shutil.copy2(source, os.path.join(output_dir, target_name))
+
+  produced.add(target_name)
+
+# Drop leftovers of renamed or removed assets
+for name in os.listdir(output_dir):
+  if name not in produced:
+    os.remove(os.path.join(output_dir, name))
+
+env.Replace(PROJECT_DATA_DIR=output_dir)
@@ -0,0 +1,319 @@
+#!/usr/bin/env python3
+# Soak and latency run against a board on the bench.
+#
+# Publishes pulse commands to a local MQTT broker (mosquitto is enough),
+# keeps several HTTP clients busy on /, /temp and /button_state, optionally
+# pulses a second output through /trigger, and samples /metrics while it
+# runs. /trigger must use another pin than the --topic button: commands on
+# one pin closer than the pulse length replace each other and would show up
+# in pcc_pulses_replaced_total. Command latency is measured by the
+# firmware itself, from message arrival to the pin edge, so the numbers do
+# not include broker or Wi-Fi delays. The result is one JSON document on
+# stdout (or --output) so runs of different releases can be diffed.
+#
+#   python3 shared/soak.py --device 192.168.1.50 --broker 127.0.0.1 \
+#     --topic esp32/power --trigger-pin 27 --run 3600 > soak-1.2.3.json
+import argparse
+import http.client
+import json
+import re
+import socket
+import struct
+import sys
+import threading
+import time
+from collections import Counter
+
+METRIC_LINE = re.compile(r'^([a-zA-Z_:][a-zA-Z0-9_:]*)(\{[^}]*\})?\s+(\S+)$')
+
+
+def scrape(host, timeout=10):
+  """Fetch /metrics as {"name{labels}": value}."""
+  conn = http.client.HTTPConnection(host, timeout=timeout)
+  try:
+    conn.request("GET", "/metrics")
+    body = conn.getresponse().read().decode()
+  finally:
+    conn.close()
+  values = {}
+  for line in body.splitlines():
+    match = METRIC_LINE.match(line)
+    if match:
+      values[match.group(1) + (match.group(2) or "")] = float(match.group(3))
+  return values
+
+
+def fetch_json(host, path, timeout=10):
+  conn = http.client.HTTPConnection(host, timeout=timeout)
+  try:
+    conn.request("GET", path)
+    return json.loads(conn.getresponse().read())
+  finally:
+    conn.close()
+
+
+def percentile(counts, q):
+  """Quantile of {value: count}, for long runs without keeping every sample."""
+  total = sum(counts.values())
+  if not total:
+    return None
+  seen = 0
+  for value in sorted(counts):
+    seen += counts[value]
+    if seen >= q * total:
+      return value
+  return None
+
+
+def histogram_quantile(start, end, name, q):
+  """Quantile of the observations made between two scrapes, in seconds,
+  interpolated inside the bucket like Prometheus does."""
+  buckets = []
+  for key, value in end.items():
+    match = re.match(re.escape(name) + r'_bucket\{le="([^"]+)"\}$', key)
+    if match:
+      bound = float("inf") if match.group(1) == "+Inf" else float(match.group(1))
+      buckets.append((bound, value - start.get(key, 0)))
+  buckets.sort()
+  total = buckets[-1][1] if buckets else 0
+  if total <= 0:
+    return None
+  rank = q * total
+  highest = end.get(name.replace("_seconds", "_max_seconds"))
+  lower, below = 0.0, 0
+  for bound, count in buckets:
+    if count >= rank:
+      if bound == float("inf"):
+        return highest if highest is not None else lower
+      inside = count - below
+      value = lower + (bound - lower) * ((rank - below) / inside if inside else 1)
+      return min(value, highest) if highest is not None else value
+    lower, below = bound, count
+  return None
+
+
+def delta(start, end, key):
+  return int(end.get(key, 0) - start.get(key, 0))
+
+
+class MqttPublisher:
+  """Minimal MQTT 3.1.1 client: CONNECT and QoS 0 PUBLISH only."""
+
+  def __init__(self, host, port, client_id):
+    self.sock = socket.create_connection((host, port), timeout=10)
+    payload = self.string("MQTT") + bytes([4, 2]) + struct.pack("!H", 60) + self.string(client_id)
+    self.send(0x10, payload)
+    ack = self.sock.recv(4)
+    if len(ack) < 4 or ack[0] != 0x20 or ack[3] != 0:
+      raise RuntimeError("MQTT connect refused")
+    self.last = time.monotonic()
+
+  @staticmethod
+  def string(text):
+    data = text.encode()
+    return struct.pack("!H", len(data)) + data
+
+  def send(self, header, payload):
+    length, encoded = len(payload), bytearray()
+    while True:
+      byte, length = length % 128, length // 128
+      encoded.append(byte | (0x80 if length else 0))
+      if not length:
+        break
+    self.sock.sendall(bytes([header]) + bytes(encoded) + payload)
+
+  def publish(self, topic, message):
+    self.send(0x30, self.string(topic) + message.encode())
+    if time.monotonic() - self.last > 30:
+      self.send(0xC0, b"")  # PINGREQ, the answer is not read
+      self.last = time.monotonic()
+
+  def close(self):
+    try:
+      self.send(0xE0, b"")
+    finally:
+      self.sock.close()
+
+
+class HttpLoad(threading.Thread):
+  def __init__(self, host, paths, stop, stats, lock):
+    super().__init__(daemon=True)
+    self.host, self.paths, self.stop, self.stats, self.lock = host, paths, stop, stats, lock
+
+  def run(self):
+    conn, i = None, 0
+    while not self.stop.is_set():
+      route, path = self.paths[i % len(self.paths)]
+      i += 1
+      started = time.monotonic()
+      ok = False
+      try:
+        if conn is None:
+          conn = http.client.HTTPConnection(self.host, timeout=10)
+        conn.request("GET", path)
+        response = conn.getresponse()
+        response.read()
+        ok = response.status < 500
+      except (OSError, http.client.HTTPException):
+        if conn is not None:
+          conn.close()
+        conn = None
+      elapsed = time.monotonic() - started
+      with self.lock:
+        entry = self.stats.setdefault(route, {"latency": Counter(), "requests": 0, "errors": 0})
+        entry["latency"][round(elapsed * 1000, 1)] += 1
+        entry["requests"] += 1
+        if not ok:
+          entry["errors"] += 1
+    if conn is not None:
+      conn.close()
+
+
+class TriggerLoad(threading.Thread):
+  """/trigger at a fixed rate, one request in flight."""
+
+  def __init__(self, host, path, rate, stop, stats, lock):
+    super().__init__(daemon=True)
+    self.host, self.path, self.rate, self.stop, self.stats, self.lock = host, path, rate, stop, stats, lock
+    self.sent = 0
+
+  def run(self):
+    began, requests = time.monotonic(), 0
+    while not self.stop.is_set():
+      started = time.monotonic()
+      requests += 1
+      ok = False
+      conn = http.client.HTTPConnection(self.host, timeout=10)
+      try:
+        conn.request("GET", self.path)
+        response = conn.getresponse()
+        response.read()
+        ok = response.status == 200
+      except (OSError, http.client.HTTPException):
+        pass
+      finally:
+        conn.close()
+      elapsed = time.monotonic() - started
+      with self.lock:
+        entry = self.stats.setdefault("/trigger", {"latency": Counter(), "requests": 0, "errors": 0})
+        entry["latency"][round(elapsed * 1000, 1)] += 1
+        entry["requests"] += 1
+        if ok:
+          self.sent += 1
+        else:
+          entry["errors"] += 1
+      self.stop.wait(max(0, began + requests / self.rate - time.monotonic()))
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Soak and latency run against a board")
+  parser.add_argument("--device", required=True, help="board address, host[:port]")
+  parser.add_argument("--broker", default="127.0.0.1", help="MQTT broker the board is connected to")
+  parser.add_argument("--broker-port", type=int, default=1883)
+  parser.add_argument("--topic", required=True, help="command topic of an output button")
+  parser.add_argument("--trigger-pin", type=int,
+                      help="pin of another output button for /trigger, not the --topic one")
+  parser.add_argument("--pulse", type=int, default=50, help="pulse length, ms")
+  parser.add_argument("--run", type=float, default=600, help="run length, s")
+  parser.add_argument("--rate", type=float, default=5, help="MQTT commands per second")
+  parser.add_argument("--trigger-rate", type=float, default=2, help="/trigger requests per second")
+  parser.add_argument("--clients", type=int, default=4, help="concurrent HTTP clients")
+  parser.add_argument("--sample", type=float, default=30, help="/metrics sampling period, s")
+  parser.add_argument("--output", help="write the JSON here instead of stdout")
+  args = parser.parse_args()
+  # Spacing shorter than the pulse makes the board replace pending pulses
+  for rate, name in ((args.rate, "--rate"), (args.trigger_rate, "--trigger-rate")):
+    if rate <= 0 or 1000 / rate <= args.pulse:
+      parser.error(f"{name} must leave more than --pulse between commands")
+
+  info = fetch_json(args.device, "/api/info")
+  start = scrape(args.device)
+  samples = [(0.0, start)]
+
+  stop, lock, http_stats = threading.Event(), threading.Lock(), {}
+  paths = [("/", "/"), ("/temp", "/temp"), ("/button_state", "/button_state")]
+  workers = [HttpLoad(args.device, paths, stop, http_stats, lock) for _ in range(args.clients)]
+  trigger = None
+  if args.trigger_pin is not None:
+    trigger = TriggerLoad(args.device, f"/trigger?pin={args.trigger_pin}&duration={args.pulse}",
+                          args.trigger_rate, stop, http_stats, lock)
+    workers.append(trigger)
+  for worker in workers:
+    worker.start()
+
+  mqtt = MqttPublisher(args.broker, args.broker_port, f"soak-{int(time.time())}")
+  sent, began = 0, time.monotonic()
+  next_sample = began + args.sample
+  try:
+    while True:
+      now = time.monotonic()
+      if now - began >= args.run:
+        break
+      mqtt.publish(args.topic, str(args.pulse))
+      sent += 1
+      if now >= next_sample:
+        next_sample += args.sample
+        try:
+          samples.append((now - began, scrape(args.device)))
+        except OSError as error:
+          print(f"metrics scrape failed: {error}", file=sys.stderr)
+      time.sleep(max(0, began + sent / args.rate - time.monotonic()))
+  finally:
+    stop.set()
+    mqtt.close()
+    for worker in workers:
+      worker.join()
+
+  # Let the last pulses finish before the final scrape
+  time.sleep(max(1, args.pulse / 1000 * 2))
+  end = scrape(args.device)
+  samples.append((time.monotonic() - began, end))
+
+  heap = [{"t": round(t, 1), "free": m.get("pcc_heap_free_bytes"), "min_free": m.get("pcc_heap_min_free_bytes"),
+           "largest": m.get("pcc_heap_max_alloc_bytes"), "blocks": m.get("pcc_heap_allocated_blocks")}
+          for t, m in samples]
+  latency = "pcc_command_latency_seconds"
+  result = {
+    "device": info.get("device"),
+    "version": info.get("version"),
+    "run_seconds": round(time.monotonic() - began, 1),
+    "commands": {
+      "mqtt_sent": sent,
+      "mqtt_received": delta(start, end, "pcc_mqtt_messages_received_total"),
+      "trigger_sent": trigger.sent if trigger else 0,
+      "measured": delta(start, end, latency + "_count"),
+      "latency_p50_ms": None,
+      "latency_p99_ms": None,
+      "latency_max_ms": end.get("pcc_command_latency_max_seconds", 0) * 1000,
+      "dropped_queue": delta(start, end, 'pcc_queue_dropped_total{queue="actuation"}'),
+      "dropped_pin": delta(start, end, "pcc_pulses_dropped_total"),
+      "replaced": delta(start, end, "pcc_pulses_replaced_total"),
+    },
+    "http": {},
+    "heap": {
+      "free_drift": heap[-1]["free"] - heap[0]["free"] if heap[0]["free"] is not None else None,
+      "blocks_drift": heap[-1]["blocks"] - heap[0]["blocks"] if heap[0]["blocks"] is not None else None,
+      "samples": heap,
+    },
+  }
+  for q, key in ((0.5, "latency_p50_ms"), (0.99, "latency_p99_ms")):
+    value = histogram_quantile(start, end, latency, q)
+    result["commands"][key] = round(value * 1000, 3) if value is not None else None
+  for route, entry in sorted(http_stats.items()):
+    result["http"][route] = {
+      "requests": entry["requests"],
+      "errors": entry["errors"],
+      "p50_ms": percentile(entry["latency"], 0.5),
+      "p99_ms": percentile(entry["latency"], 0.99),
+    }
+
+  text = json.dumps(result, indent=2)
+  if args.output:
+    with open(args.output, "w") as out:
+      out.write(text + "\n")
+  else:
+    print(text)
+
+
+if __name__ == "__main__":
+  main()
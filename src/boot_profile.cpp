@@ -0,0 +1,52 @@
+#include "boot_profile.h"
+
+BootProfile bootProfile;
+
+BootProfile::BootProfile() : fastConnect(false), fastFallback(false), times{}, reachedMask(0) {
+}
+
+void BootProfile::mark(BootPhase phase, unsigned long now) {
+  if (reached(phase)) return;
+  times[phase] = now;
+  reachedMask |= 1u << phase;
+}
+
+const char *BootProfile::phaseName(BootPhase phase) {
+  switch (phase) {
+    case BOOT_FS: return "fs";
+    case BOOT_CONFIG: return "config";
+    case BOOT_WIFI_START: return "wifi_start";
+    case BOOT_TASKS: return "tasks";
+    case BOOT_WIFI: return "wifi";
+    case BOOT_SERVER: return "server";
+    case BOOT_MQTT: return "mqtt";
+    case BOOT_PHASE_COUNT: break;
+  }
+  return "unknown";
+}
+
+void BootProfile::render(Print &out) const {
+  out.print("# TYPE pcc_boot_phase_seconds gauge\n");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    BootPhase phase = (BootPhase)i;
+    if (reached(phase)) out.printf("pcc_boot_phase_seconds{phase=\"%s\"} %.3f\n", phaseName(phase), times[i] / 1e3);
+  }
+  out.print("# TYPE pcc_boot_wifi_fast_connect gauge\n");
+  out.printf("pcc_boot_wifi_fast_connect %d\n", fastConnect && !fastFallback ? 1 : 0);
+}
+
+// {"phases":{"fs":12,...},"fast_connect":true,"fast_fallback":false}
+void BootProfile::toJson(char *buffer, size_t size) const {
+  size_t len = snprintf(buffer, size, "{\"phases\":{");
+  bool first = true;
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT && len < size; i++) {
+    BootPhase phase = (BootPhase)i;
+    if (!reached(phase)) continue;
+    len += snprintf(buffer + len, size - len, "%s\"%s\":%lu", first ? "" : ",", phaseName(phase), times[i]);
+    first = false;
+  }
+  if (len < size) {
+    snprintf(buffer + len, size - len, "},\"fast_connect\":%s,\"fast_fallback\":%s}",
+             fastConnect ? "true" : "false", fastFallback ? "true" : "false");
+  }
+}
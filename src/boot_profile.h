@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Этапы загрузки в порядке прохождения
+enum BootPhase : uint8_t {
+  BOOT_FS,          // файловая система смонтирована
+  BOOT_CONFIG,      // конфигурация загружена и применена
+  BOOT_WIFI_START,  // запущено подключение к точке доступа
+  BOOT_TASKS,       // задачи, не зависящие от сети, запущены
+  BOOT_WIFI,        // получен IP
+  BOOT_SERVER,      // веб-сервер принимает запросы
+  BOOT_MQTT,        // первое подключение к брокеру
+  BOOT_PHASE_COUNT
+};
+
+// Отметки времени этапов загрузки, мс от старта. Каждый этап
+// отмечается один раз; отметки можно ставить из любой задачи.
+class BootProfile {
+public:
+  BootProfile();
+
+  void mark(BootPhase phase, unsigned long now);
+  bool reached(BootPhase phase) const { return reachedMask & (1u << phase); }
+  unsigned long at(BootPhase phase) const { return times[phase]; }
+
+  // Подключение по сохранённым BSSID и каналу; откат на полное сканирование
+  bool fastConnect;
+  bool fastFallback;
+
+  // Вывод в формате Prometheus и в JSON
+  void render(Print &out) const;
+  void toJson(char *buffer, size_t size) const;
+
+  static const char *phaseName(BootPhase phase);
+
+private:
+  unsigned long times[BOOT_PHASE_COUNT];
+  volatile uint32_t reachedMask;
+};
+
+extern BootProfile bootProfile;
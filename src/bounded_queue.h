@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Ограниченная очередь без блокировок для нескольких писателей и
+// читателей (схема Вьюкова: у каждой ячейки свой счётчик поколения).
+// При переполнении push() возвращает false, элемент не ставится.
+template <typename T, size_t N>
+class BoundedQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+public:
+  BoundedQueue() : head(0), tail(0), peak(0), droppedCount(0) {
+    for (size_t i = 0; i < N; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(const T &item) {
+    Cell *cell;
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & (N - 1)];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = item;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    uint32_t depth = size();
+    uint32_t seen = peak.load(std::memory_order_relaxed);
+    while (depth > seen && !peak.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+    }
+    return true;
+  }
+
+  bool pop(T &item) {
+    Cell *cell;
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & (N - 1)];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+    item = cell->data;
+    cell->sequence.store(pos + N, std::memory_order_release);
+    return true;
+  }
+
+  // Текущая глубина (приблизительно, если очередь используется параллельно)
+  uint32_t size() const {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_relaxed);
+    return t > h ? t - h : 0;
+  }
+  static constexpr size_t capacity() { return N; }
+  // Максимальная наблюдавшаяся глубина
+  uint32_t highWater() const { return peak.load(std::memory_order_relaxed); }
+  uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  Cell cells[N];
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<uint32_t> peak;
+  std::atomic<uint32_t> droppedCount;
+};
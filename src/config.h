@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/semphr.h>
+#include "fixed_string.h"
+#include "fixed_list.h"
+
+// Пины по умолчанию
+#define DEFAULT_ONE_WIRE_BUS 4 // Пин по умолчанию для подключения датчиков
+#define DEFAULT_SENSOR_RESOLUTION 12 // Разрешение датчиков по умолчанию, бит
+
+// Ёмкость списков конфигурации; больше элементов при загрузке не принимается
+#define CONFIG_MAX_BUTTONS 16
+#define CONFIG_MAX_SENSORS 16
+#define CONFIG_MAX_BUSES 4
+#define CONFIG_MAX_MACROS 8
+
+// Структура конфигурации для кнопок
+struct ButtonConfig {
+  FixedString<32> name;
+  int pin;
+  unsigned long duration;
+  FixedString<96> topic;
+  int mode;
+  unsigned long debounce;  // антидребезг входа, мс
+};
+
+typedef FixedList<ButtonConfig, CONFIG_MAX_BUTTONS> ButtonList;
+
+// Датчик температуры, адресуемый по ROM-коду. Нулевой адрес означает
+// "привязать к первому найденному датчику без настроек" - так переносятся
+// имена sensor1_name/sensor2_name из старых версий
+struct SensorConfig {
+  FixedString<32> name;
+  uint8_t address[8];
+  uint8_t resolution;  // 9-12 бит
+};
+
+// Макрос: имя, топик запуска MQTT (пустой - только HTTP) и текст шагов,
+// который компилируется при загрузке конфигурации (см. macro_engine.h)
+struct MacroConfig {
+  FixedString<32> name;
+  FixedString<96> topic;
+  FixedString<256> script;
+};
+
+// Структура основной конфигурации. Все строки и списки хранятся внутри
+// структуры, так что чтение и копирование конфигурации не трогают кучу.
+struct Config {
+  FixedString<32> ssid;
+  FixedString<64> password;
+  FixedString<64> mqtt_server;
+  FixedString<32> mqtt_user;
+  FixedString<64> mqtt_password;
+  // Статический IPv4 (0 - DHCP), первый октет в младшем байте
+  uint32_t static_ip = 0;
+  uint32_t static_gateway = 0;
+  uint32_t static_subnet = 0;
+  uint32_t static_dns = 0;
+  // Время жизни результатов сканирования Wi-Fi, с
+  uint16_t scan_ttl = 60;
+  FixedList<uint8_t, CONFIG_MAX_BUSES> oneWireBus_pins = {DEFAULT_ONE_WIRE_BUS};
+  FixedList<SensorConfig, CONFIG_MAX_SENSORS> sensors;
+  ButtonList buttons;
+  FixedList<MacroConfig, CONFIG_MAX_MACROS> macros;
+  // Автообновление: URL манифеста, период и разброс проверок (мин),
+  // окно обслуживания в часах UTC (start == end - без ограничений)
+  FixedString<128> update_url;
+  uint16_t update_interval = 0;
+  uint16_t update_jitter = 0;
+  uint8_t update_window_start = 0;
+  uint8_t update_window_end = 0;
+  // Группа для раскатки по MQTT: pcc/group/<ota_group>/ota
+  FixedString<32> ota_group;
+  // Период публикации метрик в MQTT, с (0 - не публиковать)
+  uint16_t metrics_interval = 0;
+  // Телеметрия: период пакетов (с, 0 - выкл), зона нечувствительности
+  // температуры (°C), период heartbeat (с, 0 - выкл)
+  uint16_t telemetry_interval = 60;
+  float telemetry_deadband = 0.5;
+  uint16_t heartbeat_interval = 300;
+};
+
+extern Config config;
+
+// Блокировка глобальной config. Её меняет только сетевая задача и только
+// под блокировкой, поэтому сама сетевая задача читает config без неё;
+// остальные задачи (обработчики AsyncTCP) держат блокировку всё время,
+// пока читают config или копируют её.
+class ConfigLock {
+public:
+  ConfigLock() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+  ~ConfigLock() { xSemaphoreGive(mutex()); }
+  ConfigLock(const ConfigLock &) = delete;
+  ConfigLock &operator=(const ConfigLock &) = delete;
+
+private:
+  static SemaphoreHandle_t mutex() {
+    static SemaphoreHandle_t handle = xSemaphoreCreateMutex();
+    return handle;
+  }
+};
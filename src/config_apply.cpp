@@ -0,0 +1,157 @@
+#include "config_apply.h"
+#include "config_store.h"
+#include "fleet_rollout.h"
+#include "handlers.h"
+#include "input_engine.h"
+#include "macro_engine.h"
+#include "pulse_scheduler.h"
+#include "temp_sampler.h"
+#include "topic_index.h"
+#include "wifi_scan.h"
+
+bool hasTopic(const TopicList &topics, const char *topic) {
+  for (const char *t : topics) {
+    if (strcmp(t, topic) == 0) return true;
+  }
+  return false;
+}
+
+void commandTopics(const Config &source, TopicList &topics) {
+  for (const ButtonConfig &button : source.buttons) {
+    if (button.mode == OUTPUT && !button.topic.isEmpty() && !hasTopic(topics, button.topic.c_str())) {
+      topics.push_back(button.topic.c_str());
+    }
+  }
+  for (const MacroConfig &macro : source.macros) {
+    if (!macro.topic.isEmpty() && !hasTopic(topics, macro.topic.c_str())) topics.push_back(macro.topic.c_str());
+  }
+}
+
+void applySensors(const Config &current) {
+  tempSampler.clearResolutions();
+  for (const SensorConfig &sensor : current.sensors) {
+    if (!sensorAddressIsZero(sensor.address)) tempSampler.setResolution(sensor.address, sensor.resolution);
+  }
+}
+
+template <typename T, size_t N, typename Same>
+static bool sameList(const FixedList<T, N> &a, const FixedList<T, N> &b, Same same) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (!same(a[i], b[i])) return false;
+  }
+  return true;
+}
+
+static bool sameButton(const ButtonConfig &a, const ButtonConfig &b) {
+  return a.name == b.name && a.pin == b.pin && a.duration == b.duration && a.topic == b.topic &&
+         a.mode == b.mode && a.debounce == b.debounce;
+}
+
+static bool sameMacro(const MacroConfig &a, const MacroConfig &b) {
+  return a.name == b.name && a.topic == b.topic && a.script == b.script;
+}
+
+static bool sameSensor(const SensorConfig &a, const SensorConfig &b) {
+  return a.name == b.name && memcmp(a.address, b.address, sizeof(a.address)) == 0 && a.resolution == b.resolution;
+}
+
+static bool hasPin(const ButtonList &buttons, int pin, int mode) {
+  for (const ButtonConfig &button : buttons) {
+    if (button.pin == pin && button.mode == mode) return true;
+  }
+  return false;
+}
+
+// Входы с теми же номерами кнопок, пинами и антидребезгом
+static bool sameInputs(const ButtonList &a, const ButtonList &b) {
+  size_t n = a.size() > b.size() ? a.size() : b.size();
+  for (size_t i = 0; i < n; i++) {
+    bool inA = i < a.size() && a[i].mode != OUTPUT;
+    bool inB = i < b.size() && b[i].mode != OUTPUT;
+    if (inA != inB) return false;
+    if (inA && (a[i].pin != b[i].pin || a[i].debounce != b[i].debounce)) return false;
+  }
+  return true;
+}
+
+// Перенастройка кнопок по разнице с прежней конфигурацией: gpioMode только
+// для новых пинов и режимов, выходы без изменений сохраняют идущий импульс,
+// входы пересоздаются, только если изменился их набор. Возвращает true,
+// если состояния входов нужно заполнить заново
+static bool updateButtons(const Config &previous, const Config &current) {
+  for (const ButtonConfig &button : previous.buttons) {
+    if (button.mode == OUTPUT && !hasPin(current.buttons, button.pin, OUTPUT)) pulses.removePin(button.pin);
+  }
+  bool inputsChanged = !sameInputs(previous.buttons, current.buttons);
+  if (inputsChanged) inputs.clear();
+  for (size_t i = 0; i < current.buttons.size(); i++) {
+    const ButtonConfig &button = current.buttons[i];
+    if (!hasPin(previous.buttons, button.pin, button.mode)) hal::gpioMode(button.pin, button.mode);
+    if (button.mode == OUTPUT) {
+      if (!pulses.owns(button.pin) && !pulses.addPin(button.pin)) {
+        Serial.printf("Too many output pins, pin %d is not scheduled\n", button.pin);
+      }
+    } else if (inputsChanged && !inputs.addPin(i, button.pin, button.debounce)) {
+      Serial.printf("Too many input pins, pin %d is not monitored\n", button.pin);
+    }
+  }
+  topicIndex.build(current.buttons);
+  // Состояние входа публикуется заново, если у кнопки новый топик или пин
+  for (size_t i = 0; i < current.buttons.size(); i++) {
+    const ButtonConfig &button = current.buttons[i];
+    if (button.mode == OUTPUT) continue;
+    bool known = i < previous.buttons.size() && previous.buttons[i].mode != OUTPUT &&
+                 previous.buttons[i].pin == button.pin && previous.buttons[i].topic == button.topic;
+    if (!known) publishInputState(i, inputs.state(i));
+  }
+  return inputsChanged || previous.buttons.size() != current.buttons.size();
+}
+
+// Подписки по разнице наборов топиков; без связи подпишет mqttConnect
+static void resubscribe(const Config &previous, const Config &current) {
+  if (!mqttTransport.connected()) return;
+  TopicList before, after;
+  commandTopics(previous, before);
+  commandTopics(current, after);
+  for (const char *topic : before) {
+    if (!hasTopic(after, topic)) mqttTransport.unsubscribe(topic);
+  }
+  for (const char *topic : after) {
+    if (!hasTopic(before, topic)) mqttTransport.subscribe(topic);
+  }
+}
+
+// Смена группы раскатки без переподключения к брокеру
+static void applyRolloutGroup(const Config &current) {
+  char previous[64];
+  strlcpy(previous, fleetRollout.groupTopic(), sizeof(previous));
+  fleetRollout.setGroup(current.ota_group.c_str());
+  if (strcmp(previous, fleetRollout.groupTopic()) == 0 || !mqttTransport.connected()) return;
+  if (*previous) mqttTransport.unsubscribe(previous);
+  if (*fleetRollout.groupTopic()) mqttTransport.subscribe(fleetRollout.groupTopic());
+}
+
+ConfigChanges applyChanges(const Config &previous, const Config &current) {
+  ConfigChanges changes = {};
+  bool buttonsChanged = !sameList(previous.buttons, current.buttons, sameButton);
+  if (buttonsChanged) changes.inputs = updateButtons(previous, current);
+  if (buttonsChanged || !sameList(previous.macros, current.macros, sameMacro)) macroEngine.load(current);
+  if (!sameList(previous.sensors, current.sensors, sameSensor)) applySensors(current);
+  changes.buses = !sameList(previous.oneWireBus_pins, current.oneWireBus_pins,
+                            [](uint8_t a, uint8_t b) { return a == b; });
+  changes.broker = previous.mqtt_server != current.mqtt_server || previous.mqtt_user != current.mqtt_user ||
+                   previous.mqtt_password != current.mqtt_password;
+  if (changes.broker) {
+    // mqttConnect подпишется на все топики заново
+    mqtt.reconnect();
+  } else {
+    resubscribe(previous, current);
+  }
+  wifiScanner.setTtl(current.scan_ttl);
+  applyRolloutGroup(current);
+  changes.wifi = previous.ssid != current.ssid || previous.password != current.password ||
+                 previous.static_ip != current.static_ip || previous.static_gateway != current.static_gateway ||
+                 previous.static_subnet != current.static_subnet || previous.static_dns != current.static_dns;
+  return changes;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// Применение новой конфигурации по разнице с прежней: пины кнопок,
+// макросы, разрешения датчиков, подписки MQTT и группа раскатки.
+// Вызывается из сетевой задачи; current - уже действующая конфигурация
+// (в прошивке config): индекс топиков ссылается на её кнопки.
+
+// Топики команд: выходные кнопки и макросы, без повторов
+typedef FixedList<const char *, CONFIG_MAX_BUTTONS + CONFIG_MAX_MACROS> TopicList;
+
+bool hasTopic(const TopicList &topics, const char *topic);
+void commandTopics(const Config &source, TopicList &topics);
+
+// Разрешения датчиков из настроек
+void applySensors(const Config &current);
+
+// Что остаётся вызывающему после applyChanges()
+struct ConfigChanges {
+  // Изменился набор кнопок: заново заполнить состояния входов для SSE
+  // и телеметрии
+  bool inputs;
+  // Другие пины шин 1-Wire
+  bool buses;
+  // Другой сервер или учётные данные: сессия с брокером уже закрыта,
+  // клиенту нужен новый адрес сервера
+  bool broker;
+  // Wi-Fi и статический адрес вступают в силу после перезагрузки
+  bool wifi;
+};
+
+// Перенастраиваются только изменившиеся пины, подписки и датчики, к
+// брокеру устройство переподключается только при смене сервера или
+// учётных данных
+ConfigChanges applyChanges(const Config &previous, const Config &current);
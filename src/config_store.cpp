@@ -0,0 +1,561 @@
+#include "config_store.h"
+#include <esp_rom_crc.h>
+#include <memory>
+#include "hal.h"
+#include "input_engine.h"
+
+ConfigStore configStore;
+
+static const char *slotFiles[2] = {"/config.0", "/config.1"};
+static const char *legacyConfigFile = "/config.json";
+static const uint32_t CONFIG_MAGIC = 0x31434350; // "PCC1"
+
+struct ConfigHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t sequence;
+  uint32_t length;
+  uint32_t crc;
+};
+
+// CRC-32 (IEEE) табличной функцией из ROM: побитовый цикл занимал
+// большую часть времени чтения конфигурации
+static uint32_t crc32(const uint8_t *data, size_t length) {
+  return esp_rom_crc32_le(0, data, length);
+}
+
+// Последовательная запись полей в буфер
+class ConfigWriter {
+public:
+  void u8(uint8_t v) { data.push_back(v); }
+  void u16(uint16_t v) { u8(v); u8(v >> 8); }
+  void u32(uint32_t v) { u16(v); u16(v >> 16); }
+  template <size_t N>
+  void str(const FixedString<N> &s) {
+    u16(s.length());
+    data.insert(data.end(), s.c_str(), s.c_str() + s.length());
+  }
+  std::vector<uint8_t> data;
+};
+
+// Чтение полей; за концом буфера возвращаются значения по умолчанию,
+// так что поля, добавленные в новых версиях, читаются из старых записей
+class ConfigReader {
+public:
+  ConfigReader(const uint8_t *data, size_t length) : p(data), end(data + length) {}
+  uint8_t u8(uint8_t def = 0) { return p < end ? *p++ : def; }
+  uint16_t u16(uint16_t def = 0) {
+    if (end - p < 2) return def;
+    uint16_t v = p[0] | (p[1] << 8);
+    p += 2;
+    return v;
+  }
+  uint32_t u32(uint32_t def = 0) {
+    if (end - p < 4) return def;
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    p += 4;
+    return v;
+  }
+  // Строка длиннее ёмкости поля обрезается
+  template <size_t N>
+  void str(FixedString<N> &s) {
+    uint16_t len = u16();
+    if (len > end - p) {
+      p = end;
+      s = "";
+      return;
+    }
+    s.assign((const char *)p, len);
+    p += len;
+  }
+  bool exhausted() const { return p >= end; }
+
+private:
+  const uint8_t *p;
+  const uint8_t *end;
+};
+
+static void encode(const Config &config, ConfigWriter &w) {
+  w.str(config.ssid);
+  w.str(config.password);
+  w.str(config.mqtt_server);
+  w.str(config.mqtt_user);
+  w.str(config.mqtt_password);
+  w.u8(config.buttons.size());
+  for (const ButtonConfig &button : config.buttons) {
+    w.str(button.name);
+    w.u8(button.pin);
+    w.u32(button.duration);
+    w.str(button.topic);
+    w.u8(button.mode);
+    w.u32(button.debounce);
+  }
+  // Версия 2
+  w.str(config.update_url);
+  w.u16(config.update_interval);
+  w.u16(config.update_jitter);
+  w.u8(config.update_window_start);
+  w.u8(config.update_window_end);
+  // Версия 3
+  w.u16(config.metrics_interval);
+  // Версия 4; зона нечувствительности хранится в сотых долях градуса
+  w.u16(config.telemetry_interval);
+  w.u16((uint16_t)lroundf(config.telemetry_deadband * 100));
+  w.u16(config.heartbeat_interval);
+  // Версия 5: шины и датчики вместо sensor1_name/sensor2_name/oneWireBus_pin
+  w.u8(config.oneWireBus_pins.size());
+  for (uint8_t pin : config.oneWireBus_pins) {
+    w.u8(pin);
+  }
+  w.u8(config.sensors.size());
+  for (const SensorConfig &sensor : config.sensors) {
+    w.str(sensor.name);
+    for (uint8_t b : sensor.address) {
+      w.u8(b);
+    }
+    w.u8(sensor.resolution);
+  }
+  // Версия 6
+  w.u8(config.macros.size());
+  for (const MacroConfig &macro : config.macros) {
+    w.str(macro.name);
+    w.str(macro.topic);
+    w.str(macro.script);
+  }
+  // Версия 7
+  w.u32(config.static_ip);
+  w.u32(config.static_gateway);
+  w.u32(config.static_subnet);
+  w.u32(config.static_dns);
+  // Версия 8
+  w.u16(config.scan_ttl);
+  // Версия 9
+  w.str(config.ota_group);
+}
+
+// Имена датчиков прежних версий превращаются в непривязанные записи
+static void addLegacySensor(Config &config, const char *name) {
+  if (!*name) return;
+  SensorConfig sensor;
+  sensor.name = name;
+  memset(sensor.address, 0, sizeof(sensor.address));
+  sensor.resolution = DEFAULT_SENSOR_RESOLUTION;
+  config.sensors.push_back(sensor);
+}
+
+static void decode(ConfigReader &r, Config &config, uint16_t version) {
+  r.str(config.ssid);
+  r.str(config.password);
+  r.str(config.mqtt_server);
+  r.str(config.mqtt_user);
+  r.str(config.mqtt_password);
+  FixedString<32> legacySensor1, legacySensor2;
+  uint8_t legacyBusPin = DEFAULT_ONE_WIRE_BUS;
+  if (version < 5) {
+    r.str(legacySensor1);
+    r.str(legacySensor2);
+    legacyBusPin = r.u8(DEFAULT_ONE_WIRE_BUS);
+  }
+  // Лишние записи дочитываются, чтобы не сбить разбор следующих полей
+  uint8_t count = r.u8();
+  config.buttons.clear();
+  for (uint8_t i = 0; i < count && !r.exhausted(); i++) {
+    ButtonConfig button;
+    r.str(button.name);
+    button.pin = r.u8();
+    button.duration = r.u32();
+    r.str(button.topic);
+    button.mode = r.u8();
+    button.debounce = r.u32(DEFAULT_INPUT_DEBOUNCE);
+    if (!config.buttons.push_back(button)) {
+      Serial.printf("Too many buttons in config, button %u ignored\n", i);
+    }
+  }
+  if (version >= 2) {
+    r.str(config.update_url);
+    config.update_interval = r.u16();
+    config.update_jitter = r.u16();
+    config.update_window_start = r.u8();
+    config.update_window_end = r.u8();
+  }
+  if (version >= 3) {
+    config.metrics_interval = r.u16();
+  }
+  if (version >= 4) {
+    config.telemetry_interval = r.u16();
+    config.telemetry_deadband = r.u16() / 100.0f;
+    config.heartbeat_interval = r.u16();
+  }
+  config.oneWireBus_pins.clear();
+  config.sensors.clear();
+  if (version >= 5) {
+    uint8_t buses = r.u8();
+    for (uint8_t i = 0; i < buses && !r.exhausted(); i++) {
+      uint8_t pin = r.u8();
+      if (!config.oneWireBus_pins.push_back(pin)) {
+        Serial.printf("Too many OneWire buses in config, pin %d ignored\n", pin);
+      }
+    }
+    uint8_t sensors = r.u8();
+    for (uint8_t i = 0; i < sensors && !r.exhausted(); i++) {
+      SensorConfig sensor;
+      r.str(sensor.name);
+      for (uint8_t &b : sensor.address) {
+        b = r.u8();
+      }
+      sensor.resolution = r.u8(DEFAULT_SENSOR_RESOLUTION);
+      if (!config.sensors.push_back(sensor)) {
+        Serial.printf("Too many sensors in config, sensor %u ignored\n", i);
+      }
+    }
+  } else {
+    config.oneWireBus_pins.push_back(legacyBusPin);
+    addLegacySensor(config, legacySensor1.c_str());
+    addLegacySensor(config, legacySensor2.c_str());
+  }
+  if (config.oneWireBus_pins.empty()) config.oneWireBus_pins.push_back(DEFAULT_ONE_WIRE_BUS);
+  config.macros.clear();
+  if (version >= 6) {
+    uint8_t macros = r.u8();
+    for (uint8_t i = 0; i < macros && !r.exhausted(); i++) {
+      MacroConfig macro;
+      r.str(macro.name);
+      r.str(macro.topic);
+      r.str(macro.script);
+      if (!config.macros.push_back(macro)) {
+        Serial.printf("Too many macros in config, macro %u ignored\n", i);
+      }
+    }
+  }
+  if (version >= 7) {
+    config.static_ip = r.u32();
+    config.static_gateway = r.u32();
+    config.static_subnet = r.u32();
+    config.static_dns = r.u32();
+  }
+  if (version >= 8) {
+    config.scan_ttl = r.u16();
+  }
+  if (version >= 9) {
+    r.str(config.ota_group);
+  }
+}
+
+
+
+ConfigStore::ConfigStore() : currentSlot(-1), currentSequence(0) {
+}
+
+bool ConfigStore::readSlot(int slot, Config &config, uint32_t &sequence) {
+  std::vector<uint8_t> image;
+  if (!hal::fileRead(slotFiles[slot], image) || image.size() < sizeof(ConfigHeader)) return false;
+
+  ConfigHeader header;
+  memcpy(&header, image.data(), sizeof(header));
+  const uint8_t *payload = image.data() + sizeof(header);
+  if (header.magic != CONFIG_MAGIC || header.version > CONFIG_FORMAT_VERSION ||
+      header.length > image.size() - sizeof(header) || crc32(payload, header.length) != header.crc) {
+    return false;
+  }
+
+  ConfigReader reader(payload, header.length);
+  decode(reader, config, header.version);
+  sequence = header.sequence;
+  return true;
+}
+
+bool ConfigStore::load(Config &config) {
+  currentSlot = -1;
+  currentSequence = 0;
+  for (int slot = 0; slot < 2; slot++) {
+    if (!hal::fileExists(slotFiles[slot])) continue;
+    // Config занимает несколько килобайт, на стеке задачи его не держим
+    std::unique_ptr<Config> candidate(new Config());
+    uint32_t sequence;
+    if (!readSlot(slot, *candidate, sequence)) {
+      Serial.printf("Config slot %d is damaged, ignoring it.\n", slot);
+      continue;
+    }
+    if (currentSlot < 0 || (int32_t)(sequence - currentSequence) > 0) {
+      config = *candidate;
+      currentSlot = slot;
+      currentSequence = sequence;
+    }
+  }
+  if (currentSlot >= 0) return true;
+
+  // Перенос конфигурации из JSON прежних версий прошивки
+  if (!hal::fileExists(legacyConfigFile)) {
+    Serial.println("Config file not found.");
+    return false;
+  }
+  std::vector<uint8_t> json;
+  if (!hal::fileRead(legacyConfigFile, json)) {
+    Serial.println("Failed to open config file.");
+    return false;
+  }
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, (const char *)json.data(), json.size());
+  if (error || !configFromJson(doc, config, true)) {
+    Serial.println("Failed to deserialize config file.");
+    return false;
+  }
+  Serial.println("Migrating JSON config to binary store.");
+  if (save(config)) {
+    hal::fileRemove(legacyConfigFile);
+  }
+  return true;
+}
+
+bool ConfigStore::save(const Config &config) {
+  ConfigWriter writer;
+  writer.data.resize(sizeof(ConfigHeader));
+  encode(config, writer);
+
+  ConfigHeader header;
+  header.magic = CONFIG_MAGIC;
+  header.version = CONFIG_FORMAT_VERSION;
+  header.reserved = 0;
+  header.sequence = currentSequence + 1;
+  header.length = writer.data.size() - sizeof(header);
+  header.crc = crc32(writer.data.data() + sizeof(header), header.length);
+  memcpy(writer.data.data(), &header, sizeof(header));
+
+  // Пишем в слот, не содержащий текущую конфигурацию
+  int slot = currentSlot == 0 ? 1 : 0;
+  if (!hal::fileWrite(slotFiles[slot], writer.data.data(), writer.data.size())) {
+    Serial.println("Failed to write to config file.");
+    return false;
+  }
+
+  // Запись считается зафиксированной только после проверки прочитанной копии
+  std::unique_ptr<Config> check(new Config());
+  uint32_t sequence;
+  if (!readSlot(slot, *check, sequence) || sequence != header.sequence) {
+    Serial.println("Config verification failed.");
+    return false;
+  }
+  currentSlot = slot;
+  currentSequence = header.sequence;
+  return true;
+}
+
+static const char *jsonString(JsonVariant value) {
+  return value | "";
+}
+
+// Строка из JSON в поле конфигурации; false, если не помещается
+template <size_t N>
+static bool jsonAssign(FixedString<N> &s, JsonVariant value) {
+  return s.assign(jsonString(value));
+}
+
+void configToJson(const Config &config, JsonDocument &doc) {
+  doc["ssid"] = config.ssid.c_str();
+  doc["password"] = config.password.c_str();
+  doc["mqtt_server"] = config.mqtt_server.c_str();
+  doc["mqtt_user"] = config.mqtt_user.c_str();
+  doc["mqtt_password"] = config.mqtt_password.c_str();
+  char ip[IP_ADDRESS_TEXT];
+  formatIpAddress(config.static_ip, ip);
+  doc["static_ip"] = ip;
+  formatIpAddress(config.static_gateway, ip);
+  doc["static_gateway"] = ip;
+  formatIpAddress(config.static_subnet, ip);
+  doc["static_subnet"] = ip;
+  formatIpAddress(config.static_dns, ip);
+  doc["static_dns"] = ip;
+  JsonArray buses = doc["oneWireBus_pins"].to<JsonArray>();
+  for (uint8_t pin : config.oneWireBus_pins) {
+    buses.add(pin);
+  }
+  JsonArray sensors = doc["sensors"].to<JsonArray>();
+  for (const SensorConfig &sensor : config.sensors) {
+    JsonObject item = sensors.add<JsonObject>();
+    char address[SENSOR_ADDRESS_TEXT] = "";
+    if (!sensorAddressIsZero(sensor.address)) formatSensorAddress(sensor.address, address);
+    item["name"] = sensor.name.c_str();
+    item["address"] = address;
+    item["resolution"] = sensor.resolution;
+  }
+
+  JsonArray buttons = doc["buttons"].to<JsonArray>();
+  for (const ButtonConfig &button : config.buttons) {
+    JsonObject btn = buttons.add<JsonObject>();
+    btn["name"] = button.name.c_str();
+    btn["pin"] = button.pin;
+    btn["duration"] = button.duration;
+    btn["topic"] = button.topic.c_str();
+    btn["mode"] = button.mode;
+    btn["debounce"] = button.debounce;
+  }
+
+  JsonArray macros = doc["macros"].to<JsonArray>();
+  for (const MacroConfig &macro : config.macros) {
+    JsonObject item = macros.add<JsonObject>();
+    item["name"] = macro.name.c_str();
+    item["topic"] = macro.topic.c_str();
+    item["script"] = macro.script.c_str();
+  }
+
+  doc["update_url"] = config.update_url.c_str();
+  doc["update_interval"] = config.update_interval;
+  doc["update_jitter"] = config.update_jitter;
+  doc["update_window_start"] = config.update_window_start;
+  doc["update_window_end"] = config.update_window_end;
+  doc["ota_group"] = config.ota_group.c_str();
+  doc["metrics_interval"] = config.metrics_interval;
+  doc["telemetry_interval"] = config.telemetry_interval;
+  doc["telemetry_deadband"] = config.telemetry_deadband;
+  doc["heartbeat_interval"] = config.heartbeat_interval;
+  doc["scan_ttl"] = config.scan_ttl;
+}
+
+// Списки длиннее ёмкости конфигурации не принимаются целиком
+bool configFromJson(JsonDocument &doc, Config &config, bool truncate) {
+  if (!doc.is<JsonObject>()) return false;
+  if (doc["buttons"].size() > CONFIG_MAX_BUTTONS || doc["sensors"].size() > CONFIG_MAX_SENSORS ||
+      doc["oneWireBus_pins"].size() > CONFIG_MAX_BUSES || doc["macros"].size() > CONFIG_MAX_MACROS) {
+    Serial.println("Config lists exceed device limits.");
+    return false;
+  }
+  bool fits = true;
+  if (!jsonAssign(config.ssid, doc["ssid"])) fits = false;
+  if (!jsonAssign(config.password, doc["password"])) fits = false;
+  if (!jsonAssign(config.mqtt_server, doc["mqtt_server"])) fits = false;
+  if (!jsonAssign(config.mqtt_user, doc["mqtt_user"])) fits = false;
+  if (!jsonAssign(config.mqtt_password, doc["mqtt_password"])) fits = false;
+  if (!parseIpAddress(jsonString(doc["static_ip"]), config.static_ip) ||
+      !parseIpAddress(jsonString(doc["static_gateway"]), config.static_gateway) ||
+      !parseIpAddress(jsonString(doc["static_subnet"]), config.static_subnet) ||
+      !parseIpAddress(jsonString(doc["static_dns"]), config.static_dns)) {
+    Serial.println("Invalid static IP settings.");
+    return false;
+  }
+
+  // Старый формат: одна шина и два имени датчиков
+  config.oneWireBus_pins.clear();
+  config.sensors.clear();
+  if (doc["oneWireBus_pins"].is<JsonArray>()) {
+    for (JsonVariant pin : doc["oneWireBus_pins"].as<JsonArray>()) {
+      config.oneWireBus_pins.push_back(pin.as<uint8_t>());
+    }
+  } else {
+    config.oneWireBus_pins.push_back(doc["oneWireBus_pin"] | DEFAULT_ONE_WIRE_BUS);
+  }
+  if (config.oneWireBus_pins.empty()) config.oneWireBus_pins.push_back(DEFAULT_ONE_WIRE_BUS);
+  if (doc["sensors"].is<JsonArray>()) {
+    for (JsonObject item : doc["sensors"].as<JsonArray>()) {
+      SensorConfig sensor;
+      if (!jsonAssign(sensor.name, item["name"])) fits = false;
+      if (!sensorAddressFromString(item["address"] | "", sensor.address)) {
+        memset(sensor.address, 0, sizeof(sensor.address));
+      }
+      sensor.resolution = constrain(item["resolution"] | DEFAULT_SENSOR_RESOLUTION, 9, 12);
+      config.sensors.push_back(sensor);
+    }
+  } else {
+    addLegacySensor(config, jsonString(doc["sensor1_name"]));
+    addLegacySensor(config, jsonString(doc["sensor2_name"]));
+  }
+
+  config.buttons.clear();
+  JsonArray buttons = doc["buttons"].as<JsonArray>();
+  for (JsonObject btn : buttons) {
+    ButtonConfig button;
+    if (!jsonAssign(button.name, btn["name"])) fits = false;
+    button.pin = btn["pin"].as<int>();
+    button.duration = btn["duration"].as<unsigned long>();
+    if (!jsonAssign(button.topic, btn["topic"])) fits = false;
+    button.mode = btn["mode"].as<int>();
+    button.debounce = btn["debounce"] | (unsigned long)DEFAULT_INPUT_DEBOUNCE;
+    config.buttons.push_back(button);
+  }
+
+  config.macros.clear();
+  for (JsonObject item : doc["macros"].as<JsonArray>()) {
+    MacroConfig macro;
+    if (!jsonAssign(macro.name, item["name"])) fits = false;
+    if (!jsonAssign(macro.topic, item["topic"])) fits = false;
+    if (!jsonAssign(macro.script, item["script"])) fits = false;
+    config.macros.push_back(macro);
+  }
+
+  if (!jsonAssign(config.update_url, doc["update_url"])) fits = false;
+  config.update_interval = doc["update_interval"] | 0;
+  config.update_jitter = doc["update_jitter"] | 0;
+  config.update_window_start = doc["update_window_start"] | 0;
+  config.update_window_end = doc["update_window_end"] | 0;
+  if (!jsonAssign(config.ota_group, doc["ota_group"])) fits = false;
+  config.metrics_interval = doc["metrics_interval"] | 0;
+  config.telemetry_interval = doc["telemetry_interval"] | 60;
+  config.telemetry_deadband = doc["telemetry_deadband"] | 0.5f;
+  config.heartbeat_interval = doc["heartbeat_interval"] | 300;
+  config.scan_ttl = doc["scan_ttl"] | 60;
+  if (!fits) Serial.println("Config strings exceed field capacity.");
+  return fits || truncate;
+}
+
+void formatIpAddress(uint32_t ip, char *text) {
+  if (!ip) {
+    text[0] = 0;
+    return;
+  }
+  snprintf(text, IP_ADDRESS_TEXT, "%u.%u.%u.%u", (unsigned)(ip & 0xFF), (unsigned)((ip >> 8) & 0xFF),
+           (unsigned)((ip >> 16) & 0xFF), (unsigned)(ip >> 24));
+}
+
+bool parseIpAddress(const char *text, uint32_t &ip) {
+  ip = 0;
+  if (!*text) return true;
+  for (uint8_t i = 0; i < 4; i++) {
+    char *end;
+    unsigned long octet = strtoul(text, &end, 10);
+    if (end == text || octet > 255 || *end != (i < 3 ? '.' : 0)) {
+      ip = 0;
+      return false;
+    }
+    ip |= octet << (i * 8);
+    text = end + 1;
+  }
+  return true;
+}
+
+void formatSensorAddress(const uint8_t *address, char *text) {
+  for (uint8_t i = 0; i < 8; i++) {
+    snprintf(text + i * 2, 3, "%02X", address[i]);
+  }
+}
+
+bool sensorAddressFromString(const char *text, uint8_t *address) {
+  if (strlen(text) != 16) return false;
+  for (uint8_t i = 0; i < 8; i++) {
+    char byte[3] = {text[i * 2], text[i * 2 + 1], 0};
+    char *end;
+    address[i] = strtoul(byte, &end, 16);
+    if (*end) return false;
+  }
+  return true;
+}
+
+bool sensorAddressIsZero(const uint8_t *address) {
+  for (uint8_t i = 0; i < 8; i++) {
+    if (address[i]) return false;
+  }
+  return true;
+}
+
+const SensorConfig *findSensorConfig(const Config &config, const uint8_t *address) {
+  for (const SensorConfig &sensor : config.sensors) {
+    if (memcmp(sensor.address, address, sizeof(sensor.address)) == 0) return &sensor;
+  }
+  return nullptr;
+}
+
+const char *sensorLabel(const Config &config, const uint8_t *address, char *buffer) {
+  const SensorConfig *sensor = findSensorConfig(config, address);
+  if (sensor && !sensor->name.isEmpty()) return sensor->name.c_str();
+  formatSensorAddress(address, buffer);
+  return buffer;
+}
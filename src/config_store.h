@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// Версия двоичного формата конфигурации
+#define CONFIG_FORMAT_VERSION 9
+
+// Хранилище конфигурации: компактный двоичный формат с CRC32,
+// запись по очереди в два слота. При обрыве питания во время записи
+// повреждается только новый слот, старый остаётся действительным.
+// Файловая система должна быть смонтирована заранее.
+class ConfigStore {
+public:
+  ConfigStore();
+
+  // Загрузка из самого свежего действительного слота; при их отсутствии
+  // импортируется старый /config.json
+  bool load(Config &config);
+  bool save(const Config &config);
+
+  uint32_t sequence() const { return currentSequence; }
+  int slot() const { return currentSlot; }
+
+private:
+  bool readSlot(int slot, Config &config, uint32_t &sequence);
+
+  int currentSlot;
+  uint32_t currentSequence;
+};
+
+// Перенос конфигурации в JSON и обратно (импорт/экспорт, старый формат)
+// Строки длиннее своих полей отклоняют импорт; при переносе старого файла
+// (truncate) они обрезаются, чтобы не потерять остальную конфигурацию
+void configToJson(const Config &config, JsonDocument &doc);
+bool configFromJson(JsonDocument &doc, Config &config, bool truncate = false);
+
+// Размер буфера для адреса датчика в текстовом виде
+#define SENSOR_ADDRESS_TEXT 17
+
+// ROM-адрес датчика в виде 16 шестнадцатеричных цифр и обратно
+void formatSensorAddress(const uint8_t *address, char *text);
+bool sensorAddressFromString(const char *text, uint8_t *address);
+bool sensorAddressIsZero(const uint8_t *address);
+// Настройки датчика по адресу; nullptr, если датчик не описан
+const SensorConfig *findSensorConfig(const Config &config, const uint8_t *address);
+// Имя датчика из конфигурации, иначе его адрес в buffer (SENSOR_ADDRESS_TEXT)
+const char *sensorLabel(const Config &config, const uint8_t *address, char *buffer);
+
+// Размер буфера для IPv4-адреса в текстовом виде
+#define IP_ADDRESS_TEXT 16
+
+// IPv4 "a.b.c.d" и обратно; пустая строка и 0 означают "не задан"
+void formatIpAddress(uint32_t ip, char *text);
+bool parseIpAddress(const char *text, uint32_t &ip);
+
+extern ConfigStore configStore;
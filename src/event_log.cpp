@@ -0,0 +1,199 @@
+#include "event_log.h"
+#include <time.h>
+#include "hal.h"
+
+EventLog eventLog;
+
+// Время до синхронизации по NTP не записывается
+static const time_t MIN_VALID_TIME = 1600000000;
+
+static void segmentPath(uint8_t segment, char *path, size_t size) {
+  snprintf(path, size, "/events.%u", segment);
+}
+
+EventLog::EventLog()
+  : segmentFirst{}, segmentCount{}, segment(0), pendingCount(0), pendingSince(0), nextSeq(1), bootNumber(0),
+    droppedCount(0), writeCount(0), flushing(false), mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+// Текущий сегмент - тот, где последняя запись новее остальных
+void EventLog::begin() {
+  char path[16];
+  EventRecord record;
+  int newest = -1;
+  uint32_t newestSeq = 0;
+  for (uint8_t s = 0; s < EVENT_LOG_SEGMENTS; s++) {
+    segmentPath(s, path, sizeof(path));
+    size_t count = hal::fileSize(path) / sizeof(EventRecord);
+    if (count > EVENT_SEGMENT_RECORDS) count = EVENT_SEGMENT_RECORDS;
+    segmentCount[s] = 0;
+    if (!count || hal::fileReadAt(path, 0, (uint8_t *)&record, sizeof(record)) != sizeof(record)) continue;
+    segmentFirst[s] = record.seq;
+    segmentCount[s] = count;
+    uint32_t last = record.seq + count - 1;
+    if (newest < 0 || (int32_t)(last - newestSeq) > 0) {
+      newest = s;
+      newestSeq = last;
+    }
+  }
+  if (newest < 0) return;
+  segment = newest;
+  nextSeq = newestSeq + 1;
+  segmentPath(segment, path, sizeof(path));
+  size_t offset = (segmentCount[segment] - 1) * sizeof(EventRecord);
+  if (hal::fileReadAt(path, offset, (uint8_t *)&record, sizeof(record)) == sizeof(record)) {
+    bootNumber = record.boot + 1;
+  }
+}
+
+bool EventLog::add(EventType type, uint8_t arg, uint32_t value) {
+  time_t now = time(nullptr);
+  EventRecord record;
+  record.time = now >= MIN_VALID_TIME ? (uint32_t)now : 0;
+  record.uptime = hal::millis();
+  record.type = type;
+  record.arg = arg;
+  record.value = value;
+  bool ok = false;
+  portENTER_CRITICAL(&mux);
+  if (pendingCount < EVENT_BUFFER) {
+    record.seq = nextSeq++;
+    record.boot = bootNumber;
+    if (!pendingCount) pendingSince = record.uptime;
+    pending[pendingCount++] = record;
+    ok = true;
+  } else {
+    droppedCount++;
+  }
+  portEXIT_CRITICAL(&mux);
+  return ok;
+}
+
+// Записи удаляются из буфера только после записи во флеш, так что
+// чтение в это время находит их в буфере
+void EventLog::flush(unsigned long now, bool force) {
+  EventRecord batch[EVENT_BUFFER];
+  size_t count = 0;
+  portENTER_CRITICAL(&mux);
+  bool due = pendingCount && (force || pendingCount >= EVENT_BATCH || now - pendingSince >= EVENT_FLUSH_MS);
+  if (due && !flushing) {
+    flushing = true;
+    count = pendingCount;
+    memcpy(batch, pending, count * sizeof(EventRecord));
+  }
+  portEXIT_CRITICAL(&mux);
+  if (!count) return;
+
+  bool ok = write(batch, count);
+  portENTER_CRITICAL(&mux);
+  if (ok) {
+    pendingCount -= count;
+    memmove(pending, pending + count, pendingCount * sizeof(EventRecord));
+    if (pendingCount) pendingSince = pending[0].uptime;
+  }
+  flushing = false;
+  portEXIT_CRITICAL(&mux);
+  if (!ok) Serial.println("Failed to write event log.");
+}
+
+bool EventLog::write(const EventRecord *records, size_t count) {
+  char path[16];
+  size_t done = 0;
+  while (done < count) {
+    if (segmentCount[segment] >= EVENT_SEGMENT_RECORDS) {
+      // Переход к следующему сегменту; самый старый начинается заново
+      portENTER_CRITICAL(&mux);
+      segment = (segment + 1) % EVENT_LOG_SEGMENTS;
+      segmentCount[segment] = 0;
+      portEXIT_CRITICAL(&mux);
+    }
+    size_t n = EVENT_SEGMENT_RECORDS - segmentCount[segment];
+    if (n > count - done) n = count - done;
+    segmentPath(segment, path, sizeof(path));
+    const uint8_t *data = (const uint8_t *)(records + done);
+    bool ok = segmentCount[segment]
+      ? hal::fileAppend(path, data, n * sizeof(EventRecord))
+      : hal::fileWrite(path, data, n * sizeof(EventRecord));
+    if (!ok) return false;
+    portENTER_CRITICAL(&mux);
+    if (!segmentCount[segment]) segmentFirst[segment] = records[done].seq;
+    segmentCount[segment] += n;
+    portEXIT_CRITICAL(&mux);
+    writeCount++;
+    done += n;
+  }
+  return true;
+}
+
+size_t EventLog::read(uint32_t from, EventRecord *out, size_t max) const {
+  uint32_t first[EVENT_LOG_SEGMENTS];
+  uint16_t count[EVENT_LOG_SEGMENTS];
+  portENTER_CRITICAL(&mux);
+  uint32_t pendingFirst = pendingCount ? pending[0].seq : nextSeq;
+  if ((int32_t)(from - pendingFirst) >= 0) {
+    size_t index = from - pendingFirst;
+    size_t n = index < pendingCount ? pendingCount - index : 0;
+    if (n > max) n = max;
+    memcpy(out, pending + index, n * sizeof(EventRecord));
+    portEXIT_CRITICAL(&mux);
+    return n;
+  }
+  memcpy(first, segmentFirst, sizeof(first));
+  memcpy(count, segmentCount, sizeof(count));
+  portEXIT_CRITICAL(&mux);
+
+  // Сегмент с записью from; если она уже перезаписана - самый старый
+  // из более новых
+  int found = -1;
+  for (uint8_t s = 0; s < EVENT_LOG_SEGMENTS; s++) {
+    if (!count[s]) continue;
+    int32_t offset = from - first[s];
+    if (offset >= 0 && offset < count[s]) {
+      found = s;
+      break;
+    }
+    if (offset < 0 && (found < 0 || (int32_t)(first[s] - first[found]) < 0)) found = s;
+  }
+  if (found < 0) return 0;
+  if ((int32_t)(from - first[found]) < 0) from = first[found];
+
+  size_t index = from - first[found];
+  size_t n = count[found] - index;
+  if (n > max) n = max;
+  char path[16];
+  segmentPath(found, path, sizeof(path));
+  n = hal::fileReadAt(path, index * sizeof(EventRecord), (uint8_t *)out, n * sizeof(EventRecord)) / sizeof(EventRecord);
+  // Сегмент мог быть перезаписан между снимком и чтением
+  if (!n || out[0].seq != from) return 0;
+  return n;
+}
+
+uint32_t EventLog::first() const {
+  portENTER_CRITICAL(&mux);
+  uint32_t oldest = pendingCount ? pending[0].seq : nextSeq;
+  for (uint8_t s = 0; s < EVENT_LOG_SEGMENTS; s++) {
+    if (segmentCount[s] && (int32_t)(segmentFirst[s] - oldest) < 0) oldest = segmentFirst[s];
+  }
+  portEXIT_CRITICAL(&mux);
+  return oldest;
+}
+
+const char *EventLog::typeName(uint8_t type) {
+  switch (type) {
+    case EVENT_BOOT: return "boot";
+    case EVENT_TRIGGER: return "trigger";
+    case EVENT_RELEASE: return "release";
+    case EVENT_INPUT: return "input";
+    case EVENT_MQTT_UP: return "mqtt_up";
+    case EVENT_MQTT_DOWN: return "mqtt_down";
+    case EVENT_WIFI_UP: return "wifi_up";
+    case EVENT_WIFI_DOWN: return "wifi_down";
+    case EVENT_OTA_START: return "ota_start";
+    case EVENT_OTA_DONE: return "ota_done";
+    case EVENT_OTA_FAILED: return "ota_failed";
+    case EVENT_CONFIG: return "config";
+    case EVENT_MACRO: return "macro";
+    case EVENT_RESTART: return "restart";
+  }
+  return "unknown";
+}
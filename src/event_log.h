@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Кольцо из файлов-сегментов на LittleFS; при заполнении последнего
+// перезаписывается самый старый
+#define EVENT_LOG_SEGMENTS 8
+#define EVENT_SEGMENT_RECORDS 256
+// Записи, ожидающие сброса во флеш
+#define EVENT_BUFFER 32
+// Сброс при накоплении пакета или по возрасту самой старой записи, мс
+#define EVENT_BATCH 16
+#define EVENT_FLUSH_MS 10000
+
+enum EventType : uint8_t {
+  EVENT_BOOT,       // value - причина сброса (esp_reset_reason_t)
+  EVENT_TRIGGER,    // arg - пин, value - длительность импульса, мс
+  EVENT_RELEASE,    // arg - пин
+  EVENT_INPUT,      // arg - индекс кнопки, value - состояние
+  EVENT_MQTT_UP,    // value - попыток подключения всего
+  EVENT_MQTT_DOWN,
+  EVENT_WIFI_UP,
+  EVENT_WIFI_DOWN,
+  EVENT_OTA_START,
+  EVENT_OTA_DONE,
+  EVENT_OTA_FAILED,
+  EVENT_CONFIG,     // конфигурация применена
+  EVENT_MACRO,      // arg - индекс макроса, value - 1 запуск, 0 остановка
+  EVENT_RESTART,    // перезагрузка по запросу
+  EVENT_TYPE_COUNT
+};
+
+// Запись журнала, 20 байт во флеше
+struct EventRecord {
+  uint32_t seq;     // сквозной номер записи, курсор для чтения
+  uint32_t time;    // UNIX-время, 0 - часы ещё не синхронизированы
+  uint32_t uptime;  // мс от старта
+  uint16_t boot;    // номер загрузки
+  uint8_t type;
+  uint8_t arg;
+  uint32_t value;
+};
+
+// Журнал событий. add() можно вызывать из любой задачи: запись попадает
+// в буфер в RAM и получает номер. Во флеш буфер пишется пакетами из
+// задачи persist, так что частые события не изнашивают флеш по одному.
+class EventLog {
+public:
+  EventLog();
+
+  // Восстановление положения в кольце; файловая система уже смонтирована
+  void begin();
+
+  // false - буфер полон, запись потеряна
+  bool add(EventType type, uint8_t arg = 0, uint32_t value = 0);
+  // Запись пакета, если он набран или устарел; force - записать сразу
+  void flush(unsigned long now, bool force = false);
+
+  // До max записей подряд, начиная с номера from (или с самой старой,
+  // если from уже перезаписан). Возвращает их число.
+  size_t read(uint32_t from, EventRecord *out, size_t max) const;
+
+  // Диапазон номеров: [first(), next())
+  uint32_t first() const;
+  uint32_t next() const { return nextSeq; }
+  uint16_t boot() const { return bootNumber; }
+  uint32_t dropped() const { return droppedCount; }
+  uint32_t writes() const { return writeCount; }
+
+  static const char *typeName(uint8_t type);
+
+private:
+  bool write(const EventRecord *records, size_t count);
+
+  uint32_t segmentFirst[EVENT_LOG_SEGMENTS];
+  uint16_t segmentCount[EVENT_LOG_SEGMENTS];
+  uint8_t segment;
+  EventRecord pending[EVENT_BUFFER];
+  size_t pendingCount;
+  unsigned long pendingSince;
+  uint32_t nextSeq;
+  uint16_t bootNumber;
+  uint32_t droppedCount;
+  uint32_t writeCount;
+  bool flushing;
+  mutable portMUX_TYPE mux;
+};
+
+extern EventLog eventLog;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <initializer_list>
+
+// Список фиксированной ёмкости без обращений к куче.
+// push_back() при заполненном списке возвращает false.
+template <typename T, size_t N>
+class FixedList {
+public:
+  FixedList() : count(0) {}
+  FixedList(std::initializer_list<T> list) : count(0) {
+    for (const T &item : list) push_back(item);
+  }
+
+  bool push_back(const T &item) {
+    if (count >= N) return false;
+    items[count++] = item;
+    return true;
+  }
+  void erase(T *position) {
+    for (T *p = position; p + 1 < end(); p++) *p = *(p + 1);
+    count--;
+  }
+  void clear() { count = 0; }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count >= N; }
+  static constexpr size_t capacity() { return N; }
+
+  T &operator[](size_t i) { return items[i]; }
+  const T &operator[](size_t i) const { return items[i]; }
+  T *begin() { return items; }
+  T *end() { return items + count; }
+  const T *begin() const { return items; }
+  const T *end() const { return items + count; }
+
+private:
+  T items[N];
+  size_t count;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+// Строка фиксированной ёмкости, хранящаяся прямо в структуре.
+// Не обращается к куче; слишком длинное значение обрезается,
+// assign() в этом случае возвращает false.
+template <size_t N>
+class FixedString {
+public:
+  FixedString() : len(0) { buf[0] = 0; }
+  FixedString(const char *s) { assign(s); }
+  FixedString(const String &s) { assign(s.c_str(), s.length()); }
+
+  FixedString &operator=(const char *s) {
+    assign(s);
+    return *this;
+  }
+  FixedString &operator=(const String &s) {
+    assign(s.c_str(), s.length());
+    return *this;
+  }
+
+  bool assign(const char *s, size_t length) {
+    bool fits = length <= N;
+    len = fits ? length : N;
+    memcpy(buf, s, len);
+    buf[len] = 0;
+    return fits;
+  }
+  bool assign(const char *s) { return s ? assign(s, strlen(s)) : assign("", 0); }
+
+  const char *c_str() const { return buf; }
+  size_t length() const { return len; }
+  bool isEmpty() const { return len == 0; }
+  static constexpr size_t capacity() { return N; }
+
+  bool operator==(const char *s) const { return strcmp(buf, s) == 0; }
+  bool operator!=(const char *s) const { return strcmp(buf, s) != 0; }
+  template <size_t M>
+  bool operator==(const FixedString<M> &other) const { return strcmp(buf, other.c_str()) == 0; }
+  template <size_t M>
+  bool operator!=(const FixedString<M> &other) const { return strcmp(buf, other.c_str()) != 0; }
+
+private:
+  char buf[N + 1];
+  size_t len;
+};
@@ -0,0 +1,237 @@
+#include "fleet_rollout.h"
+#include <ArduinoJson.h>
+#include <vector>
+#include "hal.h"
+#include "ota_job.h"
+#include "update_agent.h"
+#include "version.h"
+
+FleetRollout fleetRollout;
+
+static const char *stateFile = "/rollout.state";
+static const uint32_t STATE_MAGIC = 0x31544f52; // "ROT1"
+static const char *VERSION_CHARS = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.-+_";
+
+// Ожидаемая версия записывается перед загрузкой и проверяется после
+// перезагрузки
+struct StateRecord {
+  uint32_t magic;
+  uint32_t handled;
+  char version[24];
+};
+
+// FNV-1a, можно продолжать с предыдущего значения
+static uint32_t fnv(const uint8_t *data, size_t length, uint32_t h = 2166136261u) {
+  while (length--) {
+    h ^= *data++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static uint32_t fnv(const char *text, uint32_t h = 2166136261u) {
+  return fnv((const uint8_t *)text, strlen(text), h);
+}
+
+FleetRollout::FleetRollout()
+  : publish(nullptr), state(IDLE), handled(0), scheduledAt(0), slot(0), progressAt(0), dirty(false),
+    mux(portMUX_INITIALIZER_UNLOCKED) {
+  id[0] = group[0] = device[0] = statusTopic[0] = 0;
+  version[0] = sha256[0] = error[0] = 0;
+}
+
+void FleetRollout::begin(const char *deviceID, PublishFn fn) {
+  publish = fn;
+  strlcpy(id, deviceID, sizeof(id));
+  snprintf(device, sizeof(device), "pcc/%s/ota", deviceID);
+  snprintf(statusTopic, sizeof(statusTopic), "pcc/%s/ota/status", deviceID);
+
+  std::vector<uint8_t> data;
+  if (!hal::fileRead(stateFile, data)) return;
+  hal::fileRemove(stateFile);
+  StateRecord record;
+  if (data.size() != sizeof(record)) return;
+  memcpy(&record, data.data(), sizeof(record));
+  if (record.magic != STATE_MAGIC) return;
+  record.version[sizeof(record.version) - 1] = 0;
+
+  // Та же команда, пришедшая retained после перезагрузки, не повторяется
+  handled = record.handled;
+  strlcpy(version, record.version, sizeof(version));
+  if (compareVersions(version, FIRMWARE_VERSION) == 0) {
+    setState(INSTALLED);
+  } else {
+    // Загрузка прервалась или загрузчик откатился на прежний образ
+    char message[64];
+    snprintf(message, sizeof(message), "running %s after install", FIRMWARE_VERSION);
+    setState(FAILED, message);
+  }
+}
+
+void FleetRollout::setGroup(const char *name) {
+  if (*name) {
+    snprintf(group, sizeof(group), "pcc/group/%s/ota", name);
+  } else {
+    group[0] = 0;
+  }
+}
+
+bool FleetRollout::matches(const char *topic) const {
+  return strcmp(topic, device) == 0 || (group[0] && strcmp(topic, group) == 0);
+}
+
+void FleetRollout::setState(State next, const char *message) {
+  portENTER_CRITICAL(&mux);
+  state = next;
+  strlcpy(error, message, sizeof(error));
+  portEXIT_CRITICAL(&mux);
+  dirty = true;
+}
+
+void FleetRollout::announce(const uint8_t *payload, size_t length, unsigned long now) {
+  uint32_t hash = fnv(payload, length);
+  if (hash == handled) return;
+  if (state == DOWNLOADING || state == REBOOTING) {
+    Serial.println("Rollout: update in progress, announcement ignored");
+    return;
+  }
+  handled = hash;
+
+  JsonDocument doc;
+  DeserializationError parseError = deserializeJson(doc, payload, length);
+  const char *newVersion = doc["version"];
+  const char *newUrl = doc["url"];
+  const char *digest = doc["sha256"];
+  // Версия попадает в JSON статуса как есть, поэтому набор символов ограничен
+  if (parseError || !newVersion || !newUrl || !digest || !*digest || !OtaJob::validDigest(digest) ||
+      strlen(newVersion) >= sizeof(version) ||
+      newVersion[strspn(newVersion, VERSION_CHARS)] || !url.assign(newUrl)) {
+    portENTER_CRITICAL(&mux);
+    version[0] = 0;
+    portEXIT_CRITICAL(&mux);
+    setState(FAILED, "invalid announcement");
+    return;
+  }
+  portENTER_CRITICAL(&mux);
+  strlcpy(version, newVersion, sizeof(version));
+  portEXIT_CRITICAL(&mux);
+  strlcpy(sha256, digest, sizeof(sha256));
+
+  if (compareVersions(version, FIRMWARE_VERSION) <= 0) {
+    char message[64];
+    snprintf(message, sizeof(message), "not newer than %s", FIRMWARE_VERSION);
+    setState(REFUSED, message);
+    Serial.printf("Rollout: %s refused, running %s\n", version, FIRMWARE_VERSION);
+    return;
+  }
+
+  // Слот зависит только от устройства и версии: повтор команды или
+  // перезагрузка не сдвигают его внутри окна
+  unsigned long window = doc["window"] | 0UL;
+  if (window > ROLLOUT_WINDOW_MAX) window = ROLLOUT_WINDOW_MAX;
+  uint32_t h = fnv(version, fnv(id));
+  portENTER_CRITICAL(&mux);
+  scheduledAt = now;
+  slot = window ? h % (window * 1000UL) : 0;
+  portEXIT_CRITICAL(&mux);
+  setState(SCHEDULED);
+  Serial.printf("Rollout: %s scheduled in %lu s\n", version, slot / 1000);
+}
+
+void FleetRollout::retryLater(unsigned long now) {
+  portENTER_CRITICAL(&mux);
+  slot = now - scheduledAt + ROLLOUT_RETRY_MS;
+  portEXIT_CRITICAL(&mux);
+  dirty = true;
+}
+
+void FleetRollout::start(unsigned long now) {
+  if (otaJob.busy() || updateAgent.checking()) {
+    retryLater(now);
+    return;
+  }
+  StateRecord record = {STATE_MAGIC, handled, {0}};
+  strlcpy(record.version, version, sizeof(record.version));
+  if (!hal::fileWrite(stateFile, (const uint8_t *)&record, sizeof(record))) {
+    Serial.println("Rollout: failed to save state");
+  }
+  OtaJob::StartResult result = otaJob.start(url.c_str(), sha256);
+  if (result != OtaJob::STARTED) {
+    hal::fileRemove(stateFile);
+    // Другая загрузка заняла раздел OTA первой - слот откладывается
+    if (result == OtaJob::BUSY || result == OtaJob::UPLOAD_RUNNING) {
+      Serial.printf("Rollout: %s, retrying later\n", OtaJob::startError(result));
+      retryLater(now);
+    } else {
+      setState(FAILED, OtaJob::startError(result));
+    }
+    return;
+  }
+  progressAt = now;
+  setState(DOWNLOADING);
+}
+
+void FleetRollout::loop(unsigned long now, bool connected) {
+  if (state == SCHEDULED && now - scheduledAt >= slot) {
+    start(now);
+  } else if (state == DOWNLOADING) {
+    OtaJob::Status job = otaJob.status();
+    if (job.state == OtaJob::FAILED) {
+      hal::fileRemove(stateFile);
+      setState(FAILED, job.error);
+    } else if (job.state == OtaJob::DONE) {
+      // Задача OTA перезагрузит устройство через секунду
+      setState(REBOOTING);
+    } else if (now - progressAt >= ROLLOUT_PROGRESS_MS) {
+      progressAt = now;
+      dirty = true;
+    }
+  }
+
+  if (!dirty || !connected || !publish) return;
+  char payload[ROLLOUT_STATUS_TEXT];
+  toJson(payload, sizeof(payload), now);
+  if (publish(statusTopic, payload, true)) dirty = false;
+}
+
+FleetRollout::Status FleetRollout::status(unsigned long now) const {
+  Status s;
+  portENTER_CRITICAL(&mux);
+  s.state = state;
+  strlcpy(s.version, version, sizeof(s.version));
+  strlcpy(s.error, error, sizeof(s.error));
+  long left = (long)(scheduledAt + slot - now);
+  portEXIT_CRITICAL(&mux);
+  s.slotIn = s.state == SCHEDULED && left > 0 ? left : 0;
+  s.written = 0;
+  s.total = 0;
+  if (s.state == DOWNLOADING || s.state == REBOOTING) {
+    OtaJob::Status job = otaJob.status();
+    s.written = job.written;
+    s.total = job.total;
+  }
+  return s;
+}
+
+size_t FleetRollout::toJson(char *out, size_t size, unsigned long now) const {
+  Status s = status(now);
+  int n = snprintf(out, size,
+                   "{\"state\":\"%s\",\"version\":\"%s\",\"current\":\"%s\",\"slot_in\":%lu,"
+                   "\"written\":%u,\"total\":%u,\"error\":\"%s\"}",
+                   stateName(s.state), s.version, FIRMWARE_VERSION, s.slotIn / 1000, (unsigned)s.written,
+                   (unsigned)s.total, s.error);
+  return n < 0 ? 0 : (size_t)n < size ? n : size - 1;
+}
+
+const char *FleetRollout::stateName(State state) {
+  switch (state) {
+    case IDLE: return "idle";
+    case SCHEDULED: return "scheduled";
+    case DOWNLOADING: return "downloading";
+    case REBOOTING: return "rebooting";
+    case INSTALLED: return "installed";
+    case REFUSED: return "refused";
+    case FAILED: return "failed";
+  }
+  return "unknown";
+}
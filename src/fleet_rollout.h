@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+#include "fixed_string.h"
+
+// Наибольшее окно раскатки, с
+#define ROLLOUT_WINDOW_MAX 86400UL
+// Период публикации прогресса загрузки, мс
+#define ROLLOUT_PROGRESS_MS 5000
+// Повтор, если в момент слота уже идёт другое обновление, мс
+#define ROLLOUT_RETRY_MS 30000
+// Длина текста статуса в MQTT
+#define ROLLOUT_STATUS_TEXT 256
+
+// Поэтапная раскатка прошивки по MQTT. Команда приходит в топик группы
+// pcc/group/<ota_group>/ota или в топик устройства pcc/<deviceID>/ota:
+//   {"version":"1.2.4","url":"http://.../firmware.bin.gz","sha256":"...","window":600}
+// Устройство выбирает слот в пределах window секунд по хэшу deviceID и
+// версии, так что вся группа не качает образ одновременно, а порядок от
+// выпуска к выпуску меняется. Версия не новее текущей отклоняется.
+// Состояние публикуется retained в pcc/<deviceID>/ota/status; итог
+// установки сообщается после перезагрузки по файлу /rollout.state.
+// Все методы, кроме status() и toJson(), вызывает сетевая задача.
+class FleetRollout {
+public:
+  enum State : uint8_t { IDLE, SCHEDULED, DOWNLOADING, REBOOTING, INSTALLED, REFUSED, FAILED };
+  typedef bool (*PublishFn)(const char *topic, const char *payload, bool retained);
+
+  struct Status {
+    State state;
+    char version[24];
+    unsigned long slotIn;  // мс до начала загрузки
+    size_t written;
+    size_t total;
+    char error[64];
+  };
+
+  FleetRollout();
+
+  // Итог установки, начатой до перезагрузки; файловая система смонтирована
+  void begin(const char *deviceID, PublishFn fn);
+  // Топик группы; пустая группа - только топик устройства
+  void setGroup(const char *group);
+  const char *groupTopic() const { return group; }
+  const char *deviceTopic() const { return device; }
+  bool matches(const char *topic) const;
+
+  // Команда из MQTT; повтор той же команды (retained) игнорируется
+  void announce(const uint8_t *payload, size_t length, unsigned long now);
+  void loop(unsigned long now, bool connected);
+  // Повторная публикация статуса после подключения к брокеру
+  void republish() { dirty = state != IDLE; }
+
+  Status status(unsigned long now) const;
+  size_t toJson(char *out, size_t size, unsigned long now) const;
+  static const char *stateName(State state);
+
+private:
+  void setState(State next, const char *message = "");
+  void start(unsigned long now);
+  void retryLater(unsigned long now);
+
+  char id[32];
+  char group[64];
+  char device[64];
+  char statusTopic[72];
+  PublishFn publish;
+
+  State state;
+  char version[24];
+  FixedString<192> url;
+  char sha256[65];
+  char error[64];
+  uint32_t handled;       // хэш последней принятой команды
+  unsigned long scheduledAt;
+  unsigned long slot;
+  unsigned long progressAt;
+  bool dirty;
+  mutable portMUX_TYPE mux;
+};
+
+extern FleetRollout fleetRollout;
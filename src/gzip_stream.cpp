@@ -0,0 +1,190 @@
+#include "gzip_stream.h"
+#include <esp_rom_crc.h>
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_ESP32S2
+  #include "esp32s2/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32S3
+  #include "esp32s3/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32C3
+  #include "esp32c3/rom/miniz.h"
+#else
+  #include "esp32/rom/miniz.h"
+#endif
+
+// Флаги заголовка gzip (RFC 1952)
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+// Этапы разбора необязательных полей заголовка
+enum { STAGE_EXTRA_LEN, STAGE_EXTRA, STAGE_NAME, STAGE_COMMENT, STAGE_HCRC, STAGE_BODY };
+
+GzipStream::GzipStream()
+  : state(FAILED), message(nullptr), inflator(nullptr), dict(nullptr), dictOffset(0), produced(0), crc(0),
+    headerLen(0), stage(0), stageBytes(0), skip(0), trailerLen(0) {
+}
+
+GzipStream::~GzipStream() {
+  end();
+}
+
+bool GzipStream::isGzip(const uint8_t *data, size_t len) {
+  return len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+bool GzipStream::begin(Sink output) {
+  end();
+  inflator = malloc(sizeof(tinfl_decompressor));
+  dict = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+  if (!inflator || !dict) {
+    end();
+    return fail("Not enough memory for gzip");
+  }
+  tinfl_init((tinfl_decompressor *)inflator);
+  sink = output;
+  state = HEADER;
+  message = nullptr;
+  dictOffset = 0;
+  produced = 0;
+  crc = 0;
+  headerLen = 0;
+  stage = STAGE_EXTRA_LEN;
+  stageBytes = 0;
+  skip = 0;
+  trailerLen = 0;
+  return true;
+}
+
+void GzipStream::end() {
+  free(inflator);
+  free(dict);
+  inflator = nullptr;
+  dict = nullptr;
+}
+
+bool GzipStream::fail(const char *text) {
+  state = FAILED;
+  message = text;
+  return false;
+}
+
+// Возвращает число поглощённых байт заголовка
+size_t GzipStream::parseHeader(const uint8_t *data, size_t len) {
+  size_t used = 0;
+  while (used < len && headerLen < sizeof(header)) {
+    header[headerLen++] = data[used++];
+  }
+  if (headerLen < sizeof(header)) return used;
+  if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8) {
+    fail("Not a gzip deflate stream");
+    return used;
+  }
+  uint8_t flags = header[3];
+
+  while (stage != STAGE_BODY) {
+    // Пропуск этапов для отсутствующих полей
+    if ((stage == STAGE_EXTRA_LEN && !(flags & GZIP_FEXTRA)) ||
+        (stage == STAGE_EXTRA && skip == 0) ||
+        (stage == STAGE_NAME && !(flags & GZIP_FNAME)) ||
+        (stage == STAGE_COMMENT && !(flags & GZIP_FCOMMENT))) {
+      stage++;
+      if (stage == STAGE_HCRC) skip = 0;
+      continue;
+    }
+    if (stage == STAGE_HCRC && (!(flags & GZIP_FHCRC) || skip == 2)) {
+      stage = STAGE_BODY;
+      continue;
+    }
+    if (used == len) return used;
+
+    uint8_t c = data[used++];
+    switch (stage) {
+      case STAGE_EXTRA_LEN:
+        // Длина FEXTRA - два байта little-endian
+        if (stageBytes == 0) {
+          skip = c;
+          stageBytes = 1;
+        } else {
+          skip |= (uint16_t)c << 8;
+          stageBytes = 0;
+          stage = STAGE_EXTRA;
+        }
+        break;
+      case STAGE_EXTRA:
+        skip--;
+        break;
+      case STAGE_NAME:
+      case STAGE_COMMENT:
+        if (c == 0) {
+          stage++;
+          skip = 0;
+        }
+        break;
+      case STAGE_HCRC:
+        skip++;
+        break;
+    }
+  }
+  state = INFLATE;
+  return used;
+}
+
+bool GzipStream::flush(size_t len) {
+  if (!len) return true;
+  crc = esp_rom_crc32_le(crc, dict + dictOffset, len);
+  produced += len;
+  if (!sink(dict + dictOffset, len)) return fail("Output write failed");
+  dictOffset = (dictOffset + len) & (TINFL_LZ_DICT_SIZE - 1);
+  return true;
+}
+
+bool GzipStream::write(const uint8_t *data, size_t len) {
+  while (len > 0 || state == INFLATE) {
+    if (state == FAILED) return false;
+
+    if (state == HEADER) {
+      size_t used = parseHeader(data, len);
+      data += used;
+      len -= used;
+      if (state == HEADER) return true;
+      continue;
+    }
+
+    if (state == INFLATE) {
+      size_t inBytes = len;
+      size_t outBytes = TINFL_LZ_DICT_SIZE - dictOffset;
+      tinfl_status status = tinfl_decompress((tinfl_decompressor *)inflator, data, &inBytes, dict, dict + dictOffset,
+                                             &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+      data += inBytes;
+      len -= inBytes;
+      if (!flush(outBytes)) return false;
+      if (status < TINFL_STATUS_DONE) return fail("Corrupt deflate data");
+      if (status == TINFL_STATUS_DONE) {
+        state = TRAILER;
+        continue;
+      }
+      if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) return true;
+      continue;
+    }
+
+    if (state == TRAILER) {
+      while (len > 0 && trailerLen < sizeof(trailer)) {
+        trailer[trailerLen++] = *data++;
+        len--;
+      }
+      if (trailerLen < sizeof(trailer)) return true;
+      uint32_t expectedCrc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+      uint32_t expectedSize = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | ((uint32_t)trailer[7] << 24);
+      if (expectedCrc != crc) return fail("gzip CRC mismatch");
+      if (expectedSize != (uint32_t)produced) return fail("gzip size mismatch");
+      state = DONE;
+      end();
+      continue;
+    }
+
+    // Данные после конца потока игнорируются
+    if (state == DONE) return true;
+  }
+  return state != FAILED;
+}
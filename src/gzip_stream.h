@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+// Потоковая распаковка gzip в фиксированном буфере (словарь 32 КБ + состояние
+// inflate из ROM). Распакованные данные передаются в sink по мере готовности,
+// образ целиком в памяти не хранится.
+class GzipStream {
+public:
+  typedef std::function<bool(uint8_t *data, size_t len)> Sink;
+
+  GzipStream();
+  ~GzipStream();
+
+  static bool isGzip(const uint8_t *data, size_t len);
+
+  // Выделение буферов и сброс состояния
+  bool begin(Sink sink);
+  void end();
+
+  // Подача очередной порции сжатых данных
+  bool write(const uint8_t *data, size_t len);
+  // Поток завершён и контрольная сумма/размер сошлись
+  bool finished() const { return state == DONE; }
+  const char *error() const { return message; }
+  size_t outputSize() const { return produced; }
+
+private:
+  enum State { HEADER, INFLATE, TRAILER, DONE, FAILED };
+
+  bool fail(const char *text);
+  size_t parseHeader(const uint8_t *data, size_t len);
+  bool flush(size_t len);
+
+  Sink sink;
+  State state;
+  const char *message;
+  void *inflator;
+  uint8_t *dict;
+  size_t dictOffset;
+  size_t produced;
+  uint32_t crc;
+  uint8_t header[10];
+  uint8_t headerLen;
+  uint8_t stage;
+  uint8_t stageBytes;
+  uint16_t skip;
+  uint8_t trailer[8];
+  uint8_t trailerLen;
+};
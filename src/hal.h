@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+// Тонкий слой над железом: время, GPIO, файловая система, сеть, транспорт
+// MQTT и шина датчиков. Логика прошивки обращается к платформе только через него,
+// реализация для Arduino/ESP32 - в hal_arduino.cpp.
+namespace hal {
+
+// Время с момента старта
+unsigned long millis();
+unsigned long micros();
+
+// GPIO
+void gpioMode(int pin, int mode);
+void gpioWrite(int pin, int level);
+int gpioRead(int pin);
+void gpioAttach(int pin, void (*isr)(void *), void *arg);
+void gpioDetach(int pin);
+
+// Файловая система (монтируется один раз в setup())
+bool fileExists(const char *path);
+bool fileRead(const char *path, std::vector<uint8_t> &data);
+bool fileWrite(const char *path, const uint8_t *data, size_t len);
+bool fileAppend(const char *path, const uint8_t *data, size_t len);
+// Чтение части файла без загрузки целиком; возвращает число прочитанных байт
+size_t fileReadAt(const char *path, size_t offset, uint8_t *data, size_t len);
+// Размер файла; 0, если файла нет
+size_t fileSize(const char *path);
+bool fileRemove(const char *path);
+
+// Сеть: подключение к точке доступа и время UTC, секунды с 1970 года
+// (до синхронизации SNTP - заведомо меньше 1600000000)
+bool networkUp();
+time_t utcTime();
+// Уровень сигнала точки доступа, дБм
+int wifiRssi();
+// GET по http://. ifNoneMatch - значение If-None-Match (пустое - без
+// заголовка). Возвращает код ответа или отрицательную ошибку клиента;
+// etag и body заполняются только для 200
+int httpGet(const char *url, const char *ifNoneMatch, uint16_t timeout, std::string &etag, std::string &body);
+
+}
+
+// Транспорт MQTT
+class MqttTransport {
+public:
+  virtual ~MqttTransport() {}
+  virtual bool connect(const char *id, const char *user, const char *password) = 0;
+  virtual void disconnect() = 0;
+  virtual bool connected() = 0;
+  virtual bool loop() = 0;
+  virtual int state() = 0;
+  virtual bool publish(const char *topic, const char *payload, bool retained) = 0;
+  virtual bool subscribe(const char *topic) = 0;
+  virtual bool unsubscribe(const char *topic) = 0;
+};
+
+// ROM-адрес датчика 1-Wire
+typedef uint8_t TempAddress[8];
+
+// Шина датчиков температуры
+class TempBus {
+public:
+  virtual ~TempBus() {}
+  // Поиск датчиков на шине; возвращает число найденных (не больше max)
+  virtual uint8_t search(TempAddress *found, uint8_t max) = 0;
+  // Разрешение датчика, 9-12 бит
+  virtual bool setResolution(const uint8_t *address, uint8_t bits) = 0;
+  // Запуск конверсии на всех датчиках шины без ожидания результата
+  virtual void requestConversion() = 0;
+  // Показание датчика по адресу; DEVICE_DISCONNECTED_C (-127) при ошибке
+  virtual float read(const uint8_t *address) = 0;
+};
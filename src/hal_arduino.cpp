@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "hal.h"
+
+namespace hal {
+
+// Вызываются и из обработчика прерываний GPIO (InputEngine::push), который
+// должен работать при отключённом кэше флеша во время записи LittleFS
+unsigned long IRAM_ATTR millis() {
+  return ::millis();
+}
+
+unsigned long IRAM_ATTR micros() {
+  return ::micros();
+}
+
+void gpioMode(int pin, int mode) {
+  pinMode(pin, mode);
+}
+
+void IRAM_ATTR gpioWrite(int pin, int level) {
+  digitalWrite(pin, level);
+}
+
+int IRAM_ATTR gpioRead(int pin) {
+  return digitalRead(pin);
+}
+
+void gpioAttach(int pin, void (*isr)(void *), void *arg) {
+  attachInterruptArg(pin, isr, arg, CHANGE);
+}
+
+void gpioDetach(int pin) {
+  detachInterrupt(pin);
+}
+
+bool fileExists(const char *path) {
+  return LittleFS.exists(path);
+}
+
+bool fileRead(const char *path, std::vector<uint8_t> &data) {
+  File file = LittleFS.open(path, "r");
+  if (!file) return false;
+  data.resize(file.size());
+  bool ok = file.read(data.data(), data.size()) == data.size();
+  file.close();
+  return ok;
+}
+
+bool fileWrite(const char *path, const uint8_t *data, size_t len) {
+  File file = LittleFS.open(path, "w");
+  if (!file) return false;
+  bool ok = file.write(data, len) == len;
+  file.close();
+  return ok;
+}
+
+bool fileAppend(const char *path, const uint8_t *data, size_t len) {
+  File file = LittleFS.open(path, "a");
+  if (!file) return false;
+  bool ok = file.write(data, len) == len;
+  file.close();
+  return ok;
+}
+
+size_t fileReadAt(const char *path, size_t offset, uint8_t *data, size_t len) {
+  File file = LittleFS.open(path, "r");
+  if (!file) return 0;
+  size_t n = file.seek(offset) ? file.read(data, len) : 0;
+  file.close();
+  return n;
+}
+
+size_t fileSize(const char *path) {
+  if (!LittleFS.exists(path)) return 0;
+  File file = LittleFS.open(path, "r");
+  if (!file) return 0;
+  size_t size = file.size();
+  file.close();
+  return size;
+}
+
+bool fileRemove(const char *path) {
+  return LittleFS.remove(path);
+}
+
+bool networkUp() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+time_t utcTime() {
+  return time(nullptr);
+}
+
+int wifiRssi() {
+  return WiFi.RSSI();
+}
+
+int httpGet(const char *url, const char *ifNoneMatch, uint16_t timeout, std::string &etag, std::string &body) {
+  WiFiClient client;
+  HTTPClient http;
+  const char *headers[] = {"ETag"};
+  http.begin(client, url);
+  http.setTimeout(timeout);
+  http.collectHeaders(headers, 1);
+  if (*ifNoneMatch) {
+    http.addHeader("If-None-Match", ifNoneMatch);
+  }
+  int code = http.GET();
+  if (code == HTTP_CODE_OK) {
+    etag = http.header("ETag").c_str();
+    body = http.getString().c_str();
+  }
+  http.end();
+  return code;
+}
+
+}
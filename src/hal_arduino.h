@@ -0,0 +1,60 @@
+#pragma once
+
+#include <PubSubClient.h>
+#include <DallasTemperature.h>
+#include "hal.h"
+
+// MqttTransport поверх PubSubClient
+class PubSubTransport : public MqttTransport {
+public:
+  explicit PubSubTransport(PubSubClient &client) : client(client) {}
+
+  bool connect(const char *id, const char *user, const char *password) override {
+    return client.connect(id, user, password);
+  }
+  void disconnect() override { client.disconnect(); }
+  bool connected() override { return client.connected(); }
+  bool loop() override { return client.loop(); }
+  int state() override { return client.state(); }
+  bool publish(const char *topic, const char *payload, bool retained) override {
+    return client.publish(topic, payload, retained);
+  }
+  bool subscribe(const char *topic) override { return client.subscribe(topic); }
+  bool unsubscribe(const char *topic) override { return client.unsubscribe(topic); }
+
+private:
+  PubSubClient &client;
+};
+
+// TempBus поверх DallasTemperature; поиск идёт напрямую через OneWire,
+// чтение - по адресу, без повторного обхода шины. Владеет wire и sensors
+class DallasBus : public TempBus {
+public:
+  DallasBus(OneWire *wire, DallasTemperature *sensors) : wire(wire), sensors(sensors) {
+    sensors->setWaitForConversion(false);
+  }
+  ~DallasBus() override {
+    delete sensors;
+    delete wire;
+  }
+
+  uint8_t search(TempAddress *found, uint8_t max) override {
+    uint8_t count = 0;
+    TempAddress address;
+    wire->reset_search();
+    while (count < max && wire->search(address)) {
+      if (OneWire::crc8(address, 7) != address[7] || !sensors->validFamily(address)) continue;
+      memcpy(found[count++], address, sizeof(TempAddress));
+    }
+    return count;
+  }
+  bool setResolution(const uint8_t *address, uint8_t bits) override {
+    return sensors->setResolution(address, bits, true);
+  }
+  void requestConversion() override { sensors->requestTemperatures(); }
+  float read(const uint8_t *address) override { return sensors->getTempC(address); }
+
+private:
+  OneWire *wire;
+  DallasTemperature *sensors;
+};
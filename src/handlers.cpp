@@ -0,0 +1,276 @@
+#include "handlers.h"
+#include "boot_profile.h"
+#include "config.h"
+#include "config_store.h"
+#include "event_log.h"
+#include "fleet_rollout.h"
+#include "input_engine.h"
+#include "json_writer.h"
+#include "macro_engine.h"
+#include "metrics.h"
+#include "pulse_scheduler.h"
+#include "tasks.h"
+#include "telemetry.h"
+#include "temp_sampler.h"
+#include "topic_index.h"
+#include "wifi_scan.h"
+
+bool mqttPublish(const char *topic, const char *payload, bool retained) {
+  if (mqttTransport.publish(topic, payload, retained)) {
+    metrics.mqttPublished++;
+    return true;
+  }
+  metrics.mqttPublishErrors++;
+  return false;
+}
+
+void publishInputState(size_t index, bool state) {
+  const ButtonConfig &button = config.buttons[index];
+  if (button.topic.isEmpty() || !mqttTransport.connected()) return;
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/state", button.topic.c_str());
+  mqttPublish(topic, state ? "ON" : "OFF", true);
+}
+
+void handleMqttMessage(const char *topic, const uint8_t *payload, unsigned int length) {
+  // Отсчёт задержки команды до фронта на пине
+  uint32_t received = hal::micros();
+  Serial.printf("Message arrived [%s] %.*s\n", topic, (int)length, (const char *)payload);
+  metrics.mqttReceived++;
+
+  if (fleetRollout.matches(topic)) {
+    fleetRollout.announce(payload, length, hal::millis());
+    return;
+  }
+  uint8_t matches[TOPIC_MATCH_MAX];
+  size_t n = topicIndex.match(topic, matches, TOPIC_MATCH_MAX);
+  for (size_t i = 0; i < n; i++) {
+    const ButtonConfig &button = config.buttons[matches[i]];
+    MqttCommand cmd = parseCommand(payload, length, button.duration);
+    ActuationCommand command = {cmd.action == MqttCommand::CANCEL ? ActuationCommand::CANCEL : ActuationCommand::PULSE,
+                                (uint8_t)button.pin, (uint32_t)cmd.duration, received};
+    if (!enqueueActuation(command)) {
+      Serial.printf("Actuation queue full, button %s ignored\n", button.name.c_str());
+    } else if (cmd.action == MqttCommand::CANCEL) {
+      Serial.printf("Button %s released\n", button.name.c_str());
+    } else {
+      Serial.printf("Button %s triggered for %lu ms\n", button.name.c_str(), cmd.duration);
+    }
+  }
+  for (size_t i = 0; i < config.macros.size(); i++) {
+    const MacroConfig &macro = config.macros[i];
+    if (macro.topic.isEmpty() || macro.topic != topic) continue;
+    if (parseCommand(payload, length, 0).action == MqttCommand::CANCEL) {
+      if (macroEngine.stop(i)) eventLog.add(EVENT_MACRO, i, 0);
+    } else if (macroEngine.start(i, hal::millis())) {
+      wakeTask(TASK_ACTUATION);
+      eventLog.add(EVENT_MACRO, i, 1);
+      Serial.printf("Macro %s started\n", macro.name.c_str());
+    }
+  }
+}
+
+int handleTrigger(const char *pin, const char *duration, char *message, size_t size) {
+  uint32_t received = hal::micros();
+  if (!pin || !duration) {
+    snprintf(message, size, "Invalid parameters");
+    return 400;
+  }
+  // Длительность проверяется так же, как в командах MQTT: "-5" или "abc"
+  // не должны превращаться в импульс на 49 суток или в нулевой
+  unsigned long ms;
+  if (!parseDuration(duration, ms)) {
+    snprintf(message, size, "Invalid duration '%s'", duration);
+    return 400;
+  }
+  // atoi("abc") дал бы пин 0, а это тоже GPIO
+  char *end;
+  long number = strtol(pin, &end, 10);
+  if (!isdigit((unsigned char)*pin) || *end || number > 255) {
+    snprintf(message, size, "Invalid pin '%s'", pin);
+    return 400;
+  }
+  if (!pulses.owns(number)) {
+    snprintf(message, size, "PIN %ld is not an output button", number);
+    return 404;
+  }
+  if (!enqueueActuation(ActuationCommand{ActuationCommand::PULSE, (uint8_t)number, (uint32_t)ms, received})) {
+    snprintf(message, size, "Busy, try again");
+    return 503;
+  }
+  snprintf(message, size, "PIN %ld Triggered for %lu ms", number, ms);
+  return 200;
+}
+
+void renderButtonState(Print &out, unsigned long now) {
+  JsonWriter json(out);
+  json.beginArray();
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    if (button.mode == INPUT || button.mode == INPUT_PULLUP || button.mode == INPUT_PULLDOWN) {
+      json.beginObject()
+        .field("pin", button.pin)
+        .field("state", (int)inputs.state(i))
+        .field("id", i)
+        .field("since", now - inputs.changedAt(i))
+        .endObject();
+    }
+  }
+  json.endArray();
+}
+
+void renderTemperature(Print &out, unsigned long now) {
+  JsonWriter json(out);
+  json.beginObject().field("topology", tempSampler.topology()).beginArray("sensors");
+  TempSensor sensor;
+  for (size_t i = 0; tempSampler.sensor(i, sensor); i++) {
+    char address[SENSOR_ADDRESS_TEXT];
+    formatSensorAddress(sensor.address, address);
+    json.beginObject().field("id", i).field("address", address);
+    char label[SENSOR_ADDRESS_TEXT];
+    json.field("name", sensorLabel(config, sensor.address, label))
+      .field("present", sensor.present)
+      .field("resolution", sensor.resolution);
+    json.key("temp");
+    if (sensor.reading.valid) {
+      json.value(sensor.reading.value);
+    } else {
+      json.null();
+    }
+    json.field("age", sensor.reading.timestamp ? now - sensor.reading.timestamp : 0UL).endObject();
+  }
+  json.endArray().endObject();
+}
+
+// Отсчёт версий начинается со случайного числа, чтобы версия клиента,
+// полученная до перезагрузки, не совпала с новой
+static portMUX_TYPE stateMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t stateFingerprint = 0;
+static uint32_t stateVersion = 0;
+
+// Шаг FNV-1a по байтам значения
+static uint32_t fingerprintMix(uint32_t h, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    h ^= (value >> (i * 8)) & 0xff;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+uint32_t currentStateVersion() {
+  uint32_t h = fingerprintMix(2166136261u, config.buttons.size());
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    h = fingerprintMix(h, button.pin);
+    h = fingerprintMix(h, button.mode == OUTPUT ? pulses.isActive(button.pin) : inputs.state(i));
+  }
+  h = fingerprintMix(h, tempSampler.topology());
+  TempSensor sensor;
+  for (size_t i = 0; tempSampler.sensor(i, sensor); i++) {
+    uint32_t bits = 0;
+    if (sensor.reading.valid) memcpy(&bits, &sensor.reading.value, sizeof(bits));
+    h = fingerprintMix(h, sensor.present | sensor.reading.valid << 1);
+    h = fingerprintMix(h, bits);
+  }
+  h = fingerprintMix(h, mqtt.state());
+  portENTER_CRITICAL(&stateMux);
+  if (!stateVersion) {
+    stateVersion = esp_random() >> 1;
+  }
+  if (h != stateFingerprint) {
+    stateFingerprint = h;
+    if (!++stateVersion) stateVersion = 1;
+  }
+  uint32_t version = stateVersion;
+  portEXIT_CRITICAL(&stateMux);
+  return version;
+}
+
+// Массивы inputs и temps того же вида, что в событиях /live
+void renderApiState(Print &out, unsigned long now, const char *since) {
+  uint32_t version = currentStateVersion();
+  JsonWriter json(out);
+  json.beginObject().field("version", version);
+  if (since && strtoul(since, nullptr, 10) == version) {
+    json.field("unchanged", true).endObject();
+    return;
+  }
+  json.field("uptime", now).beginArray("inputs");
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    if (button.mode == OUTPUT) continue;
+    json.beginObject()
+      .field("id", i)
+      .field("name", button.name.c_str())
+      .field("state", inputs.state(i))
+      .field("since", now - inputs.changedAt(i))
+      .endObject();
+  }
+  json.endArray().beginArray("outputs");
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    if (button.mode != OUTPUT) continue;
+    json.beginObject()
+      .field("id", i)
+      .field("name", button.name.c_str())
+      .field("pin", button.pin)
+      .field("active", pulses.isActive(button.pin))
+      .endObject();
+  }
+  json.endArray().field("topology", tempSampler.topology()).beginArray("temps");
+  TempSensor sensor;
+  for (size_t i = 0; tempSampler.sensor(i, sensor); i++) {
+    char address[SENSOR_ADDRESS_TEXT];
+    json.beginObject().field("id", i).field("name", sensorLabel(config, sensor.address, address)).key("value");
+    if (sensor.reading.valid) {
+      json.value(sensor.reading.value);
+    } else {
+      json.null();
+    }
+    json.field("present", sensor.present).endObject();
+  }
+  json.endArray()
+    .beginObject("mqtt")
+    .field("connected", mqtt.state() == MqttConnection::CONNECTED)
+    .field("state", mqtt.stateName())
+    .endObject()
+    .endObject();
+}
+
+void renderMetrics(Print &out) {
+  metrics.render(out);
+  out.print("# TYPE pcc_mqtt_connected gauge\n");
+  out.printf("pcc_mqtt_connected %d\n", mqttTransport.connected() ? 1 : 0);
+  out.print("# TYPE pcc_mqtt_connect_attempts_total counter\n");
+  out.printf("pcc_mqtt_connect_attempts_total %u\n", mqtt.attempts());
+  out.print("# TYPE pcc_mqtt_connect_failures_total counter\n");
+  out.printf("pcc_mqtt_connect_failures_total %u\n", mqtt.failures());
+  out.print("# TYPE pcc_mqtt_reconnects_total counter\n");
+  out.printf("pcc_mqtt_reconnects_total %u\n", mqtt.connects());
+  out.print("# TYPE pcc_mqtt_disconnects_total counter\n");
+  out.printf("pcc_mqtt_disconnects_total %u\n", mqtt.disconnects());
+  PulseStats p = pulses.stats();
+  out.print("# TYPE pcc_pulses_completed_total counter\n");
+  out.printf("pcc_pulses_completed_total %u\n", p.completed);
+  out.print("# TYPE pcc_pulses_dropped_total counter\n");
+  out.printf("pcc_pulses_dropped_total %u\n", p.dropped);
+  out.print("# TYPE pcc_pulses_replaced_total counter\n");
+  out.printf("pcc_pulses_replaced_total %u\n", p.replaced);
+  pulses.latency().render(out, "pcc_command_latency_seconds", "pcc_command_latency_max_seconds");
+  out.print("# TYPE pcc_input_overflows_total counter\n");
+  out.printf("pcc_input_overflows_total %u\n", inputs.overflows());
+  out.print("# TYPE pcc_telemetry_messages_total counter\n");
+  out.printf("pcc_telemetry_messages_total %u\n", telemetry.messages());
+  out.print("# TYPE pcc_telemetry_bytes_total counter\n");
+  out.printf("pcc_telemetry_bytes_total %u\n", telemetry.bytes());
+  out.print("# TYPE pcc_event_log_writes_total counter\n");
+  out.printf("pcc_event_log_writes_total %u\n", eventLog.writes());
+  out.print("# TYPE pcc_event_log_dropped_total counter\n");
+  out.printf("pcc_event_log_dropped_total %u\n", eventLog.dropped());
+  out.print("# TYPE pcc_wifi_scans_total counter\n");
+  out.printf("pcc_wifi_scans_total %u\n", wifiScanner.scans());
+  renderTaskMetrics(out);
+  bootProfile.render(out);
+  out.print("# TYPE pcc_wifi_rssi_dbm gauge\n");
+  out.printf("pcc_wifi_rssi_dbm %d\n", hal::wifiRssi());
+}
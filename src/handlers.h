@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include "hal.h"
+#include "mqtt_connection.h"
+
+// Обработчики команд MQTT и тела страниц HTTP без привязки к веб-серверу
+// и PubSubClient: main.cpp только передаёт им запрос и отдаёт ответ, а
+// на хосте их вызывают тесты и бенчмарки. config читается под ConfigLock
+// вызывающего (обработчики HTTP) или из сетевой задачи.
+
+// Транспорт и подключение MQTT; в прошивке определены в main.cpp
+extern MqttTransport &mqttTransport;
+extern MqttConnection mqtt;
+
+// Публикация с учётом в метриках
+bool mqttPublish(const char *topic, const char *payload, bool retained);
+// Публикация состояния входа в <topic>/state (retained)
+void publishInputState(size_t index, bool state);
+
+// Входящее сообщение MQTT: анонс раскатки, команды кнопок в очередь
+// задачи actuation, запуск и остановка макросов
+void handleMqttMessage(const char *topic, const uint8_t *payload, unsigned int length);
+
+// /trigger?pin=<пин>&duration=<мс>: импульс на выходной кнопке через
+// очередь задачи actuation. pin и duration - значения параметров или
+// nullptr. Возвращает код ответа HTTP, текст ответа пишется в message
+int handleTrigger(const char *pin, const char *duration, char *message, size_t size);
+
+// /button_state: входы с состоянием и временем с последней смены
+void renderButtonState(Print &out, unsigned long now);
+// /temp: кэш сэмплера, шина OneWire не трогается
+void renderTemperature(Print &out, unsigned long now);
+
+// Версия для /api/state. Отпечаток входов, выходов, температур и связи с
+// брокером считается при запросе; при его смене версия растёт.
+uint32_t currentStateVersion();
+// /api/state. since - версия из ?since= или nullptr: при совпадении с
+// текущей ответ сокращается до {"version":N,"unchanged":true}
+void renderApiState(Print &out, unsigned long now, const char *since);
+
+// /metrics в формате Prometheus
+void renderMetrics(Print &out);
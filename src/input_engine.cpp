@@ -0,0 +1,125 @@
+#include "input_engine.h"
+#include "hal.h"
+
+InputEngine inputs;
+
+InputEngine::InputEngine()
+  : count(0), head(0), tail(0), overflowed(false), edgeCount(0), overflowCount(0), changeFn(nullptr),
+    mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+void IRAM_ATTR InputEngine::isr(void *arg) {
+  Channel *channel = static_cast<Channel *>(arg);
+  channel->engine->push(channel->id, hal::gpioRead(channel->pin));
+}
+
+// Единственный производитель - обработчик прерываний GPIO
+void IRAM_ATTR InputEngine::push(uint8_t channel, uint8_t level) {
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) >= INPUT_EDGE_BUFFER) {
+    overflowed.store(true, std::memory_order_relaxed);
+    return;
+  }
+  ring[h % INPUT_EDGE_BUFFER] = Edge{channel, level, (uint32_t)hal::millis()};
+  head.store(h + 1, std::memory_order_release);
+}
+
+// Прерывания отключаются до сброса таблицы, чтобы в буфер не попали
+// фронты старых пинов с номерами каналов, которые займут новые
+void InputEngine::clear() {
+  for (size_t i = 0; i < count; i++) {
+    hal::gpioDetach(channels[i].pin);
+  }
+  portENTER_CRITICAL(&mux);
+  count = 0;
+  tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+  portEXIT_CRITICAL(&mux);
+}
+
+bool InputEngine::addPin(size_t index, int pin, unsigned long debounce) {
+  bool level = hal::gpioRead(pin);
+  unsigned long now = hal::millis();
+  portENTER_CRITICAL(&mux);
+  if (count >= INPUT_MAX_CHANNELS) {
+    portEXIT_CRITICAL(&mux);
+    return false;
+  }
+  Channel &channel = channels[count];
+  channel = Channel{this, (uint8_t)count, index, pin, debounce, level, level, now, now};
+  count++;
+  portEXIT_CRITICAL(&mux);
+  hal::gpioAttach(pin, isr, &channel);
+  return true;
+}
+
+const InputEngine::Channel *InputEngine::find(size_t index) const {
+  for (size_t i = 0; i < count; i++) {
+    if (channels[i].index == index) return &channels[i];
+  }
+  return nullptr;
+}
+
+bool InputEngine::state(size_t index) const {
+  portENTER_CRITICAL(&mux);
+  const Channel *channel = find(index);
+  bool active = channel && !channel->stable;
+  portEXIT_CRITICAL(&mux);
+  return active;
+}
+
+unsigned long InputEngine::changedAt(size_t index) const {
+  portENTER_CRITICAL(&mux);
+  const Channel *channel = find(index);
+  unsigned long changed = channel ? channel->changed : 0;
+  portEXIT_CRITICAL(&mux);
+  return changed;
+}
+
+void InputEngine::loop(unsigned long now) {
+  struct Change {
+    size_t index;
+    bool state;
+    unsigned long timestamp;
+  };
+  Change changes[INPUT_MAX_CHANNELS];
+  size_t changed = 0;
+
+  portENTER_CRITICAL(&mux);
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  uint32_t h = head.load(std::memory_order_acquire);
+  for (; t != h; t++) {
+    const Edge &edge = ring[t % INPUT_EDGE_BUFFER];
+    if (edge.channel < count) {
+      channels[edge.channel].raw = edge.level;
+      channels[edge.channel].lastEdge = edge.time;
+      edgeCount++;
+    }
+  }
+  tail.store(t, std::memory_order_release);
+
+  // При переполнении часть фронтов потеряна, уровни перечитываются напрямую
+  if (overflowed.exchange(false, std::memory_order_relaxed)) {
+    overflowCount++;
+    for (size_t i = 0; i < count; i++) {
+      bool level = hal::gpioRead(channels[i].pin);
+      if (level != channels[i].raw) {
+        channels[i].raw = level;
+        channels[i].lastEdge = now;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    Channel &channel = channels[i];
+    if (channel.raw == channel.stable || now - channel.lastEdge < channel.debounce) continue;
+    channel.stable = channel.raw;
+    channel.changed = channel.lastEdge;
+    changes[changed++] = Change{channel.index, !channel.stable, channel.changed};
+  }
+  portEXIT_CRITICAL(&mux);
+
+  if (!changeFn) return;
+  for (size_t i = 0; i < changed; i++) {
+    changeFn(changes[i].index, changes[i].state, changes[i].timestamp);
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Максимальное число входов под контролем движка
+#define INPUT_MAX_CHANNELS 16
+// Ёмкость кольцевого буфера фронтов (степень двойки)
+#define INPUT_EDGE_BUFFER 64
+// Антидребезг по умолчанию, мс
+#define DEFAULT_INPUT_DEBOUNCE 30
+
+// Фронты входов захватываются в прерывании в кольцевой буфер без
+// блокировок, а антидребезг и уведомления выполняются в loop().
+// Таблица входов защищена спинлоком: её можно перенастраивать из
+// другой задачи, уведомления вызываются вне критической секции.
+class InputEngine {
+public:
+  // index - номер кнопки в config.buttons, state - активный уровень (LOW)
+  typedef void (*ChangeFn)(size_t index, bool state, unsigned long timestamp);
+
+  InputEngine();
+
+  void onChange(ChangeFn fn) { changeFn = fn; }
+
+  // Отключение прерываний и сброс всех входов
+  void clear();
+  bool addPin(size_t index, int pin, unsigned long debounce);
+
+  void loop(unsigned long now);
+
+  // Состояние входа кнопки после антидребезга; false, если вход неизвестен
+  bool state(size_t index) const;
+  // Время последней смены состояния, millis()
+  unsigned long changedAt(size_t index) const;
+  uint32_t edges() const { return edgeCount; }
+  uint32_t overflows() const { return overflowCount; }
+
+private:
+  struct Channel {
+    InputEngine *engine;
+    uint8_t id;
+    size_t index;
+    int pin;
+    unsigned long debounce;
+    bool raw;
+    bool stable;
+    unsigned long lastEdge;
+    unsigned long changed;
+  };
+
+  struct Edge {
+    uint8_t channel;
+    uint8_t level;
+    uint32_t time;
+  };
+
+  static void IRAM_ATTR isr(void *arg);
+  void IRAM_ATTR push(uint8_t channel, uint8_t level);
+  const Channel *find(size_t index) const;
+
+  Channel channels[INPUT_MAX_CHANNELS];
+  size_t count;
+  Edge ring[INPUT_EDGE_BUFFER];
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  std::atomic<bool> overflowed;
+  uint32_t edgeCount;
+  uint32_t overflowCount;
+  ChangeFn changeFn;
+  mutable portMUX_TYPE mux;
+};
+
+extern InputEngine inputs;
@@ -0,0 +1,128 @@
+#include "json_writer.h"
+#include <math.h>
+#include <stdarg.h>
+
+JsonWriter::JsonWriter(Print &out) : out(out), depth(0), hasItems(0), afterKey(false) {
+}
+
+void JsonWriter::separate() {
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  uint16_t bit = 1u << depth;
+  if (hasItems & bit) out.write((uint8_t)',');
+  hasItems |= bit;
+}
+
+void JsonWriter::open(const char *name, char bracket) {
+  if (name) key(name);
+  separate();
+  out.write((uint8_t)bracket);
+  // Глубже JSON_WRITER_DEPTH запятые расставляются неверно, но запись
+  // за пределы hasItems не выходит
+  if (depth < JSON_WRITER_DEPTH) depth++;
+  hasItems &= ~(1u << depth);
+}
+
+void JsonWriter::close(char bracket) {
+  out.write((uint8_t)bracket);
+  if (depth) depth--;
+}
+
+JsonWriter &JsonWriter::beginObject(const char *name) {
+  open(name, '{');
+  return *this;
+}
+
+JsonWriter &JsonWriter::endObject() {
+  close('}');
+  return *this;
+}
+
+JsonWriter &JsonWriter::beginArray(const char *name) {
+  open(name, '[');
+  return *this;
+}
+
+JsonWriter &JsonWriter::endArray() {
+  close(']');
+  return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *name) {
+  value(name);
+  out.write((uint8_t)':');
+  afterKey = true;
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(const char *text) {
+  if (!text) return null();
+  separate();
+  out.write((uint8_t)'"');
+  // Подряд идущие обычные символы пишутся одним куском
+  const char *run = text;
+  for (const char *p = text;; p++) {
+    uint8_t c = *p;
+    if (c && c >= 0x20 && c != '"' && c != '\\') continue;
+    if (p > run) out.write((const uint8_t *)run, p - run);
+    if (!c) break;
+    char escape[7];
+    if (c == '"' || c == '\\') {
+      escape[0] = '\\';
+      escape[1] = c;
+      escape[2] = 0;
+    } else if (c == '\n') {
+      strcpy(escape, "\\n");
+    } else {
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+    }
+    out.write((const uint8_t *)escape, strlen(escape));
+    run = p + 1;
+  }
+  out.write((uint8_t)'"');
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(bool flag) {
+  separate();
+  if (flag) {
+    out.write((const uint8_t *)"true", 4);
+  } else {
+    out.write((const uint8_t *)"false", 5);
+  }
+  return *this;
+}
+
+void JsonWriter::number(const char *format, ...) {
+  char text[24];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  separate();
+  out.write((const uint8_t *)text, n < (int)sizeof(text) ? n : sizeof(text) - 1);
+}
+
+JsonWriter &JsonWriter::value(long number) {
+  this->number("%ld", number);
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(unsigned long number) {
+  this->number("%lu", number);
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(double number) {
+  if (isnan(number) || isinf(number)) return null();
+  this->number("%.6g", number);
+  return *this;
+}
+
+JsonWriter &JsonWriter::null() {
+  separate();
+  out.write((const uint8_t *)"null", 4);
+  return *this;
+}
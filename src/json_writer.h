@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Наибольшая вложенность объектов и массивов
+#define JSON_WRITER_DEPTH 8
+
+// Потоковая запись JSON в Print (AsyncResponseStream, Serial): значения
+// пишутся сразу, без документа в памяти, запятые и экранирование строк -
+// забота писателя. Строка nullptr и нечисловые float пишутся как null.
+//   JsonWriter json(*response);
+//   json.beginObject().field("state", true).beginArray("items").value(1).endArray().endObject();
+class JsonWriter {
+public:
+  explicit JsonWriter(Print &out);
+
+  JsonWriter &beginObject(const char *name = nullptr);
+  JsonWriter &endObject();
+  JsonWriter &beginArray(const char *name = nullptr);
+  JsonWriter &endArray();
+
+  // Значение элемента массива или, после key(), поля объекта
+  JsonWriter &key(const char *name);
+  JsonWriter &value(const char *text);
+  JsonWriter &value(bool flag);
+  JsonWriter &value(int number) { return value((long)number); }
+  JsonWriter &value(unsigned int number) { return value((unsigned long)number); }
+  JsonWriter &value(long number);
+  JsonWriter &value(unsigned long number);
+  JsonWriter &value(double number);
+  JsonWriter &null();
+
+  template <typename T>
+  JsonWriter &field(const char *name, T v) {
+    key(name);
+    return value(v);
+  }
+
+private:
+  void separate();
+  void open(const char *name, char bracket);
+  void close(char bracket);
+  void number(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  Print &out;
+  uint8_t depth;
+  uint16_t hasItems;  // по биту на уровень: запятая перед следующим элементом
+  bool afterKey;
+};
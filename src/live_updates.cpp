@@ -0,0 +1,142 @@
+#include "live_updates.h"
+#include <stdarg.h>
+#include "temp_sampler.h"
+#include "hal.h"
+
+LiveUpdates live;
+
+LiveUpdates::LiveUpdates()
+  : events("/live"), current{}, lastSample(0), firstChange(0), mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+void LiveUpdates::begin(AsyncWebServer &server) {
+  events.onConnect([this](AsyncEventSourceClient *client) {
+    if (events.count() > LIVE_MAX_CLIENTS) {
+      Serial.println("Too many live clients, closing connection");
+      client->close();
+      return;
+    }
+    char json[LIVE_EVENT_SIZE];
+    if (snapshot(false, json, sizeof(json))) client->send(json, "state");
+  });
+  server.addHandler(&events);
+}
+
+void LiveUpdates::reset(size_t buttonCount) {
+  portENTER_CRITICAL(&mux);
+  current.inputCount = min(buttonCount, (size_t)CONFIG_MAX_BUTTONS);
+  memset(current.inputs, -1, sizeof(current.inputs));
+  memset(current.dirty, 0, sizeof(current.dirty));
+  current.anyDirty = false;
+  portEXIT_CRITICAL(&mux);
+}
+
+void LiveUpdates::setInput(size_t index, bool state) {
+  portENTER_CRITICAL(&mux);
+  if (index < current.inputCount && current.inputs[index] != (int8_t)state) {
+    bool known = current.inputs[index] >= 0;
+    current.inputs[index] = state;
+    if (known) {
+      if (!current.anyDirty && !current.tempsDirty) firstChange = hal::millis();
+      current.dirty[index] = true;
+      current.anyDirty = true;
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+// Дописывает в out по формату; false, если буфер кончился
+static bool append(char *out, size_t size, size_t &len, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(out + len, size - len, format, args);
+  va_end(args);
+  if (n < 0 || (size_t)n >= size - len) return false;
+  len += n;
+  return true;
+}
+
+bool LiveUpdates::snapshot(bool changedOnly, char *out, size_t size) const {
+  portENTER_CRITICAL(&mux);
+  State s = current;
+  portEXIT_CRITICAL(&mux);
+
+  size_t len = 0;
+  bool ok = append(out, size, len, "{\"inputs\":[");
+  bool first = true;
+  for (size_t i = 0; i < s.inputCount; i++) {
+    if (s.inputs[i] < 0 || (changedOnly && !s.dirty[i])) continue;
+    ok = ok && append(out, size, len, "%s{\"id\":%u,\"state\":%d}", first ? "" : ",", (unsigned)i, s.inputs[i]);
+    first = false;
+  }
+  ok = ok && append(out, size, len, "]");
+  if (!changedOnly || s.tempsDirty) {
+    ok = ok && append(out, size, len, ",\"temps\":[");
+    first = true;
+    for (size_t i = 0; i < s.tempCount; i++) {
+      if (changedOnly && !s.tempDirty[i]) continue;
+      if (s.tempValid[i]) {
+        ok = ok && append(out, size, len, "%s{\"id\":%u,\"value\":%.2f}", first ? "" : ",", (unsigned)i, s.temps[i]);
+      } else {
+        ok = ok && append(out, size, len, "%s{\"id\":%u,\"value\":null}", first ? "" : ",", (unsigned)i);
+      }
+      first = false;
+    }
+    ok = ok && append(out, size, len, "]");
+  }
+  if (!changedOnly || s.topologyDirty) {
+    ok = ok && append(out, size, len, ",\"topology\":%u", s.topology);
+  }
+  ok = ok && append(out, size, len, "}");
+  if (!ok) Serial.println("Live update does not fit the event buffer");
+  return ok;
+}
+
+void LiveUpdates::loop(unsigned long now) {
+  uint32_t samples = tempSampler.samples();
+  if (samples != lastSample) {
+    lastSample = samples;
+    uint32_t topology = tempSampler.topology();
+    portENTER_CRITICAL(&mux);
+    if (topology != current.topology) {
+      if (!current.anyDirty && !current.tempsDirty && !current.topologyDirty) firstChange = now;
+      current.topology = topology;
+      current.topologyDirty = true;
+    }
+    portEXIT_CRITICAL(&mux);
+    TempSensor sensor;
+    size_t i = 0;
+    for (; i < TEMP_MAX_SENSORS && tempSampler.sensor(i, sensor); i++) {
+      bool valid = sensor.reading.valid;
+      portENTER_CRITICAL(&mux);
+      if (valid != current.tempValid[i] || (valid && sensor.reading.value != current.temps[i])) {
+        if (!current.anyDirty && !current.tempsDirty) firstChange = now;
+        current.temps[i] = sensor.reading.value;
+        current.tempValid[i] = valid;
+        current.tempDirty[i] = true;
+        current.tempsDirty = true;
+      }
+      portEXIT_CRITICAL(&mux);
+    }
+    portENTER_CRITICAL(&mux);
+    current.tempCount = i;
+    portEXIT_CRITICAL(&mux);
+  }
+
+  // Остальные задачи состояние не меняют, читать его здесь можно без mux
+  if ((!current.anyDirty && !current.tempsDirty && !current.topologyDirty) || now - firstChange < LIVE_COALESCE_MS) {
+    return;
+  }
+
+  char json[LIVE_EVENT_SIZE];
+  if (events.count() > 0 && snapshot(true, json, sizeof(json))) {
+    events.send(json, "state");
+  }
+  portENTER_CRITICAL(&mux);
+  memset(current.dirty, 0, sizeof(current.dirty));
+  memset(current.tempDirty, 0, sizeof(current.tempDirty));
+  current.anyDirty = false;
+  current.tempsDirty = false;
+  current.topologyDirty = false;
+  portEXIT_CRITICAL(&mux);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "temp_sampler.h"
+
+// Окно объединения изменений перед отправкой, мс
+#define LIVE_COALESCE_MS 200
+// Максимум одновременно подключённых SSE-клиентов
+#define LIVE_MAX_CLIENTS 4
+// Буфер события: все входы и датчики в худшем случае
+#define LIVE_EVENT_SIZE 1024
+
+// Push-канал состояний входов и температур через Server-Sent Events.
+// Отправляются только изменения, накопленные за окно объединения.
+// При смене состава датчиков в событие попадает поле topology, по
+// которому страница перечитывает их список.
+// Состояние меняет сетевая задача, а полный снимок для нового клиента
+// собирается в задаче AsyncTCP, поэтому оно копируется под mux.
+class LiveUpdates {
+public:
+  LiveUpdates();
+
+  void begin(AsyncWebServer &server);
+  // Сброс известных состояний после изменения списка кнопок
+  void reset(size_t buttonCount);
+  // Сообщить текущее состояние входа; изменение попадёт в ближайшую отправку
+  void setInput(size_t index, bool state);
+  void loop(unsigned long now);
+
+  size_t clients() const { return events.count(); }
+
+private:
+  struct State {
+    int8_t inputs[CONFIG_MAX_BUTTONS];  // -1 - состояние ещё не известно
+    bool dirty[CONFIG_MAX_BUTTONS];
+    size_t inputCount;
+    bool anyDirty;
+    bool tempsDirty;
+    uint32_t topology;
+    bool topologyDirty;
+    float temps[TEMP_MAX_SENSORS];
+    bool tempValid[TEMP_MAX_SENSORS];
+    bool tempDirty[TEMP_MAX_SENSORS];
+    size_t tempCount;
+  };
+
+  // JSON события в out; false, если не поместилось
+  bool snapshot(bool changedOnly, char *out, size_t size) const;
+
+  AsyncEventSource events;
+  State current;
+  uint32_t lastSample;
+  unsigned long firstChange;
+  mutable portMUX_TYPE mux;
+};
+
+extern LiveUpdates live;
@@ -0,0 +1,295 @@
+#include "macro_engine.h"
+#include <errno.h>
+#include "pulse_scheduler.h"
+#include "input_engine.h"
+
+MacroEngine macroEngine;
+
+// Наибольшее число слов в шаге: if <кнопка> on goto <шаг>
+#define MACRO_MAX_TOKENS 6
+
+// Разбиение шага на слова; строка в кавычках - одно слово.
+// Слова записываются в buffer через 0, возвращается их число
+// или -1, если слов слишком много.
+static int tokenize(const char *text, size_t length, char *buffer, const char **tokens) {
+  int count = 0;
+  size_t i = 0;
+  while (i < length) {
+    while (i < length && isspace((unsigned char)text[i])) i++;
+    if (i >= length) break;
+    if (count == MACRO_MAX_TOKENS) return -1;
+    tokens[count++] = buffer;
+    if (text[i] == '"') {
+      for (i++; i < length && text[i] != '"'; i++) *buffer++ = text[i];
+      i++;
+    } else {
+      for (; i < length && !isspace((unsigned char)text[i]); i++) *buffer++ = text[i];
+    }
+    *buffer++ = 0;
+  }
+  return count;
+}
+
+static int findButton(const Config &config, const char *name) {
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    if (strcasecmp(config.buttons[i].name.c_str(), name) == 0) return i;
+  }
+  return -1;
+}
+
+// Только десятичные цифры: strtoul принимает и знак, так что "wait -1"
+// стал бы паузой почти в 50 суток
+static bool parseNumber(const char *text, uint32_t &value) {
+  if (!isdigit((unsigned char)*text)) return false;
+  char *end;
+  errno = 0;
+  unsigned long parsed = strtoul(text, &end, 10);
+  if (*end || errno == ERANGE || parsed > UINT32_MAX) return false;
+  value = parsed;
+  return true;
+}
+
+static bool parseState(const char *text, uint8_t &state) {
+  if (strcasecmp(text, "on") == 0) {
+    state = 1;
+  } else if (strcasecmp(text, "off") == 0) {
+    state = 0;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Разбор одного шага; текст ошибки без номера шага
+static bool compileStep(const Config &config, const char **tokens, int count, MacroStep &step,
+                        uint32_t &target, char *error, size_t errorSize) {
+  const char *op = tokens[0];
+  int button = count > 1 ? findButton(config, tokens[1]) : -1;
+  target = 0;
+  if (strcasecmp(op, "pulse") == 0 && (count == 2 || count == 3)) {
+    if (button < 0 || config.buttons[button].mode != OUTPUT) {
+      snprintf(error, errorSize, "'%s' is not an output", tokens[1]);
+      return false;
+    }
+    step.op = MacroStep::PULSE;
+    step.arg = config.buttons[button].pin;
+    step.ms = config.buttons[button].duration;
+    if (count == 3 && !parseNumber(tokens[2], step.ms)) {
+      snprintf(error, errorSize, "bad duration '%s'", tokens[2]);
+      return false;
+    }
+    return true;
+  }
+  if (strcasecmp(op, "wait") == 0 && count == 2) {
+    step.op = MacroStep::WAIT;
+    if (!parseNumber(tokens[1], step.ms)) {
+      snprintf(error, errorSize, "bad delay '%s'", tokens[1]);
+      return false;
+    }
+    return true;
+  }
+  bool waitInput = strcasecmp(op, "wait") == 0 && count == 4;
+  bool branch = strcasecmp(op, "if") == 0 && count == 5 && strcasecmp(tokens[3], "goto") == 0;
+  if (!waitInput && !branch) {
+    snprintf(error, errorSize, "unknown step '%s'", op);
+    return false;
+  }
+  if (button < 0 || config.buttons[button].mode == OUTPUT) {
+    snprintf(error, errorSize, "'%s' is not an input", tokens[1]);
+    return false;
+  }
+  step.arg = button;
+  if (!parseState(tokens[2], step.state)) {
+    snprintf(error, errorSize, "expected on/off, got '%s'", tokens[2]);
+    return false;
+  }
+  if (waitInput) {
+    step.op = MacroStep::WAIT_INPUT;
+    if (!parseNumber(tokens[3], step.ms)) {
+      snprintf(error, errorSize, "bad timeout '%s'", tokens[3]);
+      return false;
+    }
+    return true;
+  }
+  step.op = MacroStep::BRANCH;
+  step.ms = 0;
+  if (strcasecmp(tokens[4], "end") == 0) {
+    target = MACRO_END;
+  } else if (!parseNumber(tokens[4], target) || target == 0) {
+    snprintf(error, errorSize, "bad step number '%s'", tokens[4]);
+    return false;
+  }
+  return true;
+}
+
+bool compileMacro(const Config &config, const MacroConfig &macro, MacroProgram &out) {
+  out.count = 0;
+  out.valid = false;
+  out.error[0] = 0;
+  uint32_t targets[MACRO_MAX_STEPS];
+  char buffer[sizeof(macro.script)];
+  const char *tokens[MACRO_MAX_TOKENS];
+  const char *p = macro.script.c_str();
+  while (*p) {
+    size_t length = strcspn(p, ";\n");
+    int count = tokenize(p, length, buffer, tokens);
+    p += length;
+    if (*p) p++;
+    if (count == 0) continue;
+    if (out.count == MACRO_MAX_STEPS) {
+      snprintf(out.error, sizeof(out.error), "more than %d steps", MACRO_MAX_STEPS);
+      return false;
+    }
+    char error[MACRO_ERROR_TEXT - 10];
+    MacroStep &step = out.steps[out.count];
+    step = MacroStep{};
+    if (count < 0) {
+      snprintf(error, sizeof(error), "too many words");
+    }
+    if (count < 0 || !compileStep(config, tokens, count, step, targets[out.count], error, sizeof(error))) {
+      snprintf(out.error, sizeof(out.error), "step %u: %s", out.count + 1, error);
+      return false;
+    }
+    out.count++;
+  }
+  if (out.count == 0) {
+    snprintf(out.error, sizeof(out.error), "no steps");
+    return false;
+  }
+  // Переходы вперёд проверяются, когда известно число шагов
+  for (uint8_t i = 0; i < out.count; i++) {
+    if (out.steps[i].op != MacroStep::BRANCH) continue;
+    uint32_t target = targets[i];
+    if (target != MACRO_END && target > out.count + 1u) {
+      snprintf(out.error, sizeof(out.error), "step %u: no step %u", i + 1, target);
+      return false;
+    }
+    out.steps[i].target = target == MACRO_END || target == out.count + 1u ? MACRO_END : target - 1;
+  }
+  out.valid = true;
+  return true;
+}
+
+MacroEngine::MacroEngine() : programCount(0), mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+void MacroEngine::load(const Config &config) {
+  // Пока таблица перестраивается, она пуста для start() и loop()
+  portENTER_CRITICAL(&mux);
+  programCount = 0;
+  portEXIT_CRITICAL(&mux);
+  size_t count = config.macros.size();
+  for (size_t i = 0; i < count; i++) {
+    if (!compileMacro(config, config.macros[i], programs[i])) {
+      Serial.printf("Macro %s: %s\n", config.macros[i].name.c_str(), programs[i].error);
+    }
+    runs[i] = Run{IDLE, 0, false, 0, 0, 0};
+  }
+  portENTER_CRITICAL(&mux);
+  programCount = count;
+  portEXIT_CRITICAL(&mux);
+}
+
+bool MacroEngine::start(size_t index, unsigned long now) {
+  bool ok = false;
+  portENTER_CRITICAL(&mux);
+  if (index < programCount && programs[index].valid && runs[index].result != RUNNING) {
+    Run &run = runs[index];
+    run.result = RUNNING;
+    run.pc = 0;
+    run.entered = false;
+    run.started = now;
+    run.runs++;
+    ok = true;
+  }
+  portEXIT_CRITICAL(&mux);
+  return ok;
+}
+
+bool MacroEngine::stop(size_t index) {
+  bool ok = false;
+  portENTER_CRITICAL(&mux);
+  if (index < programCount && runs[index].result == RUNNING) {
+    Run &run = runs[index];
+    const MacroStep &step = programs[index].steps[run.pc];
+    if (run.entered && step.op == MacroStep::PULSE) pulses.cancel(step.arg);
+    finish(run, STOPPED);
+    ok = true;
+  }
+  portEXIT_CRITICAL(&mux);
+  return ok;
+}
+
+void MacroEngine::finish(Run &run, Result result) {
+  run.result = result;
+  run.entered = false;
+}
+
+void MacroEngine::loop(unsigned long now) {
+  portENTER_CRITICAL(&mux);
+  for (size_t i = 0; i < programCount; i++) {
+    Run &run = runs[i];
+    const MacroProgram &program = programs[i];
+    // Ограничение на число шагов за проход: цикл из переходов
+    // без ожиданий не займёт задачу целиком
+    for (uint8_t budget = MACRO_MAX_STEPS; run.result == RUNNING && budget; budget--) {
+      const MacroStep &step = program.steps[run.pc];
+      if (!run.entered) {
+        run.entered = true;
+        run.stepStart = now;
+        if (step.op == MacroStep::PULSE && !pulses.request(step.arg, step.ms)) {
+          finish(run, FAILED);
+          break;
+        }
+      }
+      uint8_t next = run.pc + 1;
+      bool elapsed = now - run.stepStart >= step.ms;
+      if (step.op == MacroStep::PULSE) {
+        // Импульс стартует по таймеру планировщика, ждём и его такт
+        if (now - run.stepStart < step.ms + PULSE_TICK_MS) break;
+      } else if (step.op == MacroStep::WAIT) {
+        if (!elapsed) break;
+      } else if (step.op == MacroStep::WAIT_INPUT) {
+        if (inputs.state(step.arg) != (bool)step.state) {
+          if (elapsed) finish(run, TIMEOUT);
+          break;
+        }
+      } else if (inputs.state(step.arg) == (bool)step.state) {
+        next = step.target;
+      }
+      run.entered = false;
+      if (next >= program.count) {
+        finish(run, DONE);
+      } else {
+        run.pc = next;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+MacroEngine::Status MacroEngine::status(size_t index, unsigned long now) const {
+  Status s = {IDLE, 0, 0, 0};
+  portENTER_CRITICAL(&mux);
+  if (index < programCount) {
+    const Run &run = runs[index];
+    s.result = run.result;
+    s.step = run.pc;
+    s.runs = run.runs;
+    s.elapsed = run.result == RUNNING ? now - run.started : 0;
+  }
+  portEXIT_CRITICAL(&mux);
+  return s;
+}
+
+const char *MacroEngine::resultName(Result result) {
+  switch (result) {
+    case IDLE: return "idle";
+    case RUNNING: return "running";
+    case DONE: return "done";
+    case TIMEOUT: return "timeout";
+    case STOPPED: return "stopped";
+    case FAILED: return "failed";
+  }
+  return "unknown";
+}
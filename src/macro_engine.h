@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// Максимальное число шагов в макросе
+#define MACRO_MAX_STEPS 16
+// Номер шага, означающий завершение макроса
+#define MACRO_END 0xFF
+// Длина текста ошибки компиляции
+#define MACRO_ERROR_TEXT 48
+
+// Шаг скомпилированного макроса. Кнопки уже разрешены в пины и
+// индексы входов, переходы - в номера шагов.
+struct MacroStep {
+  enum Op : uint8_t { PULSE, WAIT, WAIT_INPUT, BRANCH };
+  Op op;
+  uint8_t arg;     // пин выхода (PULSE) или индекс кнопки-входа
+  uint8_t state;   // ожидаемое состояние входа
+  uint8_t target;  // шаг перехода (BRANCH) или MACRO_END
+  uint32_t ms;     // длительность импульса, паузы или тайм-аут ожидания
+};
+
+struct MacroProgram {
+  MacroStep steps[MACRO_MAX_STEPS];
+  uint8_t count;
+  bool valid;
+  char error[MACRO_ERROR_TEXT];
+};
+
+// Компиляция текста макроса. Шаги разделяются ';' или переводом строки:
+//   pulse <кнопка> [мс]                  - импульс, следующий шаг после его окончания
+//   wait <мс>                            - пауза
+//   wait <кнопка> on|off <мс>            - ожидание состояния входа, по тайм-ауту макрос прерывается
+//   if <кнопка> on|off goto <шаг>|end    - переход при совпадении состояния входа
+// Имена кнопок с пробелами берутся в кавычки, шаги нумеруются с 1.
+bool compileMacro(const Config &config, const MacroConfig &macro, MacroProgram &out);
+
+// Неблокирующий исполнитель макросов; разные макросы выполняются
+// одновременно, один макрос - не более одного экземпляра за раз.
+// start()/stop() можно вызывать из любой задачи, loop() выполняет
+// задача actuation.
+class MacroEngine {
+public:
+  enum Result : uint8_t { IDLE, RUNNING, DONE, TIMEOUT, STOPPED, FAILED };
+
+  struct Status {
+    Result result;
+    uint8_t step;        // текущий шаг, с 0
+    uint32_t runs;       // запусков с момента загрузки
+    unsigned long elapsed;
+  };
+
+  MacroEngine();
+
+  // Компиляция макросов конфигурации; выполняющиеся макросы прерываются
+  void load(const Config &config);
+
+  // false - макрос неизвестен, не скомпилирован или уже выполняется
+  bool start(size_t index, unsigned long now);
+  bool stop(size_t index);
+
+  void loop(unsigned long now);
+
+  size_t count() const { return programCount; }
+  bool valid(size_t index) const { return index < programCount && programs[index].valid; }
+  const char *error(size_t index) const { return index < programCount ? programs[index].error : ""; }
+  Status status(size_t index, unsigned long now) const;
+
+  static const char *resultName(Result result);
+
+private:
+  struct Run {
+    Result result;
+    uint8_t pc;
+    bool entered;           // шаг начат, stepStart действителен
+    unsigned long started;
+    unsigned long stepStart;
+    uint32_t runs;
+  };
+
+  void finish(Run &run, Result result);
+
+  MacroProgram programs[CONFIG_MAX_MACROS];
+  Run runs[CONFIG_MAX_MACROS];
+  size_t programCount;
+  mutable portMUX_TYPE mux;
+};
+
+extern MacroEngine macroEngine;
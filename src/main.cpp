@@ -6,6 +6,32 @@
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include <PubSubClient.h>
+#include "config.h"
+#include "config_apply.h"
+#include "hal_arduino.h"
+#include "config_store.h"
+#include "version.h"
+#include "pulse_scheduler.h"
+#include "topic_index.h"
+#include "temp_sampler.h"
+#include "mqtt_connection.h"
+#include "live_updates.h"
+#include "input_engine.h"
+#include "ota_job.h"
+#include "update_agent.h"
+#include "metrics.h"
+#include "telemetry.h"
+#include "tasks.h"
+#include "macro_engine.h"
+#include "boot_profile.h"
+#include "wifi_cache.h"
+#include "wifi_scan.h"
+#include "event_log.h"
+#include "fleet_rollout.h"
+#include "json_writer.h"
+#include "handlers.h"
+#include <esp_system.h>
+#include <memory>
 #ifdef ESP32
   #include <Update.h>
   #include <HTTPUpdate.h>
@@ -13,10 +39,6 @@
   #include <ESP8266HTTPUpdate.h>
 #endif
 
-
-// Пины по умолчанию
-#define DEFAULT_ONE_WIRE_BUS 4 // Пин по умолчанию для подключения датчиков
-
 // // Объявление объектов
 // OneWire oneWire(oneWireBusPin);
 // DallasTemperature sensors(&oneWire);
@@ -25,33 +47,9 @@
 // AsyncWebServer server(80);
 // DNSServer dns;
 
-const char* configFile = "/config.json";
-
 // Уникальный идентификатор устройства
 String deviceID = String((uint32_t)ESP.getEfuseMac(), HEX);
 
-// Структура конфигурации для кнопок
-struct ButtonConfig {
-  String name;
-  int pin;
-  unsigned long duration;
-  String topic;
-  int mode;
-};
-
-// Структура основной конфигурации
-struct Config {
-  String ssid;
-  String password;
-  String mqtt_server;
-  String mqtt_user;
-  String mqtt_password;
-  String sensor1_name;
-  String sensor2_name;
-  int oneWireBus_pin;
-  std::vector<ButtonConfig> buttons;
-};
-
 // Config config = {
 //   "", "", "", "", "",
 //   "CPU", "CHIPSET",
@@ -64,109 +62,214 @@ AsyncWebServer server(80);
 DNSServer dns;
 WiFiClient espClient;
 PubSubClient client(espClient);
-OneWire *oneWire;
-DallasTemperature *sensors;
+PubSubTransport transport(client);
+MqttTransport &mqttTransport = transport;
+MqttConnection mqtt(transport);
 
-// Функция загрузки конфигурации
-void loadConfig() {
-  if (LittleFS.begin()) {
-    if (LittleFS.exists(configFile)) {
-      File file = LittleFS.open(configFile, "r");
-      if (file) {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, file);
-        if (!error) {
-          config.ssid = doc["ssid"].as<String>();
-          config.password = doc["password"].as<String>();
-          config.mqtt_server = doc["mqtt_server"].as<String>();
-          config.mqtt_user = doc["mqtt_user"].as<String>();
-          config.mqtt_password = doc["mqtt_password"].as<String>();
-          config.sensor1_name = doc["sensor1_name"].as<String>();
-          config.sensor2_name = doc["sensor2_name"].as<String>();
-          config.oneWireBus_pin = doc["oneWireBus_pin"].as<int>()  | DEFAULT_ONE_WIRE_BUS;;
-          // oneWireBusPin = config.oneWireBus_pin;
-
-          JsonArray buttons = doc["buttons"].as<JsonArray>();
-          for (JsonObject btn : buttons) {
-            ButtonConfig button;
-            button.name = btn["name"].as<String>();
-            button.pin = btn["pin"].as<int>();
-            button.duration = btn["duration"].as<unsigned long>();
-            button.topic = btn["topic"].as<String>();
-            button.mode = btn["mode"].as<int>();
-            config.buttons.push_back(button);
-            pinMode(button.pin, button.mode);
-          }
-          Serial.println("Config loaded successfully.");
-        } else {
-          Serial.println("Failed to deserialize config file.");
-        }
-        file.close();
-      } else {
-        Serial.println("Failed to open config file.");
-      }
-    } else {
-      Serial.println("Config file not found.");
+// Состояния входов для SSE и телеметрии после перенастройки кнопок
+void seedInputs() {
+  live.reset(config.buttons.size());
+  telemetry.reset(config.buttons.size());
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    if (config.buttons[i].mode != OUTPUT) {
+      live.setInput(i, inputs.state(i));
+      telemetry.setInput(i, inputs.state(i));
     }
-    LittleFS.end();
-  } else {
-    Serial.println("Failed to mount file system.");
   }
 }
 
-// Функция сохранения конфигурации
-void saveConfig() {
-  if (LittleFS.begin()) {
-    File file = LittleFS.open(configFile, "w");
-    if (file) {
-      JsonDocument doc;
-      doc["ssid"] = config.ssid;
-      doc["password"] = config.password;
-      doc["mqtt_server"] = config.mqtt_server;
-      doc["mqtt_user"] = config.mqtt_user;
-      doc["mqtt_password"] = config.mqtt_password;
-      doc["sensor1_name"] = config.sensor1_name;
-      doc["sensor2_name"] = config.sensor2_name;
-      doc["oneWireBus_pin"] = config.oneWireBus_pin;
-      
-      JsonArray buttons = doc["buttons"].to<JsonArray>();
-      for (ButtonConfig button : config.buttons) {
-        JsonObject btn = buttons.add<JsonObject>();
-        btn["name"] = button.name;
-        btn["pin"] = button.pin;
-        btn["duration"] = button.duration;
-        btn["topic"] = button.topic;
-        btn["mode"] = button.mode;
+// Настройка пинов кнопок; выходы передаются планировщику импульсов,
+// их топики попадают в индекс MQTT
+void applyButtons() {
+  pulses.clear();
+  inputs.clear();
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    hal::gpioMode(button.pin, button.mode);
+    if (button.mode == OUTPUT) {
+      if (!pulses.addPin(button.pin)) {
+        Serial.printf("Too many output pins, pin %d is not scheduled\n", button.pin);
       }
-      
-      if (serializeJson(doc, file) == 0) {
-        Serial.println("Failed to write to config file.");
-      } else {
-        Serial.println("Config saved successfully.");
+    } else if (!inputs.addPin(i, button.pin, button.debounce)) {
+      Serial.printf("Too many input pins, pin %d is not monitored\n", button.pin);
+    }
+  }
+  topicIndex.build(config.buttons);
+  // Макросы ссылаются на кнопки по имени, поэтому компилируются заново
+  macroEngine.load(config);
+  seedInputs();
+}
+
+// Непривязанные записи (имена из старых версий) получают адреса
+// датчиков без настроек в порядке их обнаружения
+bool bindSensors() {
+  bool bound = false;
+  TempSensor sensor;
+  for (size_t i = 0; tempSampler.sensor(i, sensor); i++) {
+    if (!sensor.present || findSensorConfig(config, sensor.address)) continue;
+    for (SensorConfig &entry : config.sensors) {
+      if (!sensorAddressIsZero(entry.address)) continue;
+      {
+        ConfigLock lock;
+        memcpy(entry.address, sensor.address, sizeof(entry.address));
       }
-      file.close();
-    } else {
-      Serial.println("Failed to open config file for writing.");
+      tempSampler.setResolution(entry.address, entry.resolution);
+      char address[SENSOR_ADDRESS_TEXT];
+      formatSensorAddress(entry.address, address);
+      Serial.printf("Sensor %s bound to %s\n", entry.name.c_str(), address);
+      bound = true;
+      break;
     }
-    LittleFS.end();
-  } else {
-    Serial.println("Failed to mount file system.");
   }
+  return bound;
+}
+
+// Пины шин 1-Wire для задачи опроса. Шины пересоздаёт она сама, чтобы
+// объекты не освобождались посреди обмена по шине
+portMUX_TYPE busMux = portMUX_INITIALIZER_UNLOCKED;
+FixedList<uint8_t, CONFIG_MAX_BUSES> busPins;
+volatile bool busesChanged = false;
+TempBus *dallasBuses[TEMP_MAX_BUSES];
+size_t dallasBusCount = 0;
+
+void requestBuses(const FixedList<uint8_t, CONFIG_MAX_BUSES> &pins) {
+  portENTER_CRITICAL(&busMux);
+  busPins = pins;
+  busesChanged = true;
+  portEXIT_CRITICAL(&busMux);
+}
+
+// Шины 1-Wire из запрошенных пинов; датчики на них находит задача опроса,
+// из которой и вызывается
+void setupSensors() {
+  FixedList<uint8_t, CONFIG_MAX_BUSES> pins;
+  portENTER_CRITICAL(&busMux);
+  pins = busPins;
+  busesChanged = false;
+  portEXIT_CRITICAL(&busMux);
+  tempSampler.clear();
+  for (size_t i = 0; i < dallasBusCount; i++) delete dallasBuses[i];
+  dallasBusCount = 0;
+  for (size_t i = 0; i < pins.size(); i++) {
+    uint8_t pin = pins[i];
+    if (i >= TEMP_MAX_BUSES) {
+      Serial.printf("Too many OneWire buses, pin %d is not used\n", pin);
+      continue;
+    }
+    OneWire *wire = new OneWire(pin);
+    dallasBuses[dallasBusCount] = new DallasBus(wire, new DallasTemperature(wire));
+    tempSampler.addBus(dallasBuses[dallasBusCount++]);
+  }
+}
+
+// Функция загрузки конфигурации
+void loadConfig() {
+  unsigned long started = micros();
+  if (configStore.load(config)) {
+    Serial.printf("Config loaded successfully in %lu us (slot %d, seq %u).\n",
+                  micros() - started, configStore.slot(), configStore.sequence());
+  }
+  applyButtons();
+  applySensors(config);
+  wifiScanner.setTtl(config.scan_ttl);
+  fleetRollout.setGroup(config.ota_group.c_str());
+}
+
+// Сохранение выполняет задача persist со снимком текущей конфигурации
+void saveConfig() {
+  Config *snapshot = new Config(config);
+  if (!enqueuePersist(PersistRequest{snapshot})) {
+    delete snapshot;
+    Serial.println("Persist queue full, config not saved.");
+  }
+}
+
+// Передача новой конфигурации сетевой задаче; true, если принята
+bool submitConfig(Config *updated) {
+  if (enqueueNetwork(NetworkEvent{NetworkEvent::APPLY_CONFIG, false, 0, 0, updated})) return true;
+  delete updated;
+  return false;
+}
+
+// Адрес из поля формы; false, если поле есть, но адрес неверный
+bool ipParam(AsyncWebServerRequest *request, const char *name, uint32_t &ip) {
+  return !request->hasParam(name, true) || parseIpAddress(request->getParam(name, true)->value().c_str(), ip);
+}
+
+// Строка из поля формы; false, если поле есть, но не помещается в s
+template <size_t N>
+bool stringParam(AsyncWebServerRequest *request, const String &name, FixedString<N> &s) {
+  if (!request->hasParam(name, true)) return true;
+  const String &value = request->getParam(name, true)->value();
+  return s.assign(value.c_str(), value.length());
 }
 
 void handleSaveConfig(AsyncWebServerRequest *request) {
-  if (request->hasParam("ssid", true)) config.ssid = request->getParam("ssid", true)->value();
-  if (request->hasParam("password", true)) config.password = request->getParam("password", true)->value();
-  if (request->hasParam("mqtt_server", true)) config.mqtt_server = request->getParam("mqtt_server", true)->value();
-  if (request->hasParam("mqtt_user", true)) config.mqtt_user = request->getParam("mqtt_user", true)->value();
-  if (request->hasParam("mqtt_password", true)) config.mqtt_password = request->getParam("mqtt_password", true)->value();
-  if (request->hasParam("sensor1_name", true)) config.sensor1_name = request->getParam("sensor1_name", true)->value();
-  if (request->hasParam("sensor2_name", true)) config.sensor2_name = request->getParam("sensor2_name", true)->value();
-  if (request->hasParam("oneWireBus_pin", true)) {
-    config.oneWireBus_pin = request->getParam("oneWireBus_pin", true)->value().toInt();
+  Config *updated = new Config(config);
+  // Списки и строки ограничены ёмкостью конфигурации: лишние строки формы
+  // и слишком длинные значения не принимаются, а не обрезаются
+  bool overflow = !stringParam(request, "ssid", updated->ssid) || !stringParam(request, "password", updated->password) ||
+                  !stringParam(request, "mqtt_server", updated->mqtt_server) ||
+                  !stringParam(request, "mqtt_user", updated->mqtt_user) ||
+                  !stringParam(request, "mqtt_password", updated->mqtt_password);
+  if (!ipParam(request, "static_ip", updated->static_ip) || !ipParam(request, "static_gateway", updated->static_gateway) ||
+      !ipParam(request, "static_subnet", updated->static_subnet) || !ipParam(request, "static_dns", updated->static_dns)) {
+    delete updated;
+    request->send(400, "text/plain", "Invalid static IP settings");
+    return;
   }
+  // Шины через запятую; список датчиков приходит вместе с ними
+  if (request->hasParam("oneWireBus_pins", true)) {
+    String pins = request->getParam("oneWireBus_pins", true)->value();
+    updated->oneWireBus_pins.clear();
+    for (int start = 0; start <= (int)pins.length();) {
+      int comma = pins.indexOf(',', start);
+      if (comma < 0) comma = pins.length();
+      String pin = pins.substring(start, comma);
+      pin.trim();
+      if (pin.length() && !updated->oneWireBus_pins.push_back(pin.toInt())) overflow = true;
+      start = comma + 1;
+    }
+    if (updated->oneWireBus_pins.empty()) updated->oneWireBus_pins.push_back(DEFAULT_ONE_WIRE_BUS);
+
+    updated->sensors.clear();
+    for (int n = 0; request->hasParam("sensor_name" + String(n), true); n++) {
+      String suffix = String(n);
+      SensorConfig sensor;
+      if (!stringParam(request, "sensor_name" + suffix, sensor.name)) overflow = true;
+      String address = request->hasParam("sensor_address" + suffix, true)
+        ? request->getParam("sensor_address" + suffix, true)->value() : String();
+      if (!sensorAddressFromString(address.c_str(), sensor.address)) {
+        memset(sensor.address, 0, sizeof(sensor.address));
+      }
+      int bits = request->hasParam("sensor_resolution" + suffix, true)
+        ? request->getParam("sensor_resolution" + suffix, true)->value().toInt() : DEFAULT_SENSOR_RESOLUTION;
+      sensor.resolution = constrain(bits, 9, 12);
+      if (!updated->sensors.push_back(sensor)) overflow = true;
+    }
+  }
+  if (!stringParam(request, "update_url", updated->update_url)) overflow = true;
+  if (request->hasParam("update_interval", true)) updated->update_interval = request->getParam("update_interval", true)->value().toInt();
+  if (request->hasParam("update_jitter", true)) updated->update_jitter = request->getParam("update_jitter", true)->value().toInt();
+  if (request->hasParam("update_window_start", true)) updated->update_window_start = request->getParam("update_window_start", true)->value().toInt() % 24;
+  if (request->hasParam("update_window_end", true)) updated->update_window_end = request->getParam("update_window_end", true)->value().toInt() % 24;
+  if (request->hasParam("ota_group", true)) {
+    String group = request->getParam("ota_group", true)->value();
+    // Группа - один уровень топика, без подстановочных знаков
+    if (group.indexOf('/') >= 0 || group.indexOf('+') >= 0 || group.indexOf('#') >= 0 ||
+        !updated->ota_group.assign(group.c_str(), group.length())) {
+      delete updated;
+      request->send(400, "text/plain", "Invalid update group");
+      return;
+    }
+  }
+  if (request->hasParam("metrics_interval", true)) updated->metrics_interval = request->getParam("metrics_interval", true)->value().toInt();
+  if (request->hasParam("telemetry_interval", true)) updated->telemetry_interval = request->getParam("telemetry_interval", true)->value().toInt();
+  if (request->hasParam("telemetry_deadband", true)) updated->telemetry_deadband = request->getParam("telemetry_deadband", true)->value().toFloat();
+  if (request->hasParam("heartbeat_interval", true)) updated->heartbeat_interval = request->getParam("heartbeat_interval", true)->value().toInt();
+  if (request->hasParam("scan_ttl", true)) updated->scan_ttl = request->getParam("scan_ttl", true)->value().toInt();
   
-  config.buttons.clear();
+  updated->buttons.clear();
   int i = 0;
   while (true) {
     String btnName = "button_name" + String(i);
@@ -174,24 +277,56 @@ void handleSaveConfig(AsyncWebServerRequest *request) {
     String btnDuration = "button_duration" + String(i);
     String btnTopic = "button_topic" + String(i);
     String btnMode = "button_mode" + String(i);
+    String btnDebounce = "button_debounce" + String(i);
 
     if (request->hasParam(btnName, true) && request->hasParam(btnPin, true) &&
         request->hasParam(btnDuration, true) && request->hasParam(btnTopic, true) && request->hasParam(btnMode, true)) {
       ButtonConfig button;
-      button.name = request->getParam(btnName, true)->value();
+      if (!stringParam(request, btnName, button.name)) overflow = true;
       button.pin = request->getParam(btnPin, true)->value().toInt();
       button.duration = request->getParam(btnDuration, true)->value().toInt();
-      button.topic = request->getParam(btnTopic, true)->value();
+      if (!stringParam(request, btnTopic, button.topic)) overflow = true;
       button.mode = request->getParam(btnMode, true)->value().toInt();
-      config.buttons.push_back(button);
-      pinMode(button.pin, button.mode);
+      button.debounce = request->hasParam(btnDebounce, true)
+        ? request->getParam(btnDebounce, true)->value().toInt() : DEFAULT_INPUT_DEBOUNCE;
+      if (!updated->buttons.push_back(button)) overflow = true;
       i++;
     } else {
       break;
     }
   }
 
-  saveConfig();
+  updated->macros.clear();
+  for (int n = 0; request->hasParam("macro_name" + String(n), true); n++) {
+    String suffix = String(n);
+    MacroConfig macro;
+    if (!stringParam(request, "macro_name" + suffix, macro.name) ||
+        !stringParam(request, "macro_topic" + suffix, macro.topic) ||
+        !stringParam(request, "macro_script" + suffix, macro.script)) {
+      overflow = true;
+    }
+    if (!updated->macros.push_back(macro)) overflow = true;
+  }
+
+  if (overflow) {
+    delete updated;
+    request->send(400, "text/plain", "Too many buttons, sensors, buses or macros, or a value too long");
+    return;
+  }
+  // Макрос с ошибкой не сохраняется, текст ошибки уходит в ответ
+  MacroProgram program;
+  for (const MacroConfig &macro : updated->macros) {
+    if (!compileMacro(*updated, macro, program)) {
+      String message = "Macro " + String(macro.name.c_str()) + ": " + program.error;
+      delete updated;
+      request->send(400, "text/plain", message);
+      return;
+    }
+  }
+  if (!submitConfig(updated)) {
+    request->send(503, "text/plain", "Busy, try again");
+    return;
+  }
   request->send(200, "text/plain", "Config saved");
   // request->redirect("/");
 }
@@ -202,9 +337,13 @@ void handleDeleteButton(AsyncWebServerRequest *request) {
   if (request->hasParam("index", true)) {
     int index = request->getParam("index", true)->value().toInt();
     if (index >= 0 && index < config.buttons.size()) {
-      config.buttons.erase(config.buttons.begin() + index);
-      saveConfig();
-      request->send(200, "text/plain", "Button deleted");
+      Config *updated = new Config(config);
+      updated->buttons.erase(updated->buttons.begin() + index);
+      if (submitConfig(updated)) {
+        request->send(200, "text/plain", "Button deleted");
+      } else {
+        request->send(503, "text/plain", "Busy, try again");
+      }
     } else {
       request->send(400, "text/plain", "Invalid index");
     }
@@ -214,125 +353,329 @@ void handleDeleteButton(AsyncWebServerRequest *request) {
 }
 
 void handleRestart(AsyncWebServerRequest *request) {
+  eventLog.add(EVENT_RESTART);
+  eventLog.flush(millis(), true);
   request->send(200, "text/plain", "Restarting...");
   delay(1000);
   ESP.restart();
 }
 
 void callback(char* topic, byte* payload, unsigned int length) {
-  String message;
-  for (unsigned int i = 0; i < length; i++) {
-    message += (char)payload[i];
-  }
-  Serial.print("Message arrived [");
-  Serial.print(topic);
-  Serial.print("] ");
-  Serial.println(message);
-
-  for (ButtonConfig button : config.buttons) {
-    if (String(topic) == button.topic) {
-      digitalWrite(button.pin, HIGH);
-      delay(button.duration);
-      digitalWrite(button.pin, LOW);
-      Serial.print("Button ");
-      Serial.print(button.name);
-      Serial.print(" triggered for ");
-      Serial.print(button.duration);
-      Serial.println(" ms");
-    }
-  }
+  handleMqttMessage(topic, payload, length);
 }
 
 void handleButtonState(AsyncWebServerRequest *request) {
-  int j = 0;
-  String json = "[";
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  renderButtonState(*response, millis());
+  request->send(response);
+}
+
+void handleTemperature(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  renderTemperature(*response, millis());
+  request->send(response);
+}
+
+void handlePulses(AsyncWebServerRequest *request) {
+  PulseStats s = pulses.stats();
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject()
+    .field("queued", s.queued)
+    .field("active", s.active)
+    .field("completed", s.completed)
+    .field("dropped", s.dropped)
+    .endObject();
+  request->send(response);
+}
+
+// Вызывается задачей actuation; обработка передаётся сетевой задаче
+void onInputChange(size_t index, bool state, unsigned long timestamp) {
+  if (!enqueueNetwork(NetworkEvent{NetworkEvent::INPUT_CHANGED, state, (uint8_t)index, (uint32_t)timestamp, nullptr})) {
+    Serial.println("Network queue full, input change dropped");
+  }
+}
+
+void handleInputChange(size_t index, bool state, unsigned long timestamp) {
+  if (index >= config.buttons.size()) return;
+  Serial.printf("Input %s changed to %s at %lu ms\n", config.buttons[index].name.c_str(), state ? "ON" : "OFF", timestamp);
+  eventLog.add(EVENT_INPUT, index, state);
+  live.setInput(index, state);
+  telemetry.setInput(index, state);
+  publishInputState(index, state);
+}
+
+// Одна попытка подключения к брокеру с подпиской на топики кнопок
+bool mqttConnect() {
+  if (config.mqtt_server.isEmpty() || WiFi.status() != WL_CONNECTED) {
+    return false;
+  }
+  bootProfile.mark(BOOT_WIFI, millis());
+  if (!transport.connect(deviceID.c_str(), config.mqtt_user.c_str(), config.mqtt_password.c_str())) {
+    return false;
+  }
+  // Время до первого подключения к брокеру - в retained pcc/<deviceID>/boot
+  if (!bootProfile.reached(BOOT_MQTT)) {
+    bootProfile.mark(BOOT_MQTT, millis());
+    char topic[64];
+    snprintf(topic, sizeof(topic), "pcc/%s/boot", deviceID.c_str());
+    char payload[256];
+    bootProfile.toJson(payload, sizeof(payload));
+    mqttPublish(topic, payload, true);
+  }
+  Serial.println(WiFi.localIP());
+  TopicList topics;
+  commandTopics(config, topics);
+  for (const char *topic : topics) transport.subscribe(topic);
   for (size_t i = 0; i < config.buttons.size(); i++) {
-    ButtonConfig button = config.buttons[i];
-    if (button.mode == INPUT || button.mode == INPUT_PULLUP || button.mode == INPUT_PULLDOWN) {
-      if (j > 0) json += ",";
-      json += "{\"pin\":" + String(button.pin) + ",\"state\":" + String(!digitalRead(button.pin)) + ",\"id\":" + String(i) + "}";
-      j++;
+    if (config.buttons[i].mode != OUTPUT) publishInputState(i, inputs.state(i));
+  }
+  transport.subscribe(fleetRollout.deviceTopic());
+  if (*fleetRollout.groupTopic()) transport.subscribe(fleetRollout.groupTopic());
+  fleetRollout.republish();
+  telemetry.publishState(millis());
+  return true;
+}
+
+// Сети из кэша сканирования. Устаревший кэш отдаётся как есть, а
+// сетевая задача обновляет его; запросы во время сканирования его не
+// перезапускают.
+void handleScan(AsyncWebServerRequest *request) {
+  unsigned long now = millis();
+  if (!wifiScanner.request(now)) wakeTask(TASK_NETWORK);
+  ScanNetwork networks[SCAN_MAX_NETWORKS];
+  size_t count = wifiScanner.snapshot(networks, SCAN_MAX_NETWORKS);
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject().field("scanning", wifiScanner.scanning()).field("age", wifiScanner.age(now) / 1000).beginArray("networks");
+  for (size_t i = 0; i < count; i++) {
+    json.beginObject()
+      .field("ssid", networks[i].ssid.c_str())
+      .field("rssi", networks[i].rssi)
+      .field("channel", networks[i].channel)
+      .field("auth", WifiScanner::authName(networks[i].auth))
+      .endObject();
+  }
+  json.endArray().endObject();
+  request->send(response);
+}
+
+// Журнал событий: ?after=<seq>&limit=<n>. Без after отдаются последние
+// limit записей; next в ответе - курсор для следующей страницы.
+// Записи читаются по нескольку прямо в буфер чанка.
+#define EVENTS_PAGE_DEFAULT 100
+#define EVENTS_PAGE_MAX 1000
+// Наибольшая длина одной записи в JSON
+#define EVENT_JSON_MAX 128
+
+struct EventsCursor {
+  uint32_t next;
+  uint32_t remaining;
+  uint8_t stage;      // 0 - заголовок, 1 - записи, 2 - хвост, 3 - конец
+  bool first;
+  char line[512];     // записи, ещё не отданные в чанк
+  size_t lineLen;
+  size_t lineSent;
+};
+
+static size_t formatEvent(const EventRecord &e, bool first, char *out, size_t size) {
+  return snprintf(out, size, "%s{\"seq\":%u,\"boot\":%u,\"time\":%u,\"uptime\":%u,\"type\":\"%s\",\"arg\":%u,\"value\":%u}",
+                  first ? "" : ",", e.seq, e.boot, e.time, e.uptime, EventLog::typeName(e.type), e.arg, e.value);
+}
+
+static size_t fillEvents(EventsCursor &c, uint8_t *buffer, size_t maxLen) {
+  size_t written = 0;
+  while (written < maxLen) {
+    if (c.lineSent < c.lineLen) {
+      size_t n = c.lineLen - c.lineSent;
+      if (n > maxLen - written) n = maxLen - written;
+      memcpy(buffer + written, c.line + c.lineSent, n);
+      c.lineSent += n;
+      written += n;
+      continue;
     }
+    if (c.stage == 0) {
+      c.lineLen = snprintf(c.line, sizeof(c.line), "{\"first\":%u,\"last\":%u,\"dropped\":%u,\"events\":[",
+                           eventLog.first(), eventLog.next() - 1, eventLog.dropped());
+      c.stage = 1;
+    } else if (c.stage == 1) {
+      EventRecord records[4];
+      size_t n = c.remaining ? eventLog.read(c.next, records, c.remaining < 4 ? c.remaining : 4) : 0;
+      if (!n) {
+        c.stage = 2;
+        continue;
+      }
+      // Страница формируется по несколько записей и в памяти целиком не бывает
+      c.lineLen = 0;
+      for (size_t i = 0; i < n && c.lineLen + EVENT_JSON_MAX <= sizeof(c.line); i++) {
+        c.lineLen += formatEvent(records[i], c.first, c.line + c.lineLen, sizeof(c.line) - c.lineLen);
+        c.first = false;
+        c.next = records[i].seq + 1;
+        c.remaining--;
+      }
+    } else if (c.stage == 2) {
+      c.lineLen = snprintf(c.line, sizeof(c.line), "],\"next\":%u}", c.next);
+      c.stage = 3;
+    } else {
+      break;
+    }
+    c.lineSent = 0;
   }
-  json += "]";
-  request->send(200, "application/json", json);
+  return written;
 }
 
-void handleTemperature(AsyncWebServerRequest *request) {
-  sensors->requestTemperatures();
-  float temp1 = sensors->getTempCByIndex(0);
-  float temp2 = sensors->getTempCByIndex(1);
-  String json = "{\"temp1\":" + String(temp1) + ",\"temp2\":" + String(temp2) + "}";
-  request->send(200, "application/json", json);
+void handleEvents(AsyncWebServerRequest *request) {
+  std::shared_ptr<EventsCursor> cursor = std::make_shared<EventsCursor>();
+  uint32_t limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : EVENTS_PAGE_DEFAULT;
+  cursor->remaining = constrain(limit, 1, EVENTS_PAGE_MAX);
+  if (request->hasParam("after")) {
+    cursor->next = strtoul(request->getParam("after")->value().c_str(), nullptr, 10) + 1;
+  } else {
+    uint32_t first = eventLog.first();
+    uint32_t next = eventLog.next();
+    cursor->next = next - first > cursor->remaining ? next - cursor->remaining : first;
+  }
+  cursor->stage = 0;
+  cursor->first = true;
+  cursor->lineLen = cursor->lineSent = 0;
+  AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+    [cursor](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return fillEvents(*cursor, buffer, maxLen);
+    });
+  request->send(response);
 }
 
+void handleMqttStatus(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject()
+    .field("state", mqtt.stateName())
+    .field("rc", transport.state())
+    .field("attempts", mqtt.attempts())
+    .field("failures", mqtt.failures())
+    .field("connects", mqtt.connects())
+    .field("disconnects", mqtt.disconnects())
+    .field("retry_in", mqtt.retryIn(millis()))
+    .endObject();
+  request->send(response);
+}
+
+// Метрики в формате Prometheus
+void handleMetrics(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+  renderMetrics(*response);
+  request->send(response);
+}
+
+// Периодическая публикация сводки метрик в pcc/<deviceID>/metrics
+unsigned long metricsPublishedAt = 0;
+
+void publishMetrics(unsigned long now) {
+  if (!config.metrics_interval || !transport.connected()) return;
+  if (now - metricsPublishedAt < config.metrics_interval * 1000UL) return;
+  metricsPublishedAt = now;
+  char topic[64];
+  snprintf(topic, sizeof(topic), "pcc/%s/metrics", deviceID.c_str());
+  // Для длительных прогонов: задержка команд и дрейф кучи по одной ленте
+  DurationHistogram latency = pulses.latency();
+  PulseStats p = pulses.stats();
+  char payload[384];
+  snprintf(payload, sizeof(payload),
+           "{\"uptime\":%lu,\"heap\":%u,\"heap_min\":%u,\"heap_block\":%u,\"heap_allocs\":%u,\"loop_max_us\":%u,"
+           "\"mqtt_rx\":%u,\"mqtt_tx\":%u,\"mqtt_errors\":%u,\"reconnects\":%u,"
+           "\"commands\":%u,\"latency_p50_us\":%u,\"latency_p99_us\":%u,\"latency_max_us\":%u,\"dropped\":%u}",
+           now / 1000, ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), heapAllocatedBlocks(),
+           metrics.loopMaxUs(), metrics.mqttReceived, metrics.mqttPublished, metrics.mqttPublishErrors, mqtt.connects(),
+           latency.count(), latency.quantileUs(0.5f), latency.quantileUs(0.99f), latency.maxUs(),
+           p.dropped + p.replaced + actuationQueue.dropped());
+  mqttPublish(topic, payload, false);
+}
+
+// Завершение загрузки через /update: тело уже записано handleUpdateUpload
 void handleUpdate(AsyncWebServerRequest *request) {
-  AsyncWebServerResponse *response = request->beginResponse(200, "text/plain", (Update.hasError()) ? "Update Failed" : "Update Success");
+  // Пока идёт загрузка по URL, загрузка из браузера отбрасывается
+  if (otaJob.busy()) {
+    request->send(409, "text/plain", "Update already in progress");
+    return;
+  }
+  bool failed = Update.hasError();
+  eventLog.add(failed ? EVENT_OTA_FAILED : EVENT_OTA_DONE);
+  eventLog.flush(millis(), true);
+  AsyncWebServerResponse *response = request->beginResponse(failed ? 500 : 200, "text/plain", failed ? "Update Failed" : "Update Success");
   response->addHeader("Connection", "close");
   request->send(response);
+  if (failed) return;
   delay(1000);
   ESP.restart();
 }
 
+// Загрузка прошивки из браузера; образ может быть сжат gzip
+GzipStream uploadGzip;
+bool uploadCompressed = false;
+
 void handleUpdateUpload(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final) {
+  if (otaJob.busy()) return;
   if (!index) {
     Serial.printf("Update: %s\n", filename.c_str());
+    uploadCompressed = GzipStream::isGzip(data, len);
     if (!Update.begin(UPDATE_SIZE_UNKNOWN)) { // start with max available size
       Update.printError(Serial);
     }
+    if (uploadCompressed) {
+      uploadGzip.begin([](uint8_t *out, size_t outLen) { return Update.write(out, outLen) == outLen; });
+    }
   }
-  if (Update.write(data, len) != len) {
+  if (uploadCompressed) {
+    if (!uploadGzip.write(data, len)) {
+      Serial.printf("Update: %s\n", uploadGzip.error() ? uploadGzip.error() : "write failed");
+      Update.abort();
+    }
+  } else if (Update.write(data, len) != len) {
     Update.printError(Serial);
   }
   if (final) {
-    if (Update.end(true)) { // true to set the size to the current progress
+    if (uploadCompressed && !uploadGzip.finished()) {
+      Serial.println("Update: truncated gzip image");
+      Update.abort();
+    } else if (Update.end(true)) { // true to set the size to the current progress
       Serial.printf("Update Success: %u\nRebooting...\n", index + len);
     } else {
       Update.printError(Serial);
     }
+    uploadGzip.end();
   }
 }
 
 void handleUpdateUrl(AsyncWebServerRequest *request) {
   if (request->hasParam("url", true)) {
     String url = request->getParam("url", true)->value();
-    WiFiClient client;
 
 #ifdef ESP32
-    HTTPClient http;
-    http.begin(client, url);  // Use WiFiClientSecure for HTTPS
-    int httpCode = http.GET();
-    if (httpCode == HTTP_CODE_OK) {
-      WiFiClient * stream = http.getStreamPtr();
-      size_t total = http.getSize();
-      size_t written = 0;
-      if (Update.begin(total)) {
-        written = Update.writeStream(*stream);
-        if (written == total) {
-          if (Update.end(true)) {
-            Serial.println("Update Success: Rebooting...");
-            request->send(200, "text/plain", "Update Success: Rebooting...");
-            delay(1000);
-            ESP.restart();
-          } else {
-            Serial.printf("Update failed. Error #: %u\n", Update.getError());
-            request->send(500, "text/plain", "Update failed");
-          }
-        } else {
-          Serial.printf("Written only : %u/%u bytes\n", written, total);
-          request->send(500, "text/plain", "Update failed");
-        }
-      } else {
-        Serial.printf("Not enough space to begin OTA\n");
-        request->send(500, "text/plain", "Not enough space");
-      }
-    } else {
-      Serial.printf("HTTP GET failed. Error #: %d\n", httpCode);
-      request->send(500, "text/plain", "HTTP GET failed");
+    String sha256 = request->hasParam("sha256", true) ? request->getParam("sha256", true)->value() : String();
+    if (!OtaJob::validDigest(sha256)) {
+      request->send(400, "text/plain", "Invalid SHA-256 digest");
+      return;
+    }
+    switch (otaJob.start(url, sha256)) {
+      case OtaJob::STARTED:
+        request->send(202, "text/plain", "Update started, see /update_status");
+        break;
+      case OtaJob::BUSY:
+        request->send(409, "text/plain", "Update already in progress");
+        break;
+      case OtaJob::UPLOAD_RUNNING:
+        request->send(409, "text/plain", "Browser upload in progress");
+        break;
+      case OtaJob::BAD_DIGEST:
+        request->send(400, "text/plain", "Invalid SHA-256 digest");
+        break;
+      case OtaJob::NO_TASK:
+        request->send(500, "text/plain", "Failed to start OTA task");
+        break;
     }
-    http.end();
 
 #else
+    WiFiClient client;
     HTTPUpdateResult ret = ESPhttpUpdate.update(client, url);
     switch (ret) {
       case HTTP_UPDATE_FAILED:
@@ -356,20 +699,419 @@ void handleUpdateUrl(AsyncWebServerRequest *request) {
   }
 }
 
-void handleOTA(AsyncWebServerRequest *request) {
-  String html = "<html><body>";
-  html += "<h1>OTA Update</h1>";
-  html += "<form method='POST' action='/update' enctype='multipart/form-data'>";
-  html += "<input type='file' name='update'>";
-  html += "<input type='submit' value='Upload'>";
-  html += "</form>";
-  html += "<form method='POST' action='/update_url'>";
-  html += "<input type='text' name='url' placeholder='Firmware URL'>";
-  html += "<input type='submit' value='Update'>";
-  html += "</form>";
-  html += "<button onclick=\"location.href='/'\">BACK</button><br>";
-  html += "</body></html>";
-  request->send(200, "text/html", html);
+void handleUpdateStatus(AsyncWebServerRequest *request) {
+  OtaJob::Status s = otaJob.status();
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject()
+    .field("state", OtaJob::stateName(s.state))
+    .field("written", s.written)
+    .field("total", s.total)
+    .field("rate", s.rate)
+    .field("retries", s.retries)
+    .field("error", s.error)
+    .field("sha256", s.sha256)
+    .endObject();
+  request->send(response);
+}
+
+void handleUpdateCheck(AsyncWebServerRequest *request) {
+  if (request->method() == HTTP_POST) {
+    updateAgent.checkNow();
+  }
+  unsigned long now = millis();
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject()
+    .field("enabled", config.update_interval > 0 && !config.update_url.isEmpty())
+    .field("checking", updateAgent.checking())
+    .field("result", UpdateAgent::resultName(updateAgent.result()))
+    .field("current", FIRMWARE_VERSION)
+    .field("latest", updateAgent.latestVersion())
+    .field("last_check", updateAgent.lastCheckAt() ? (now - updateAgent.lastCheckAt()) / 1000 : 0UL)
+    .field("next_check", updateAgent.nextCheckIn(now) / 1000)
+    .endObject();
+  request->send(response);
+}
+
+// Состояние раскатки по MQTT, то же, что в pcc/<deviceID>/ota/status
+void handleRollout(AsyncWebServerRequest *request) {
+  char json[ROLLOUT_STATUS_TEXT];
+  fleetRollout.toJson(json, sizeof(json), millis());
+  request->send(200, "application/json", json);
+}
+
+int findMacro(const String &name) {
+  for (size_t i = 0; i < config.macros.size(); i++) {
+    if (name == config.macros[i].name.c_str()) return i;
+  }
+  return -1;
+}
+
+// Запуск и остановка макроса: name=<имя>[&action=stop]
+void handleMacro(AsyncWebServerRequest *request) {
+  if (!request->hasParam("name", true)) {
+    request->send(400, "text/plain", "Macro name not provided");
+    return;
+  }
+  const String &name = request->getParam("name", true)->value();
+  int index = findMacro(name);
+  if (index < 0) {
+    request->send(404, "text/plain", "Macro " + name + " not found");
+    return;
+  }
+  bool stop = request->hasParam("action", true) && request->getParam("action", true)->value() == "stop";
+  if (stop) {
+    if (macroEngine.stop(index)) {
+      eventLog.add(EVENT_MACRO, index, 0);
+      request->send(200, "text/plain", "Macro " + name + " stopped");
+    } else {
+      request->send(409, "text/plain", "Macro " + name + " is not running");
+    }
+  } else if (!macroEngine.valid(index)) {
+    request->send(409, "text/plain", "Macro " + name + ": " + macroEngine.error(index));
+  } else if (macroEngine.start(index, millis())) {
+    wakeTask(TASK_ACTUATION);
+    eventLog.add(EVENT_MACRO, index, 1);
+    request->send(200, "text/plain", "Macro " + name + " started");
+  } else {
+    request->send(409, "text/plain", "Macro " + name + " is already running");
+  }
+}
+
+void handleMacros(AsyncWebServerRequest *request) {
+  unsigned long now = millis();
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginArray();
+  for (size_t i = 0; i < config.macros.size(); i++) {
+    MacroEngine::Status s = macroEngine.status(i, now);
+    json.beginObject()
+      .field("id", i)
+      .field("name", config.macros[i].name.c_str())
+      .field("state", MacroEngine::resultName(s.result))
+      .field("step", s.step + 1)
+      .field("elapsed", s.elapsed)
+      .field("runs", s.runs);
+    if (!macroEngine.valid(i)) json.field("error", macroEngine.error(i));
+    json.endObject();
+  }
+  json.endArray();
+  request->send(response);
+}
+
+// ETag статических файлов совпадает с версией прошивки
+const char* assetETag = "\"" FIRMWARE_VERSION "\"";
+
+// Отдаёт файл интерфейса из LittleFS (сжатый .gz, если он есть) с поддержкой 304
+void sendAsset(AsyncWebServerRequest *request, const char *path, const char *contentType) {
+  if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == assetETag) {
+    request->send(304);
+    return;
+  }
+  AsyncWebServerResponse *response = request->beginResponse(LittleFS, path, contentType);
+  response->addHeader("ETag", assetETag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+const char* modeName(int mode) {
+  switch (mode) {
+    case OUTPUT: return "OUTPUT";
+    case INPUT: return "INPUT";
+    case INPUT_PULLUP: return "INPUT_PULLUP";
+    case INPUT_PULLDOWN: return "INPUT_PULLDOWN";
+  }
+  return "UNKNOWN";
+}
+
+// Данные для главной страницы
+void handleApiInfo(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject()
+    .field("device", deviceID.c_str())
+    .field("version", FIRMWARE_VERSION)
+    .field("topology", tempSampler.topology())
+    .beginArray("sensors");
+  TempSensor sensor;
+  for (size_t i = 0; tempSampler.sensor(i, sensor); i++) {
+    char address[SENSOR_ADDRESS_TEXT];
+    json.beginObject().field("id", i).field("name", sensorLabel(config, sensor.address, address)).endObject();
+  }
+  json.endArray().beginArray("buttons");
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    json.beginObject()
+      .field("id", i)
+      .field("name", button.name.c_str())
+      .field("pin", button.pin)
+      .field("duration", button.duration)
+      .field("output", button.mode == OUTPUT)
+      .endObject();
+  }
+  json.endArray().beginArray("macros");
+  for (size_t i = 0; i < config.macros.size(); i++) {
+    json.beginObject().field("id", i).field("name", config.macros[i].name.c_str()).endObject();
+  }
+  json.endArray().endObject();
+  request->send(response);
+}
+
+// Сводное состояние для панелей одним запросом, см. renderApiState()
+void handleApiState(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->addHeader("Cache-Control", "no-store");
+  renderApiState(*response, millis(), request->hasParam("since") ? request->getParam("since")->value().c_str() : nullptr);
+  request->send(response);
+}
+
+// Данные для страницы настроек
+void handleApiConfig(AsyncWebServerRequest *request) {
+  JsonDocument doc;
+  configToJson(config, doc);
+  JsonObject modes = doc["modes"].to<JsonObject>();
+  for (int mode : {OUTPUT, INPUT, INPUT_PULLUP, INPUT_PULLDOWN}) {
+    modes[modeName(mode)] = mode;
+  }
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+// Выгрузка конфигурации в JSON
+void handleConfigExport(AsyncWebServerRequest *request) {
+  JsonDocument doc;
+  configToJson(config, doc);
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->addHeader("Content-Disposition", "attachment; filename=config.json");
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+// Тело запроса импорта накапливается в _tempObject
+#define CONFIG_IMPORT_MAX 8192
+
+void handleConfigImportBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (total > CONFIG_IMPORT_MAX) return;
+  if (index == 0) {
+    request->_tempObject = malloc(total + 1);
+  }
+  char *buffer = static_cast<char *>(request->_tempObject);
+  if (!buffer) return;
+  memcpy(buffer + index, data, len);
+  buffer[index + len] = 0;
+}
+
+void handleConfigImport(AsyncWebServerRequest *request) {
+  const char *body = static_cast<const char *>(request->_tempObject);
+  if (!body) {
+    request->send(400, "text/plain", "Config body missing or too large");
+    return;
+  }
+  JsonDocument doc;
+  Config *imported = new Config();
+  if (deserializeJson(doc, body) || !configFromJson(doc, *imported)) {
+    delete imported;
+    request->send(400, "text/plain", "Invalid config JSON");
+    return;
+  }
+  if (!submitConfig(imported)) {
+    request->send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  request->send(200, "text/plain", "Config imported");
+}
+
+// Обёртка обработчика маршрута с учётом времени выполнения. Обработчики
+// работают в задаче AsyncTCP и читают config под ConfigLock; тем, кто
+// config не читает (перезагрузка, прошивка с паузой перед рестартом),
+// блокировка не нужна - иначе сетевая задача ждала бы её всю паузу.
+ArRequestHandlerFunction timed(const char *route, ArRequestHandlerFunction handler, bool readsConfig = true) {
+  RouteStats *stats = metrics.route(route);
+  return [stats, handler, readsConfig](AsyncWebServerRequest *request) {
+    unsigned long started = micros();
+    if (readsConfig) {
+      ConfigLock lock;
+      handler(request);
+    } else {
+      handler(request);
+    }
+    if (stats) metrics.recordRoute(stats, micros() - started);
+  };
+}
+
+// Новая конфигурация применяется по разнице с прежней (config_apply.h);
+// здесь остаётся то, что связано с SSE, шинами 1-Wire и PubSubClient
+void applyConfig(const Config &previous) {
+  unsigned long started = micros();
+  ConfigChanges changes = applyChanges(previous, config);
+  if (changes.inputs) seedInputs();
+  if (changes.buses) requestBuses(config.oneWireBus_pins);
+  if (changes.broker) client.setServer(config.mqtt_server.c_str(), 1883);
+  Serial.printf("Config applied in %lu us\n", micros() - started);
+  if (changes.wifi) Serial.println("Wi-Fi settings are applied after restart");
+}
+
+void handleNetworkEvent(NetworkEvent &event) {
+  switch (event.type) {
+    case NetworkEvent::INPUT_CHANGED:
+      handleInputChange(event.index, event.state, event.timestamp);
+      break;
+    case NetworkEvent::APPLY_CONFIG: {
+      // Прежняя конфигурация нужна для сравнения; копия в куче, а не
+      // на стеке задачи
+      Config *previous = new Config(config);
+      {
+        ConfigLock lock;
+        config = *event.config;
+      }
+      delete event.config;
+      applyConfig(*previous);
+      delete previous;
+      saveConfig();
+      eventLog.add(EVENT_CONFIG);
+      break;
+    }
+  }
+}
+
+// Сетевая задача: единственный писатель config после старта (под
+// ConfigLock), владелец MQTT-клиента, SSE и телеметрии
+void networkTask(void *) {
+  uint32_t sensorTopology = 0;
+  bool wifiUp = WiFi.status() == WL_CONNECTED;
+  bool mqttUp = false;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_TICK_MS));
+    unsigned long started = micros();
+    NetworkEvent event;
+    while (networkQueue.pop(event)) {
+      handleNetworkEvent(event);
+    }
+    if (tempSampler.topology() != sensorTopology) {
+      sensorTopology = tempSampler.topology();
+      Serial.printf("Temperature sensors changed, %u known\n", tempSampler.count());
+      if (bindSensors()) saveConfig();
+    }
+    unsigned long now = millis();
+    mqtt.loop(now);
+    // Смены состояния связи попадают в журнал событий
+    if ((WiFi.status() == WL_CONNECTED) != wifiUp) {
+      wifiUp = !wifiUp;
+      eventLog.add(wifiUp ? EVENT_WIFI_UP : EVENT_WIFI_DOWN);
+    }
+    if (transport.connected() != mqttUp) {
+      mqttUp = !mqttUp;
+      eventLog.add(mqttUp ? EVENT_MQTT_UP : EVENT_MQTT_DOWN, 0, mqtt.attempts());
+    }
+    live.loop(now);
+    updateAgent.loop(now);
+    fleetRollout.loop(now, transport.connected());
+    telemetry.loop(now, transport.connected());
+    wifiScanner.loop(now);
+    publishMetrics(now);
+    metrics.recordLoop(micros() - started);
+  }
+}
+
+// Импульсы на выходах и антидребезг входов
+void actuationTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ACTUATION_TICK_MS));
+    ActuationCommand command;
+    while (actuationQueue.pop(command)) {
+      if (command.action == ActuationCommand::CANCEL) {
+        pulses.cancel(command.pin);
+        eventLog.add(EVENT_RELEASE, command.pin);
+      } else {
+        pulses.request(command.pin, command.duration, command.received);
+        eventLog.add(EVENT_TRIGGER, command.pin, command.duration);
+      }
+    }
+    unsigned long now = millis();
+    inputs.loop(now);
+    macroEngine.loop(now);
+  }
+}
+
+void sensingTask(void *) {
+  for (;;) {
+    if (busesChanged) setupSensors();
+    tempSampler.loop(millis());
+    vTaskDelay(pdMS_TO_TICKS(SENSING_TICK_MS));
+  }
+}
+
+// Запись конфигурации и пакетов журнала событий
+void persistTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PERSIST_TICK_MS));
+    PersistRequest request;
+    while (persistQueue.pop(request)) {
+      if (configStore.save(*request.config)) {
+        Serial.println("Config saved successfully.");
+      }
+      delete request.config;
+    }
+    eventLog.flush(millis());
+  }
+}
+
+// Ожидание подключения к сохранённой точке доступа до полного сканирования, мс
+#define WIFI_FAST_CONNECT_TIMEOUT 5000
+
+IPAddress ipAddress(uint32_t ip) {
+  return IPAddress(ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, ip >> 24);
+}
+
+// Подключение к точке доступа без ожидания результата. С сохранённой
+// точкой доступа сканирование каналов пропускается, со статическим
+// адресом - DHCP. false, если сеть не настроена.
+bool startWifi() {
+  if (config.ssid.isEmpty()) return false;
+  // Учётные данные уже в конфигурации, запись в NVS при каждом старте не нужна
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  if (config.static_ip) {
+    IPAddress gateway = ipAddress(config.static_gateway);
+    WiFi.config(ipAddress(config.static_ip), gateway,
+                config.static_subnet ? ipAddress(config.static_subnet) : IPAddress(255, 255, 255, 0),
+                config.static_dns ? ipAddress(config.static_dns) : gateway);
+  }
+  WifiCache cache;
+  bootProfile.fastConnect = loadWifiCache(config.ssid.c_str(), cache);
+  if (bootProfile.fastConnect) {
+    WiFi.begin(config.ssid.c_str(), config.password.c_str(), cache.channel, cache.bssid);
+  } else {
+    WiFi.begin(config.ssid.c_str(), config.password.c_str());
+  }
+  bootProfile.mark(BOOT_WIFI_START, millis());
+  return true;
+}
+
+// Ожидание подключения. Если сохранённая точка доступа не ответила,
+// повтор с полным сканированием; после успеха точка запоминается.
+bool waitForWifi() {
+  if (bootProfile.fastConnect && WiFi.waitForConnectResult(WIFI_FAST_CONNECT_TIMEOUT) != WL_CONNECTED) {
+    Serial.println("Cached access point not reachable, scanning...");
+    bootProfile.fastFallback = true;
+    clearWifiCache();
+    WiFi.disconnect();
+    WiFi.begin(config.ssid.c_str(), config.password.c_str());
+  }
+  if (WiFi.waitForConnectResult() != WL_CONNECTED) return false;
+  WifiCache cache;
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  saveWifiCache(config.ssid.c_str(), cache);
+  return true;
+}
+
+void handleBoot(AsyncWebServerRequest *request) {
+  char json[256];
+  bootProfile.toJson(json, sizeof(json));
+  request->send(200, "application/json", json);
 }
 
 void setup() {
@@ -378,251 +1120,104 @@ void setup() {
     Serial.println("An error has occurred while mounting LittleFS");
     return;
   }
+  bootProfile.mark(BOOT_FS, millis());
+  eventLog.begin();
+  eventLog.add(EVENT_BOOT, 0, esp_reset_reason());
 
+  pulses.begin();
+  inputs.onChange(onInputChange);
   loadConfig();
+  bootProfile.mark(BOOT_CONFIG, millis());
 
-  oneWire = new OneWire(config.oneWireBus_pin);
-  sensors = new DallasTemperature(oneWire);
-  sensors->begin();
-  // Настройка WiFi
+  // Ассоциация с точкой доступа идёт в фоне, пока запускаются
+  // датчики и задачи, которым сеть не нужна
   Serial.println("Setting up WiFi...");
+  bool wifiStarted = startWifi();
+  requestBuses(config.oneWireBus_pins);
+  startTask(TASK_PERSIST, persistTask);
+  startTask(TASK_SENSING, sensingTask);
+  startTask(TASK_ACTUATION, actuationTask);
+  bootProfile.mark(BOOT_TASKS, millis());
+
   AsyncWiFiManager wifiManager(&server, &dns);
-  if (config.ssid.isEmpty()) {
+  if (!wifiStarted) {
     Serial.println("Starting WiFi AP for configuration...");
     wifiManager.autoConnect(deviceID.c_str());
+  } else if (!waitForWifi()) {
+    Serial.println("WiFi connection failed. Starting AP for configuration...");
+    wifiManager.autoConnect(deviceID.c_str());
   } else {
-    WiFi.begin(config.ssid.c_str(), config.password.c_str(), 4);
-    if (WiFi.waitForConnectResult() != WL_CONNECTED) {
-      Serial.println("WiFi connection failed. Starting AP for configuration...");
-      wifiManager.autoConnect(deviceID.c_str());
-    } else {
-      Serial.print("Connected to ");
-      Serial.println(config.ssid);
-      Serial.print("IP address: ");
-      Serial.println(WiFi.localIP());
-    }
+    Serial.printf("Connected to %s in %lu ms (%s)\n", config.ssid.c_str(), millis() - bootProfile.at(BOOT_WIFI_START),
+                  bootProfile.fastConnect && !bootProfile.fastFallback ? "cached AP" : "full scan");
+    Serial.print("IP address: ");
+    Serial.println(WiFi.localIP());
   }
+  if (WiFi.status() == WL_CONNECTED) bootProfile.mark(BOOT_WIFI, millis());
+
+  // Время нужно для окна автообновления
+  configTime(0, 0, "pool.ntp.org");
+  updateAgent.begin(millis());
 
   // Настройка MQTT
   Serial.println("Setting up MQTT...");
   client.setServer(config.mqtt_server.c_str(), 1883);
   client.setCallback(callback);
+  client.setBufferSize(1024);
+  telemetry.begin(deviceID.c_str(), mqttPublish);
+  fleetRollout.begin(deviceID.c_str(), mqttPublish);
+  mqtt.begin(mqttConnect);
 
   // Настройка веб-сервера
   Serial.println("Setting up web server...");
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    String html = "<html><head><link rel='icon' href='data:;base64,iVBORw0KGgo='></head><body>";
-    html += "<h1>Device Info</h1>";
-    html += "<p>Device ID: " + deviceID + "</p>";
-    html += "<p>Sensor 1 (" + config.sensor1_name + "): <span id=\"temp1\"></span> &deg;C</p>";
-    html += "<p>Sensor 2 (" + config.sensor2_name + "): <span id=\"temp2\"></span> &deg;C</p>";
-    for (size_t i = 0; i < config.buttons.size(); i++) {
-      ButtonConfig button = config.buttons[i];
-      if (button.mode == OUTPUT) {
-        html += "<button onclick=\"location.href='/trigger?pin=" + String(button.pin) + "&duration=" + String(button.duration) + "'\">" + button.name + "</button><br>";
-      } else {
-        html += "<p>" + button.name + ": <span id=\"button" + String(i) + "\">" + (!digitalRead(button.pin) ? "HIGH" : "LOW") + "</span></p><br>";
-      }
-    }
-    html += "<form action=\"/config\" method=\"GET\"><button type=\"submit\">Config</button></form>";
-    html += "<form action=\"/restart\" method=\"POST\"><button type=\"submit\">Restart ESP</button></form>";
-    html += "<script>";
-    html += "function updateButtonStates() {";
-    html += "fetch('/button_state').then(response => response.json()).then(data => {";
-    // html += "console.log(data);";
-    html += "data.forEach((button, index) => {";
-    html += "pin = `button${button.id}`;";
-    // html += "console.log(pin);";
-    html += "document.getElementById(pin).innerText = button.state ? 'HIGH' : 'LOW';";
-    // html += "document.getElementById(`button${index}`).innerText = button.state ? 'HIGH' : 'LOW';";
-    html += "});";
-    html += "});";
-    html += "}";
-    html += "function updateTemperatures() {";
-    html += "fetch('/temp').then(response => response.json()).then(data => {";
-    html += "document.getElementById('temp1').innerText = data.temp1;";
-    html += "document.getElementById('temp2').innerText = data.temp2;";
-    html += "});";
-    html += "}";
-    html += "setInterval(updateButtonStates, 1000);";
-    html += "setInterval(updateTemperatures, 1000);";
-    html += "</script>";
-    html += "</body></html>";
-    request->send(200, "text/html", html);
-  });
-
-  server.on("/config", HTTP_GET, [](AsyncWebServerRequest *request){
-    String html = "<html><head><link rel='icon' href='data:;base64,iVBORw0KGgo='></head><body>";
-    html += "<h1>Configuration</h1>";
-    // html += "<form action=\"/save\" method=\"POST\">";
-    html += "<form onsubmit='saveConfig(event)'>";
-    html += "<label for='ssid'>SSID:</label><input type='text' id='ssid' name='ssid' value='" + config.ssid + "' onfocus='scanWifi()'><br>";
-    html += "<label for=\"password\">Password:</label><input type=\"password\" id=\"password\" name=\"password\" value=\"" + config.password + "\"><br>";
-    html += "<label for=\"mqtt_server\">MQTT Server:</label><input type=\"text\" id=\"mqtt_server\" name=\"mqtt_server\" value=\"" + config.mqtt_server + "\"><br>";
-    html += "<label for=\"mqtt_user\">MQTT User:</label><input type=\"text\" id=\"mqtt_user\" name=\"mqtt_user\" value=\"" + config.mqtt_user + "\"><br>";
-    html += "<label for=\"mqtt_password\">MQTT Password:</label><input type=\"password\" id=\"mqtt_password\" name=\"mqtt_password\" value=\"" + config.mqtt_password + "\"><br>";
-    html += "<label for=\"sensor1_name\">Sensor 1 Name:</label><input type=\"text\" id=\"sensor1_name\" name=\"sensor1_name\" value=\"" + config.sensor1_name + "\"><br>";
-    html += "<label for=\"sensor2_name\">Sensor 2 Name:</label><input type=\"text\" id=\"sensor2_name\" name=\"sensor2_name\" value=\"" + config.sensor2_name + "\"><br>";
-    html += "<label for=\"oneWireBus_pin\">OneWire Bus Pin:</label><input type=\"text\" id=\"oneWireBus_pin\" name=\"oneWireBus_pin\" value=\"" + String(config.oneWireBus_pin) + "\"><br>";
-
-    for (int i = 0; i < config.buttons.size(); i++) {
-      ButtonConfig button = config.buttons[i];
-      html += "<h3>Button " + String(i+1) + "</h3>";
-      html += "<label for=\"button_name" + String(i) + "\">Name:</label><input type=\"text\" id=\"button_name" + String(i) + "\" name=\"button_name" + String(i) + "\" value=\"" + button.name + "\"><br>";
-      html += "<label for=\"button_pin" + String(i) + "\">Pin:</label><input type=\"text\" id=\"button_pin" + String(i) + "\" name=\"button_pin" + String(i) + "\" value=\"" + button.pin + "\"><br>";
-      html += "<label for=\"button_duration" + String(i) + "\">Duration (ms):</label><input type=\"text\" id=\"button_duration" + String(i) + "\" name=\"button_duration" + String(i) + "\" value=\"" + button.duration + "\"><br>";
-      html += "<label for=\"button_topic" + String(i) + "\">MQTT Topic:</label><input type=\"text\" id=\"button_topic" + String(i) + "\" name=\"button_topic" + String(i) + "\" value=\"" + button.topic + "\"><br>";
-      html += "<label for=\"button_mode" + String(i) + "\">Mode:</label><select id=\"button_mode" + String(i) + "\" name=\"button_mode" + String(i) + "\">";
-      html += "<option value=\"" + String(OUTPUT) + "\" " + (button.mode == OUTPUT ? "selected" : "") + ">OUTPUT</option>";
-      html += "<option value=\"" + String(INPUT) + "\" " + (button.mode == INPUT ? "selected" : "") + ">INPUT</option>";
-      html += "<option value=\"" + String(INPUT_PULLUP) + "\" " + (button.mode == INPUT_PULLUP ? "selected" : "") + ">INPUT_PULLUP</option>";
-      html += "<option value=\"" + String(INPUT_PULLDOWN) + "\" " + (button.mode == INPUT_PULLDOWN ? "selected" : "") + ">INPUT_PULLDOWN</option>";
-      html += "</select><br>";
-      html += "<button type='button' onclick=\"deleteButton(" + String(i) + ")\">Delete</button>";
-    }
-    
-    html += "<button type=\"button\" onclick=\"addButton()\">Add Button</button><br>";
-    html += "<input type=\"submit\" value=\"Save\">";
-    html += "<button onclick=\"location.href='/'\">BACK</button><br>";
-    html += "<button onclick=\"location.href='/ota'\">OTA FW Update</button><br>";
-    // html += "<form action=\"/\" method=\"GET\"><button type=\"submit\">Back</button></form>";
-    html += "</form>";
-    html += "<script>";
-    html += "function addButton() {";
-    html += "const form = document.querySelector('form');";
-    html += "const buttonCount = form.querySelectorAll('h3').length;";
-    html += "const html = `<h3>Button ${buttonCount+1}</h3>` +";
-    html += "`<label for=\"button_name${buttonCount}\">Name:</label><input type=\"text\" id=\"button_name${buttonCount}\" name=\"button_name${buttonCount}\"><br>` +";
-    html += "`<label for=\"button_pin${buttonCount}\">Pin:</label><input type=\"text\" id=\"button_pin${buttonCount}\" name=\"button_pin${buttonCount}\"><br>` +";
-    html += "`<label for=\"button_duration${buttonCount}\">Duration (ms):</label><input type=\"text\" id=\"button_duration${buttonCount}\" name=\"button_duration${buttonCount}\"><br>` +";
-    html += "`<label for=\"button_topic${buttonCount}\">MQTT Topic:</label><input type=\"text\" id=\"button_topic${buttonCount}\" name=\"button_topic${buttonCount}\"><br>` +";
-    html += "`<label for=\"button_mode${buttonCount}\">Mode:</label><select id=\"button_mode${buttonCount}\" name=\"button_mode${buttonCount}\">` +";
-    html += "`<option value=\"" + String(OUTPUT) + "\">OUTPUT</option>` +";
-    html += "`<option value=\"" + String(INPUT) + "\">INPUT</option>` +";
-    html += "`<option value=\"" + String(INPUT_PULLUP) + "\">INPUT_PULLUP</option>` +";
-    html += "`<option value=\"" + String(INPUT_PULLDOWN) + "\">INPUT_PULLDOWN</option>` +";
-    html += "`</select><br>` +";
-    html += "`<button onclick=\"deleteButton${buttonCount}\">Delete</button>` +";
-    html += "`<button type=\"button\" onclick=\"addButton()\">Add Button</button><br>`;";
-    html += "form.insertAdjacentHTML('beforeend', html);";
-    html += "}";
-    html += "function scanWifi() {";
-    html += "  var xhttp = new XMLHttpRequest();";
-    html += "  xhttp.onreadystatechange = function() {";
-    html += "    if (this.readyState == 4 && this.status == 200) {";
-    html += "      var networks = JSON.parse(this.responseText);";
-    html += "      var ssidField = document.getElementById('ssid');";
-    html += "      var datalist = document.createElement('datalist');";
-    html += "      datalist.id = 'ssid_list';";
-    html += "      networks.forEach(function(network) {";
-    html += "        var option = document.createElement('option');";
-    html += "        option.value = network;";
-    html += "        datalist.appendChild(option);";
-    html += "      });";
-    html += "      ssidField.setAttribute('list', 'ssid_list');";
-    html += "      ssidField.parentNode.insertBefore(datalist, ssidField.nextSibling);";
-    html += "    }";
-    html += "  };";
-    html += "  xhttp.open('GET', '/scan', true);";
-    html += "  xhttp.send();";
-    html += "}";
-    html += "function deleteButton(index) {";
-    html += "  var xhttp = new XMLHttpRequest();";
-    html += "  xhttp.open('POST', '/deleteButton', true);";
-    html += "  xhttp.setRequestHeader('Content-Type', 'application/x-www-form-urlencoded');";
-    html += "  xhttp.onreadystatechange = function() {";
-    html += "    if (this.readyState == 4 && this.status == 200) {";
-    html += "      location.reload();";
-    html += "    }";
-    html += "  };";
-    html += "  xhttp.send('index=' + index);";
-    html += "}";
-    html += "function saveConfig(event) {";
-    html += "  event.preventDefault();";
-    html += "  var form = event.target;";
-    html += "  var data = new FormData(form);";
-    html += "  var xhttp = new XMLHttpRequest();";
-    html += "  xhttp.open('POST', '/save', true);";
-    html += "  xhttp.onreadystatechange = function() {";
-    html += "    if (this.readyState == 4 && this.status == 200) {";
-    html += "      setTimeout(\"alert('Configuration saved');\",1);";
-    html += "    }";
-    html += "  };";
-    html += "  xhttp.send(data);";
-    html += "}";
-    html += "</script>";
-    html += "</body></html>";
-    request->send(200, "text/html", html);
-  });
-
-  server.on("/save", HTTP_POST, handleSaveConfig);
-  server.on("/deleteButton", HTTP_POST, handleDeleteButton);
-  server.on("/restart", HTTP_POST, handleRestart);
-  server.on("/temp", HTTP_GET, handleTemperature);
-  server.on("/ota", HTTP_GET, handleOTA);
-  server.on("/update", HTTP_POST, [](AsyncWebServerRequest *request) {
-    request->send(200);
-  }, handleUpdateUpload);
-  server.on("/update_url", HTTP_POST, handleUpdateUrl);
-  server.on("/trigger", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (request->hasParam("pin") && request->hasParam("duration")) {
-      int pin = request->getParam("pin")->value().toInt();
-      unsigned long duration = request->getParam("duration")->value().toInt();
-      digitalWrite(pin, HIGH);
-      delay(duration);
-      digitalWrite(pin, LOW);
-      request->send(200, "text/plain", "PIN " + String(pin) + " Triggered for " + String(duration) + " ms");
-    } else {
-      request->send(400, "text/plain", "Invalid parameters");
-    }
-  });
-  server.on("/button_state", HTTP_GET, handleButtonState);
-  server.on("/scan", HTTP_GET, [](AsyncWebServerRequest *request){
-    String json = "[";
-    int n = WiFi.scanComplete();
-    if (n == -2) {
-      WiFi.scanNetworks(true);
-    } else if (n) {
-      for (int i = 0; i < n; ++i) {
-        if (i) json += ",";
-        json += "\"" + WiFi.SSID(i) + "\"";
-      }
-      WiFi.scanDelete();
-      if (WiFi.scanComplete() == -2) {
-        WiFi.scanNetworks(true);
-      }
-    }
-    json += "]";
-    request->send(200, "application/json", json);
-  });
+  server.on("/", HTTP_GET, timed("/", [](AsyncWebServerRequest *request){
+    sendAsset(request, "/index.html", "text/html");
+  }));
+  server.on("/config", HTTP_GET, timed("/config", [](AsyncWebServerRequest *request){
+    sendAsset(request, "/config.html", "text/html");
+  }));
+  server.on("/api/info", HTTP_GET, timed("/api/info", handleApiInfo));
+  server.on("/api/config/export", HTTP_GET, timed("/api/config/export", handleConfigExport));
+  server.on("/api/config/import", HTTP_POST, timed("/api/config/import", handleConfigImport), nullptr, handleConfigImportBody);
+  server.on("/api/config", HTTP_GET, timed("/api/config", handleApiConfig));
+  server.on("/api/state", HTTP_GET, timed("/api/state", handleApiState));
+  server.on("/save", HTTP_POST, timed("/save", handleSaveConfig));
+  server.on("/deleteButton", HTTP_POST, timed("/deleteButton", handleDeleteButton));
+  server.on("/restart", HTTP_POST, timed("/restart", handleRestart, false));
+  server.on("/temp", HTTP_GET, timed("/temp", handleTemperature));
+  server.on("/ota", HTTP_GET, timed("/ota", [](AsyncWebServerRequest *request){
+    sendAsset(request, "/ota.html", "text/html");
+  }));
+  server.on("/update", HTTP_POST, timed("/update", handleUpdate, false), handleUpdateUpload);
+  server.on("/update_url", HTTP_POST, timed("/update_url", handleUpdateUrl, false));
+  server.on("/update_status", HTTP_GET, timed("/update_status", handleUpdateStatus));
+  server.on("/update_check", HTTP_GET | HTTP_POST, timed("/update_check", handleUpdateCheck));
+  server.on("/rollout", HTTP_GET, timed("/rollout", handleRollout));
+  server.on("/trigger", HTTP_GET, timed("/trigger", [](AsyncWebServerRequest *request){
+    const AsyncWebParameter *pin = request->getParam("pin");
+    const AsyncWebParameter *duration = request->getParam("duration");
+    char message[64];
+    int code = handleTrigger(pin ? pin->value().c_str() : nullptr, duration ? duration->value().c_str() : nullptr,
+                             message, sizeof(message));
+    request->send(code, "text/plain", message);
+  }));
+  server.on("/macro", HTTP_POST, timed("/macro", handleMacro));
+  server.on("/macros", HTTP_GET, timed("/macros", handleMacros));
+  server.on("/button_state", HTTP_GET, timed("/button_state", handleButtonState));
+  server.on("/pulses", HTTP_GET, timed("/pulses", handlePulses));
+  server.on("/mqtt", HTTP_GET, timed("/mqtt", handleMqttStatus));
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/boot", HTTP_GET, timed("/boot", handleBoot));
+  server.on("/events", HTTP_GET, timed("/events", handleEvents));
+  server.on("/scan", HTTP_GET, timed("/scan", handleScan));
+  live.begin(server);
   server.begin();
-  sensors->begin();
+  bootProfile.mark(BOOT_SERVER, millis());
 
-}
+  startTask(TASK_NETWORK, networkTask);
 
-void reconnect() {
-  while (!client.connected()) {
-    Serial.print("Attempting MQTT connection...");
-    if (client.connect(deviceID.c_str(), config.mqtt_user.c_str(), config.mqtt_password.c_str())) {
-      Serial.println("connected");
-      Serial.println(WiFi.localIP());
-      for (ButtonConfig button : config.buttons) {
-        client.subscribe(button.topic.c_str());
-      }
-    } else {
-      Serial.print("failed, rc=");
-      Serial.print(client.state());
-      Serial.println(" try again in 5 seconds");
-      Serial.println(WiFi.localIP());
-      delay(5000);
-    }
-  }
 }
 
+// Вся работа выполняется в задачах из tasks.h
 void loop() {
-  if (!client.connected()) {
-    reconnect();
-  }
-  client.loop();
-  delay(100);
+  vTaskDelete(NULL);
 }
@@ -0,0 +1,108 @@
+#include "metrics.h"
+#include <esp_heap_caps.h>
+
+Metrics metrics;
+
+// Границы корзин, мкс
+const uint32_t DurationHistogram::bounds[METRICS_LOOP_BUCKETS] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+DurationHistogram::DurationHistogram() : buckets{}, total(0), sumUs(0), max(0) {
+}
+
+void DurationHistogram::record(uint32_t us) {
+  size_t i = 0;
+  while (i < METRICS_LOOP_BUCKETS && us > bounds[i]) i++;
+  buckets[i]++;
+  total++;
+  sumUs += us;
+  if (us > max) max = us;
+}
+
+// Значения выше последней границы оцениваются максимумом
+uint32_t DurationHistogram::quantileUs(float q) const {
+  if (!total) return 0;
+  uint32_t rank = (uint32_t)(q * total + 0.5f);
+  if (rank < 1) rank = 1;
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < METRICS_LOOP_BUCKETS; i++) {
+    cumulative += buckets[i];
+    if (cumulative >= rank) return bounds[i] < max ? bounds[i] : max;
+  }
+  return max;
+}
+
+void DurationHistogram::render(Print &out, const char *name, const char *maxName) const {
+  out.printf("# TYPE %s histogram\n", name);
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < METRICS_LOOP_BUCKETS; i++) {
+    cumulative += buckets[i];
+    out.printf("%s_bucket{le=\"%g\"} %u\n", name, bounds[i] / 1e6, cumulative);
+  }
+  out.printf("%s_bucket{le=\"+Inf\"} %u\n", name, total);
+  out.printf("%s_sum %.6f\n", name, sumUs / 1e6);
+  out.printf("%s_count %u\n", name, total);
+  out.printf("# TYPE %s gauge\n", maxName);
+  out.printf("%s %.6f\n", maxName, max / 1e6);
+}
+
+uint32_t heapAllocatedBlocks() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+  return info.allocated_blocks;
+}
+
+Metrics::Metrics() : mqttReceived(0), mqttPublished(0), mqttPublishErrors(0), routeCount(0) {
+}
+
+void Metrics::recordLoop(uint32_t us) {
+  loop.record(us);
+}
+
+RouteStats *Metrics::route(const char *path) {
+  if (routeCount >= METRICS_MAX_ROUTES) return nullptr;
+  routes[routeCount] = RouteStats{path, 0, 0, 0};
+  return &routes[routeCount++];
+}
+
+void Metrics::recordRoute(RouteStats *stats, uint32_t us) {
+  stats->count++;
+  stats->totalUs += us;
+  if (us > stats->maxUs) stats->maxUs = us;
+}
+
+void Metrics::render(Print &out) const {
+  loop.render(out, "pcc_loop_duration_seconds", "pcc_loop_duration_max_seconds");
+
+  out.print("# TYPE pcc_http_requests_total counter\n");
+  for (size_t i = 0; i < routeCount; i++) {
+    out.printf("pcc_http_requests_total{route=\"%s\"} %u\n", routes[i].route, routes[i].count);
+  }
+  out.print("# TYPE pcc_http_request_duration_seconds_sum counter\n");
+  for (size_t i = 0; i < routeCount; i++) {
+    out.printf("pcc_http_request_duration_seconds_sum{route=\"%s\"} %.6f\n", routes[i].route, routes[i].totalUs / 1e6);
+  }
+  out.print("# TYPE pcc_http_request_duration_max_seconds gauge\n");
+  for (size_t i = 0; i < routeCount; i++) {
+    out.printf("pcc_http_request_duration_max_seconds{route=\"%s\"} %.6f\n", routes[i].route, routes[i].maxUs / 1e6);
+  }
+
+  out.print("# TYPE pcc_heap_free_bytes gauge\n");
+  out.printf("pcc_heap_free_bytes %u\n", ESP.getFreeHeap());
+  out.print("# TYPE pcc_heap_min_free_bytes gauge\n");
+  out.printf("pcc_heap_min_free_bytes %u\n", ESP.getMinFreeHeap());
+  out.print("# TYPE pcc_heap_max_alloc_bytes gauge\n");
+  out.printf("pcc_heap_max_alloc_bytes %u\n", ESP.getMaxAllocHeap());
+  out.print("# TYPE pcc_heap_allocated_blocks gauge\n");
+  out.printf("pcc_heap_allocated_blocks %u\n", heapAllocatedBlocks());
+  out.print("# TYPE pcc_uptime_seconds counter\n");
+  out.printf("pcc_uptime_seconds %lu\n", millis() / 1000);
+
+  out.print("# TYPE pcc_mqtt_messages_received_total counter\n");
+  out.printf("pcc_mqtt_messages_received_total %u\n", mqttReceived);
+  out.print("# TYPE pcc_mqtt_messages_published_total counter\n");
+  out.printf("pcc_mqtt_messages_published_total %u\n", mqttPublished);
+  out.print("# TYPE pcc_mqtt_publish_errors_total counter\n");
+  out.printf("pcc_mqtt_publish_errors_total %u\n", mqttPublishErrors);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Число корзин гистограмм длительности
+#define METRICS_LOOP_BUCKETS 12
+// Максимум маршрутов HTTP с учётом времени обработки
+#define METRICS_MAX_ROUTES 40
+
+// Статистика одного маршрута HTTP
+struct RouteStats {
+  const char *route;
+  uint32_t count;
+  uint64_t totalUs;
+  uint32_t maxUs;
+};
+
+// Гистограмма длительностей в мкс с корзинами от 100 мкс до 1 с.
+// Квантили оцениваются по верхней границе корзины.
+class DurationHistogram {
+public:
+  DurationHistogram();
+
+  void record(uint32_t us);
+  uint32_t count() const { return total; }
+  uint32_t maxUs() const { return max; }
+  uint32_t quantileUs(float q) const;
+  // Гистограмма Prometheus name_bucket/_sum/_count и максимум maxName, в секундах
+  void render(Print &out, const char *name, const char *maxName) const;
+
+  static const uint32_t bounds[METRICS_LOOP_BUCKETS];
+
+private:
+  uint32_t buckets[METRICS_LOOP_BUCKETS + 1];
+  uint32_t total;
+  uint64_t sumUs;
+  uint32_t max;
+};
+
+// Счётчики для /metrics. Запись - несколько инкрементов без блокировок,
+// так что учёт можно держать включённым постоянно.
+class Metrics {
+public:
+  Metrics();
+
+  void recordLoop(uint32_t us);
+  // Регистрация маршрута; nullptr, если таблица заполнена
+  RouteStats *route(const char *path);
+  void recordRoute(RouteStats *stats, uint32_t us);
+
+  // Счётчики MQTT
+  uint32_t mqttReceived;
+  uint32_t mqttPublished;
+  uint32_t mqttPublishErrors;
+
+  uint32_t loopMaxUs() const { return loop.maxUs(); }
+  uint32_t loopCount() const { return loop.count(); }
+
+  // Вывод в текстовом формате Prometheus
+  void render(Print &out) const;
+
+private:
+  DurationHistogram loop;
+  RouteStats routes[METRICS_MAX_ROUTES];
+  size_t routeCount;
+};
+
+extern Metrics metrics;
+
+// Число занятых блоков кучи; рост при неизменной нагрузке - утечка
+uint32_t heapAllocatedBlocks();
@@ -0,0 +1,91 @@
+#include "mqtt_connection.h"
+
+MqttConnection::MqttConnection(MqttTransport &client)
+  : client(client), connectFn(nullptr), current(DISCONNECTED), nextAttempt(0),
+    attemptCount(0), failureCount(0), connectCount(0), disconnectCount(0), failureStreak(0) {
+}
+
+void MqttConnection::begin(ConnectFn connect) {
+  connectFn = connect;
+  current = DISCONNECTED;
+  nextAttempt = hal::millis();
+}
+
+const char *MqttConnection::stateName() const {
+  switch (current) {
+    case DISCONNECTED: return "disconnected";
+    case CONNECTING: return "connecting";
+    case CONNECTED: return "connected";
+    case BACKOFF: return "backoff";
+  }
+  return "unknown";
+}
+
+unsigned long MqttConnection::retryIn(unsigned long now) const {
+  if (current != BACKOFF) return 0;
+  long left = (long)(nextAttempt - now);
+  return left > 0 ? left : 0;
+}
+
+// Пауза выбирается случайно в [backoff/2, backoff), чтобы устройства
+// не переподключались к брокеру одновременно
+void MqttConnection::schedule(unsigned long now, unsigned long backoff) {
+  unsigned long half = backoff / 2;
+  nextAttempt = now + half + esp_random() % (half ? half : 1);
+  current = BACKOFF;
+}
+
+void MqttConnection::reconnect() {
+  if (client.connected()) {
+    client.disconnect();
+    disconnectCount++;
+  }
+  current = DISCONNECTED;
+  failureStreak = 0;
+  nextAttempt = hal::millis();
+}
+
+void MqttConnection::loop(unsigned long now) {
+  if (!connectFn) return;
+
+  if (client.connected()) {
+    current = CONNECTED;
+    client.loop();
+    return;
+  }
+
+  if (current == CONNECTED) {
+    Serial.println("MQTT connection lost");
+    disconnectCount++;
+    failureStreak = 0;
+    schedule(now, MQTT_BACKOFF_MIN);
+    return;
+  }
+
+  if (current == BACKOFF && (long)(now - nextAttempt) < 0) return;
+
+  current = CONNECTING;
+  attemptCount++;
+  Serial.print("Attempting MQTT connection...");
+  if (connectFn()) {
+    Serial.println("connected");
+    current = CONNECTED;
+    connectCount++;
+    failureStreak = 0;
+    return;
+  }
+
+  failureCount++;
+  if (failureStreak < 31) failureStreak++;
+  unsigned long backoff = MQTT_BACKOFF_MIN;
+  for (uint32_t i = 1; i < failureStreak && backoff < MQTT_BACKOFF_MAX; i++) {
+    backoff *= 2;
+  }
+  if (backoff > MQTT_BACKOFF_MAX) backoff = MQTT_BACKOFF_MAX;
+  schedule(now, backoff);
+  Serial.print("failed, rc=");
+  Serial.print(client.state());
+  Serial.print(" try again in ");
+  Serial.print(retryIn(now));
+  Serial.println(" ms");
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include "hal.h"
+
+// Начальная и максимальная пауза между попытками подключения, мс
+#define MQTT_BACKOFF_MIN 1000
+#define MQTT_BACKOFF_MAX 60000
+
+// Неблокирующее подключение к MQTT: не более одной попытки за проход loop(),
+// экспоненциальная пауза между неудачами со случайным разбросом.
+class MqttConnection {
+public:
+  enum State { DISCONNECTED, CONNECTING, CONNECTED, BACKOFF };
+
+  // Выполняет client.connect() и подписки, возвращает успех
+  typedef bool (*ConnectFn)();
+
+  explicit MqttConnection(MqttTransport &client);
+
+  void begin(ConnectFn connect);
+  void loop(unsigned long now);
+  // Закрыть сессию и подключиться заново без паузы - после смены
+  // сервера или учётных данных
+  void reconnect();
+
+  State state() const { return current; }
+  const char *stateName() const;
+  uint32_t attempts() const { return attemptCount; }
+  uint32_t failures() const { return failureCount; }
+  uint32_t connects() const { return connectCount; }
+  uint32_t disconnects() const { return disconnectCount; }
+  // Подряд идущие неудачи с момента последнего успешного подключения
+  uint32_t streak() const { return failureStreak; }
+  // Сколько осталось до следующей попытки, мс
+  unsigned long retryIn(unsigned long now) const;
+
+private:
+  void schedule(unsigned long now, unsigned long backoff);
+
+  MqttTransport &client;
+  ConnectFn connectFn;
+  volatile State current;
+  unsigned long nextAttempt;
+  uint32_t attemptCount;
+  uint32_t failureCount;
+  uint32_t connectCount;
+  uint32_t disconnectCount;
+  uint32_t failureStreak;
+};
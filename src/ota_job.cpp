@@ -0,0 +1,295 @@
+#include "ota_job.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include "event_log.h"
+
+OtaJob otaJob;
+
+static mbedtls_sha256_context shaContext;
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseDigest(const String &hex, uint8_t *out) {
+  if (hex.length() != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    int hi = hexDigit(hex[2 * i]);
+    int lo = hexDigit(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = (hi << 4) | lo;
+  }
+  return true;
+}
+
+OtaJob::OtaJob() : verify(false), compressed(false), started(0), mux(portMUX_INITIALIZER_UNLOCKED) {
+  memset(&current, 0, sizeof(current));
+  current.state = IDLE;
+}
+
+const char *OtaJob::startError(StartResult result) {
+  switch (result) {
+    case STARTED: return "";
+    case BAD_DIGEST: return "invalid SHA-256 digest";
+    case BUSY: return "update already running";
+    case UPLOAD_RUNNING: return "browser upload running";
+    case NO_TASK: return "failed to start OTA task";
+  }
+  return "unknown";
+}
+
+bool OtaJob::validDigest(const String &sha256) {
+  uint8_t digest[32];
+  return sha256.isEmpty() || parseDigest(sha256, digest);
+}
+
+const char *OtaJob::stateName(State state) {
+  switch (state) {
+    case IDLE: return "idle";
+    case DOWNLOADING: return "downloading";
+    case VERIFYING: return "verifying";
+    case DONE: return "done";
+    case FAILED: return "failed";
+  }
+  return "unknown";
+}
+
+bool OtaJob::busy() const {
+  portENTER_CRITICAL(&mux);
+  bool running = current.state == DOWNLOADING || current.state == VERIFYING;
+  portEXIT_CRITICAL(&mux);
+  return running;
+}
+
+OtaJob::Status OtaJob::status() const {
+  portENTER_CRITICAL(&mux);
+  Status s = current;
+  portEXIT_CRITICAL(&mux);
+  return s;
+}
+
+// start() вызывают обработчик /update_url, проверка обновлений и раскатка
+// из разных задач, поэтому загрузка сначала занимается под mux, и только
+// потом заполняются её поля
+OtaJob::StartResult OtaJob::start(const String &imageUrl, const String &sha256) {
+  uint8_t digest[32];
+  bool check = !sha256.isEmpty();
+  if (check && !parseDigest(sha256, digest)) return BAD_DIGEST;
+  if (Update.isRunning()) return UPLOAD_RUNNING;
+
+  portENTER_CRITICAL(&mux);
+  bool claimed = current.state != DOWNLOADING && current.state != VERIFYING;
+  if (claimed) {
+    memset(&current, 0, sizeof(current));
+    current.state = DOWNLOADING;
+  }
+  portEXIT_CRITICAL(&mux);
+  if (!claimed) return BUSY;
+
+  verify = check;
+  memcpy(expected, digest, sizeof(expected));
+  url = imageUrl;
+  started = millis();
+  eventLog.add(EVENT_OTA_START);
+
+  if (xTaskCreate(taskEntry, "ota", 8192, this, 1, nullptr) != pdPASS) {
+    fail("Failed to start OTA task");
+    return NO_TASK;
+  }
+  return STARTED;
+}
+
+void OtaJob::taskEntry(void *arg) {
+  static_cast<OtaJob *>(arg)->run();
+  vTaskDelete(nullptr);
+}
+
+void OtaJob::fail(const char *message) {
+  Serial.printf("OTA failed: %s\n", message);
+  eventLog.add(EVENT_OTA_FAILED);
+  if (Update.isRunning()) Update.abort();
+  gzip.end();
+  portENTER_CRITICAL(&mux);
+  current.state = FAILED;
+  strlcpy(current.error, message, sizeof(current.error));
+  portEXIT_CRITICAL(&mux);
+}
+
+// Запись скачанных байт в раздел OTA. По первому блоку определяется,
+// сжат ли образ gzip; сжатый распаковывается на лету.
+bool OtaJob::writeImage(uint8_t *data, size_t len, size_t total) {
+  if (!Update.isRunning()) {
+    compressed = GzipStream::isGzip(data, len);
+    if (!Update.begin(compressed ? UPDATE_SIZE_UNKNOWN : total)) {
+      fail("Not enough space");
+      return false;
+    }
+    if (compressed && !gzip.begin([](uint8_t *out, size_t outLen) { return Update.write(out, outLen) == outLen; })) {
+      fail(gzip.error());
+      return false;
+    }
+  }
+  if (compressed) {
+    if (!gzip.write(data, len)) {
+      fail(Update.hasError() ? Update.errorString() : gzip.error());
+      return false;
+    }
+  } else if (Update.write(data, len) != len) {
+    fail(Update.errorString());
+    return false;
+  }
+  return true;
+}
+
+// Content-Range ответа 206: "bytes <начало>-<конец>/<размер или *>".
+// Продолжать можно, только если сервер отдаёт запрошенное место того же образа.
+static bool rangeMatches(const String &header, size_t offset, size_t total) {
+  unsigned long first, last;
+  char size[16];
+  if (sscanf(header.c_str(), "bytes %lu-%lu/%15s", &first, &last, size) != 3) return false;
+  if (first != offset || last < first) return false;
+  return strcmp(size, "*") == 0 || strtoul(size, nullptr, 10) == total;
+}
+
+// Один HTTP-запрос: с нуля или с текущей позиции через Range.
+// Возвращает false при обрыве, после которого возможна докачка.
+bool OtaJob::download(size_t &total) {
+  size_t offset = current.written;
+  WiFiClient client;
+  HTTPClient http;
+  const char *headers[] = {"Content-Range"};
+  http.begin(client, url);
+  http.setTimeout(OTA_STALL_TIMEOUT);
+  http.collectHeaders(headers, 1);
+  if (offset > 0) {
+    http.addHeader("Range", "bytes=" + String(offset) + "-");
+  }
+
+  int code = http.GET();
+  if (offset > 0 && code != HTTP_CODE_PARTIAL_CONTENT) {
+    http.end();
+    if (code == HTTP_CODE_OK) fail("Server does not support resume");
+    Serial.printf("OTA resume request failed, HTTP %d\n", code);
+    return false;
+  }
+  if (offset > 0) {
+    String range = http.header("Content-Range");
+    if (!rangeMatches(range, offset, total)) {
+      // Докачка не с того места испортила бы образ и хэш: загрузка
+      // начинается заново
+      http.end();
+      Serial.printf("OTA resume got range '%s' for offset %u, restarting\n", range.c_str(), (unsigned)offset);
+      portENTER_CRITICAL(&mux);
+      current.written = 0;
+      portEXIT_CRITICAL(&mux);
+      return false;
+    }
+  }
+  if (offset == 0 && code != HTTP_CODE_OK) {
+    http.end();
+    Serial.printf("OTA request failed, HTTP %d\n", code);
+    return false;
+  }
+
+  if (offset == 0) {
+    int length = http.getSize();
+    if (length <= 0) {
+      http.end();
+      fail("Unknown image size");
+      return false;
+    }
+    total = length;
+    if (Update.isRunning()) Update.abort();
+    mbedtls_sha256_init(&shaContext);
+    mbedtls_sha256_starts(&shaContext, 0);
+    portENTER_CRITICAL(&mux);
+    current.total = total;
+    portEXIT_CRITICAL(&mux);
+  }
+
+  WiFiClient *stream = http.getStreamPtr();
+  uint8_t buffer[OTA_CHUNK_SIZE];
+  unsigned long lastData = millis();
+  while (current.written < total && http.connected()) {
+    size_t available = stream->available();
+    if (!available) {
+      if (millis() - lastData > OTA_STALL_TIMEOUT) break;
+      delay(10);
+      continue;
+    }
+    size_t len = stream->readBytes(buffer, min(available, (size_t)OTA_CHUNK_SIZE));
+    if (len == 0) continue;
+    lastData = millis();
+    mbedtls_sha256_update(&shaContext, buffer, len);
+    if (!writeImage(buffer, len, total)) {
+      http.end();
+      return false;
+    }
+    unsigned long elapsed = millis() - started;
+    portENTER_CRITICAL(&mux);
+    current.written += len;
+    current.rate = elapsed ? (uint64_t)current.written * 1000 / elapsed : 0;
+    portEXIT_CRITICAL(&mux);
+  }
+  http.end();
+  return current.written >= total;
+}
+
+void OtaJob::run() {
+  Serial.printf("OTA download started: %s\n", url.c_str());
+  size_t total = 0;
+  while (!download(total)) {
+    if (current.state == FAILED) return;
+    if (current.retries >= OTA_MAX_RETRIES) {
+      fail("Too many retries");
+      return;
+    }
+    portENTER_CRITICAL(&mux);
+    current.retries++;
+    portEXIT_CRITICAL(&mux);
+    Serial.printf("OTA interrupted at %u bytes, retry %u\n", (unsigned)current.written, current.retries);
+    delay(1000UL << min<uint8_t>(current.retries, 5));
+  }
+
+  portENTER_CRITICAL(&mux);
+  current.state = VERIFYING;
+  portEXIT_CRITICAL(&mux);
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&shaContext, digest);
+  mbedtls_sha256_free(&shaContext);
+  char hex[65];
+  for (int i = 0; i < 32; i++) {
+    snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  }
+  portENTER_CRITICAL(&mux);
+  memcpy(current.sha256, hex, sizeof(hex));
+  portEXIT_CRITICAL(&mux);
+
+  if (verify && memcmp(digest, expected, sizeof(digest)) != 0) {
+    fail("SHA-256 mismatch");
+    return;
+  }
+  if (compressed && !gzip.finished()) {
+    fail("Truncated gzip image");
+    return;
+  }
+  if (!Update.end(true)) {
+    fail(Update.errorString());
+    return;
+  }
+
+  portENTER_CRITICAL(&mux);
+  current.state = DONE;
+  portEXIT_CRITICAL(&mux);
+  Serial.println("Update Success: Rebooting...");
+  eventLog.add(EVENT_OTA_DONE);
+  eventLog.flush(millis(), true);
+  delay(1000);
+  ESP.restart();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+#include "gzip_stream.h"
+
+// Число попыток докачки после обрыва соединения
+#define OTA_MAX_RETRIES 8
+// Таймаут ожидания данных от сервера, мс
+#define OTA_STALL_TIMEOUT 10000
+// Размер блока чтения из сокета
+#define OTA_CHUNK_SIZE 1024
+
+// Фоновая загрузка прошивки по URL: докачка через HTTP Range после обрыва
+// (если Content-Range ответа не совпал с запрошенным, загрузка идёт заново),
+// потоковый SHA-256 с проверкой по опубликованному хэшу, распаковка образов
+// в gzip, прогресс для /update_status. Хэш и прогресс считаются по скачанным байтам.
+class OtaJob {
+public:
+  enum State { IDLE, DOWNLOADING, VERIFYING, DONE, FAILED };
+  // Итог start(): загрузка запущена или причина отказа
+  enum StartResult { STARTED, BAD_DIGEST, BUSY, UPLOAD_RUNNING, NO_TASK };
+
+  struct Status {
+    State state;
+    size_t written;
+    size_t total;
+    uint32_t rate;      // средняя скорость, байт/с
+    uint8_t retries;
+    char error[64];
+    char sha256[65];
+  };
+
+  OtaJob();
+
+  // Запуск загрузки в отдельной задаче; sha256 - hex-строка или пустая
+  StartResult start(const String &url, const String &sha256);
+  bool busy() const;
+  Status status() const;
+  static const char *stateName(State state);
+  static const char *startError(StartResult result);
+  // Пустая строка или 64 hex-цифры
+  static bool validDigest(const String &sha256);
+
+private:
+  static void taskEntry(void *arg);
+  void run();
+  bool download(size_t &total);
+  bool writeImage(uint8_t *data, size_t len, size_t total);
+  void fail(const char *message);
+
+  String url;
+  uint8_t expected[32];
+  bool verify;
+  bool compressed;
+  GzipStream gzip;
+  Status current;
+  unsigned long started;
+  mutable portMUX_TYPE mux;
+};
+
+extern OtaJob otaJob;
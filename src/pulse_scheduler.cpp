@@ -0,0 +1,162 @@
+#include "pulse_scheduler.h"
+#include <esp_timer.h>
+#include "hal.h"
+
+PulseScheduler pulses;
+
+static void defaultWrite(uint8_t pin, uint8_t level) {
+  hal::gpioWrite(pin, level);
+}
+
+static void onPulseTimer(void *arg) {
+  static_cast<PulseScheduler *>(arg)->service(hal::millis());
+}
+
+PulseScheduler::PulseScheduler()
+  : count(0), completed(0), dropped(0), replaced(0), write(defaultWrite), mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+void PulseScheduler::begin() {
+  esp_timer_create_args_t args = {};
+  args.callback = onPulseTimer;
+  args.arg = this;
+  args.name = "pulses";
+  esp_timer_handle_t timer;
+  if (esp_timer_create(&args, &timer) != ESP_OK ||
+      esp_timer_start_periodic(timer, PULSE_TICK_MS * 1000ULL) != ESP_OK) {
+    Serial.println("Failed to start pulse timer.");
+  }
+}
+
+int PulseScheduler::find(int pin) const {
+  for (size_t i = 0; i < count; i++) {
+    if (slots[i].pin == pin) return i;
+  }
+  return -1;
+}
+
+void PulseScheduler::clear() {
+  portENTER_CRITICAL(&mux);
+  for (size_t i = 0; i < count; i++) {
+    if (slots[i].active) write(slots[i].pin, LOW);
+  }
+  count = 0;
+  portEXIT_CRITICAL(&mux);
+}
+
+bool PulseScheduler::addPin(int pin) {
+  bool ok = false;
+  portENTER_CRITICAL(&mux);
+  if (find(pin) >= 0) {
+    ok = true;
+  } else if (count < PULSE_MAX_PINS) {
+    slots[count] = Slot{pin, false, false, 0, 0, 0, 0};
+    count++;
+    ok = true;
+  }
+  portEXIT_CRITICAL(&mux);
+  if (ok) write(pin, LOW);
+  return ok;
+}
+
+bool PulseScheduler::removePin(int pin) {
+  portENTER_CRITICAL(&mux);
+  int i = find(pin);
+  if (i >= 0) {
+    if (slots[i].active) write(pin, LOW);
+    slots[i] = slots[--count];
+  }
+  portEXIT_CRITICAL(&mux);
+  return i >= 0;
+}
+
+bool PulseScheduler::owns(int pin) const {
+  portENTER_CRITICAL(&mux);
+  bool found = find(pin) >= 0;
+  portEXIT_CRITICAL(&mux);
+  return found;
+}
+
+bool PulseScheduler::request(int pin, unsigned long duration, uint32_t received) {
+  portENTER_CRITICAL(&mux);
+  int i = find(pin);
+  if (i < 0) {
+    dropped++;
+    portEXIT_CRITICAL(&mux);
+    return false;
+  }
+  if (slots[i].pending) replaced++;
+  slots[i].pending = true;
+  slots[i].pendingDuration = duration;
+  // Задержка за импульсом, ожидающим окончания текущего, - это его
+  // длительность, а не реакция прошивки
+  slots[i].pendingReceived = slots[i].active ? 0 : received;
+  portEXIT_CRITICAL(&mux);
+  return true;
+}
+
+bool PulseScheduler::cancel(int pin) {
+  portENTER_CRITICAL(&mux);
+  int i = find(pin);
+  if (i < 0) {
+    portEXIT_CRITICAL(&mux);
+    return false;
+  }
+  slots[i].pending = false;
+  if (slots[i].active) {
+    slots[i].active = false;
+    write(pin, LOW);
+  }
+  portEXIT_CRITICAL(&mux);
+  return true;
+}
+
+bool PulseScheduler::isActive(int pin) const {
+  portENTER_CRITICAL(&mux);
+  int i = find(pin);
+  bool active = i >= 0 && slots[i].active;
+  portEXIT_CRITICAL(&mux);
+  return active;
+}
+
+void PulseScheduler::service(unsigned long now) {
+  portENTER_CRITICAL(&mux);
+  for (size_t i = 0; i < count; i++) {
+    Slot &slot = slots[i];
+    if (slot.active && now - slot.start >= slot.duration) {
+      slot.active = false;
+      write(slot.pin, LOW);
+      completed++;
+    }
+    if (!slot.active && slot.pending) {
+      slot.pending = false;
+      slot.active = true;
+      slot.start = now;
+      slot.duration = slot.pendingDuration;
+      write(slot.pin, HIGH);
+      if (slot.pendingReceived) commandLatency.record(hal::micros() - slot.pendingReceived);
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+PulseStats PulseScheduler::stats() const {
+  PulseStats s = {0, 0, 0, 0, 0};
+  portENTER_CRITICAL(&mux);
+  for (size_t i = 0; i < count; i++) {
+    if (slots[i].pending) s.queued++;
+    if (slots[i].active) s.active++;
+  }
+  s.completed = completed;
+  s.dropped = dropped;
+  s.replaced = replaced;
+  portEXIT_CRITICAL(&mux);
+  return s;
+}
+
+DurationHistogram PulseScheduler::latency() const {
+  portENTER_CRITICAL(&mux);
+  DurationHistogram copy = commandLatency;
+  portEXIT_CRITICAL(&mux);
+  return copy;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+#include "metrics.h"
+
+// Максимальное число выходных пинов под управлением планировщика
+#define PULSE_MAX_PINS 16
+// Период таймера обслуживания импульсов, мс
+#define PULSE_TICK_MS 5
+
+// Счётчики планировщика импульсов
+struct PulseStats {
+  uint32_t queued;     // запросы, ожидающие запуска
+  uint32_t active;     // пины, находящиеся сейчас в HIGH
+  uint32_t completed;  // завершённые импульсы с момента старта
+  uint32_t dropped;    // отклонённые запросы (чужой пин)
+  uint32_t replaced;   // отложенные запросы, заменённые новыми до запуска
+};
+
+// Неблокирующий планировщик импульсов для выходных кнопок.
+// request() можно вызывать из любого контекста (MQTT, AsyncTCP),
+// сами переключения пинов выполняет service() по таймеру.
+class PulseScheduler {
+public:
+  typedef void (*WriteFn)(uint8_t pin, uint8_t level);
+
+  PulseScheduler();
+
+  // Запуск периодического таймера, вызывающего service(hal::millis())
+  void begin();
+  // Подмена функции записи в пин (для симуляции без железа)
+  void setWriter(WriteFn fn) { write = fn; }
+
+  // Сброс всех пинов; активные импульсы обрываются в LOW
+  void clear();
+  // Передать выходной пин под управление планировщика
+  bool addPin(int pin);
+  // Снять пин с управления; идущий импульс обрывается в LOW
+  bool removePin(int pin);
+  bool owns(int pin) const;
+
+  // Поставить импульс в очередь; если пин уже активен, импульс
+  // запустится после завершения текущего. received - micros() прихода
+  // команды: задержка до фронта на пине попадает в latency(); 0 - не учитывать
+  bool request(int pin, unsigned long duration, uint32_t received = 0);
+  // Отменить текущий и отложенный импульс на пине
+  bool cancel(int pin);
+  bool isActive(int pin) const;
+
+  // Запуск ожидающих и завершение истёкших импульсов
+  void service(unsigned long now);
+
+  PulseStats stats() const;
+  // Задержка от прихода команды до фронта для импульсов на свободном пине
+  DurationHistogram latency() const;
+
+private:
+  struct Slot {
+    int pin;
+    bool active;
+    bool pending;
+    unsigned long start;
+    unsigned long duration;
+    unsigned long pendingDuration;
+    uint32_t pendingReceived;
+  };
+
+  int find(int pin) const;
+
+  Slot slots[PULSE_MAX_PINS];
+  size_t count;
+  uint32_t completed;
+  uint32_t dropped;
+  uint32_t replaced;
+  DurationHistogram commandLatency;
+  WriteFn write;
+  mutable portMUX_TYPE mux;
+};
+
+extern PulseScheduler pulses;
@@ -0,0 +1,89 @@
+#include "tasks.h"
+
+const TaskSpec taskSpecs[TASK_COUNT] = {
+  {"network", 8192, 2},
+  {"actuation", 3072, 5},
+  {"sensing", 3072, 3},
+  {"persist", 4096, 1},
+};
+
+BoundedQueue<ActuationCommand, ACTUATION_QUEUE_SIZE> actuationQueue;
+BoundedQueue<NetworkEvent, NETWORK_QUEUE_SIZE> networkQueue;
+BoundedQueue<PersistRequest, PERSIST_QUEUE_SIZE> persistQueue;
+
+static TaskHandle_t handles[TASK_COUNT];
+
+bool startTask(TaskId id, TaskFunction_t fn) {
+  const TaskSpec &spec = taskSpecs[id];
+  if (xTaskCreate(fn, spec.name, spec.stack, nullptr, spec.priority, &handles[id]) != pdPASS) {
+    Serial.printf("Failed to start %s task\n", spec.name);
+    handles[id] = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void wakeTask(TaskId id) {
+  if (handles[id]) xTaskNotifyGive(handles[id]);
+}
+
+bool enqueueActuation(const ActuationCommand &command) {
+  if (!actuationQueue.push(command)) return false;
+  wakeTask(TASK_ACTUATION);
+  return true;
+}
+
+bool enqueueNetwork(const NetworkEvent &event) {
+  if (!networkQueue.push(event)) return false;
+  wakeTask(TASK_NETWORK);
+  return true;
+}
+
+bool enqueuePersist(const PersistRequest &request) {
+  if (!persistQueue.push(request)) return false;
+  wakeTask(TASK_PERSIST);
+  return true;
+}
+
+uint32_t taskStackFree(TaskId id) {
+  // В ESP-IDF размер стека и остаток считаются в байтах
+  return handles[id] ? uxTaskGetStackHighWaterMark(handles[id]) : 0;
+}
+
+struct QueueInfo {
+  const char *name;
+  uint32_t depth;
+  uint32_t highWater;
+  uint32_t capacity;
+  uint32_t dropped;
+};
+
+template <typename Q>
+static QueueInfo queueInfo(const char *name, const Q &queue) {
+  return QueueInfo{name, queue.size(), queue.highWater(), (uint32_t)queue.capacity(), queue.dropped()};
+}
+
+void renderTaskMetrics(Print &out) {
+  out.print("# TYPE pcc_task_stack_free_bytes gauge\n");
+  for (int i = 0; i < TASK_COUNT; i++) {
+    out.printf("pcc_task_stack_free_bytes{task=\"%s\"} %u\n", taskSpecs[i].name, taskStackFree((TaskId)i));
+  }
+  out.print("# TYPE pcc_task_stack_size_bytes gauge\n");
+  for (int i = 0; i < TASK_COUNT; i++) {
+    out.printf("pcc_task_stack_size_bytes{task=\"%s\"} %u\n", taskSpecs[i].name, taskSpecs[i].stack);
+  }
+
+  const QueueInfo queues[] = {
+    queueInfo("actuation", actuationQueue),
+    queueInfo("network", networkQueue),
+    queueInfo("persist", persistQueue),
+  };
+  out.print("# TYPE pcc_queue_depth gauge\n");
+  for (const QueueInfo &q : queues) out.printf("pcc_queue_depth{queue=\"%s\"} %u\n", q.name, q.depth);
+  out.print("# TYPE pcc_queue_high_water gauge\n");
+  for (const QueueInfo &q : queues) out.printf("pcc_queue_high_water{queue=\"%s\"} %u\n", q.name, q.highWater);
+  out.print("# TYPE pcc_queue_capacity gauge\n");
+  for (const QueueInfo &q : queues) out.printf("pcc_queue_capacity{queue=\"%s\"} %u\n", q.name, q.capacity);
+  out.print("# TYPE pcc_queue_dropped_total counter\n");
+  for (const QueueInfo &q : queues) out.printf("pcc_queue_dropped_total{queue=\"%s\"} %u\n", q.name, q.dropped);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include "bounded_queue.h"
+#include "config.h"
+
+// Ёмкость очередей команд (степени двойки)
+#define ACTUATION_QUEUE_SIZE 16
+#define NETWORK_QUEUE_SIZE 32
+#define PERSIST_QUEUE_SIZE 4
+
+// Периоды задач при отсутствии команд, мс
+#define NETWORK_TICK_MS 20
+#define ACTUATION_TICK_MS 5
+#define SENSING_TICK_MS 50
+// Период проверки журнала событий задачей persist, мс
+#define PERSIST_TICK_MS 1000
+
+// Команда задаче исполнительных механизмов
+struct ActuationCommand {
+  enum Action : uint8_t { PULSE, CANCEL };
+  Action action;
+  uint8_t pin;
+  uint32_t duration;
+  uint32_t received;  // micros() прихода команды, 0 - задержка не учитывается
+};
+
+// Событие для сетевой задачи. Новая конфигурация передаётся владением:
+// её удаляет получатель.
+struct NetworkEvent {
+  enum Type : uint8_t { INPUT_CHANGED, APPLY_CONFIG };
+  Type type;
+  bool state;
+  uint8_t index;
+  uint32_t timestamp;
+  Config *config;
+};
+
+// Снимок конфигурации для записи во флеш, удаляется задачей сохранения
+struct PersistRequest {
+  Config *config;
+};
+
+// Задачи прошивки:
+//  network   - MQTT, телеметрия, SSE, применение конфигурации
+//  actuation - импульсы на выходах и антидребезг входов
+//  sensing   - опрос датчиков температуры
+//  persist   - запись конфигурации в LittleFS
+enum TaskId { TASK_NETWORK, TASK_ACTUATION, TASK_SENSING, TASK_PERSIST, TASK_COUNT };
+
+struct TaskSpec {
+  const char *name;
+  uint32_t stack;        // байт
+  UBaseType_t priority;
+};
+
+extern const TaskSpec taskSpecs[TASK_COUNT];
+
+extern BoundedQueue<ActuationCommand, ACTUATION_QUEUE_SIZE> actuationQueue;
+extern BoundedQueue<NetworkEvent, NETWORK_QUEUE_SIZE> networkQueue;
+extern BoundedQueue<PersistRequest, PERSIST_QUEUE_SIZE> persistQueue;
+
+bool startTask(TaskId id, TaskFunction_t fn);
+// Разбудить задачу, ожидающую в ulTaskNotifyTake()
+void wakeTask(TaskId id);
+
+// Постановка в очередь с пробуждением получателя; false - очередь полна
+bool enqueueActuation(const ActuationCommand &command);
+bool enqueueNetwork(const NetworkEvent &event);
+bool enqueuePersist(const PersistRequest &request);
+
+// Свободный остаток стека задачи за всё время работы, байт
+uint32_t taskStackFree(TaskId id);
+// Стек задач и глубина очередей в формате Prometheus
+void renderTaskMetrics(Print &out);
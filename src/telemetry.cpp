@@ -0,0 +1,101 @@
+#include "telemetry.h"
+#include <WiFi.h>
+#include "config_store.h"
+
+Telemetry telemetry;
+
+Telemetry::Telemetry()
+  : publish(nullptr), sentTemps{}, sentValid{}, resync(true), lastBatch(0), lastHeartbeat(0),
+    messageCount(0), byteCount(0) {
+  prefix[0] = 0;
+}
+
+void Telemetry::begin(const char *deviceID, PublishFn fn) {
+  snprintf(prefix, sizeof(prefix), "pcc/%s", deviceID);
+  publish = fn;
+}
+
+void Telemetry::reset(size_t buttonCount) {
+  inputs.assign(buttonCount, -1);
+  sentInputs.assign(buttonCount, -1);
+}
+
+void Telemetry::setInput(size_t index, bool state) {
+  if (index < inputs.size()) inputs[index] = state;
+}
+
+// Добавляет в doc значения, отличающиеся от отправленных (или все при all);
+// отправленные значения сразу запоминаются. Возвращает true, если есть что слать.
+bool Telemetry::collect(JsonDocument &doc, bool all) {
+  bool any = false;
+  TempSensor sensor;
+  for (size_t i = 0; i < TEMP_MAX_SENSORS && tempSampler.sensor(i, sensor); i++) {
+    const TempReading &reading = sensor.reading;
+    bool changed = reading.valid != sentValid[i] ||
+                   (reading.valid && fabsf(reading.value - sentTemps[i]) >= config.telemetry_deadband);
+    if (!all && !changed) continue;
+    char address[SENSOR_ADDRESS_TEXT];
+    const char *key = sensorLabel(config, sensor.address, address);
+    if (reading.valid) {
+      doc["temp"][key] = roundf(reading.value * 10) / 10;
+    } else {
+      doc["temp"][key] = nullptr;
+    }
+    sentValid[i] = reading.valid;
+    sentTemps[i] = reading.value;
+    any = true;
+  }
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (inputs[i] < 0 || (!all && inputs[i] == sentInputs[i])) continue;
+    const ButtonConfig &button = config.buttons[i];
+    char fallback[8];
+    snprintf(fallback, sizeof(fallback), "in%u", (unsigned)i);
+    doc["inputs"][button.name.isEmpty() ? fallback : button.name.c_str()] = inputs[i];
+    sentInputs[i] = inputs[i];
+    any = true;
+  }
+  return any;
+}
+
+bool Telemetry::send(const char *suffix, JsonDocument &doc, bool retained) {
+  if (!publish) return false;
+  char topic[64];
+  snprintf(topic, sizeof(topic), "%s/%s", prefix, suffix);
+  char payload[1024];
+  size_t len = serializeJson(doc, payload, sizeof(payload));
+  if (len == 0 || len >= sizeof(payload) - 1) {
+    Serial.printf("Telemetry %s payload too large\n", suffix);
+    return false;
+  }
+  if (!publish(topic, payload, retained)) return false;
+  messageCount++;
+  byteCount += len;
+  return true;
+}
+
+void Telemetry::publishState(unsigned long now) {
+  JsonDocument doc;
+  collect(doc, true);
+  doc["uptime"] = now / 1000;
+  resync = !send("state", doc, true);
+  lastBatch = now;
+}
+
+void Telemetry::loop(unsigned long now, bool connected) {
+  if (!connected) return;
+
+  if (config.heartbeat_interval && now - lastHeartbeat >= config.heartbeat_interval * 1000UL) {
+    lastHeartbeat = now;
+    JsonDocument doc;
+    doc["uptime"] = now / 1000;
+    doc["rssi"] = WiFi.RSSI();
+    send("heartbeat", doc, false);
+  }
+
+  if (!config.telemetry_interval || now - lastBatch < config.telemetry_interval * 1000UL) return;
+  lastBatch = now;
+  JsonDocument doc;
+  if (!collect(doc, resync)) return;
+  // Если сообщение не ушло, в следующий раз отправляется всё состояние
+  resync = !send("telemetry", doc, false);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+#include "temp_sampler.h"
+
+// Телеметрия в MQTT: раз в интервал одно сообщение pcc/<id>/telemetry
+// только с изменившимися значениями (температура - за пределами зоны
+// нечувствительности), retained-снимок pcc/<id>/state при подключении
+// и heartbeat pcc/<id>/heartbeat с аптаймом и RSSI.
+class Telemetry {
+public:
+  typedef bool (*PublishFn)(const char *topic, const char *payload, bool retained);
+
+  Telemetry();
+
+  void begin(const char *deviceID, PublishFn fn);
+  // Сброс известных состояний после изменения списка кнопок
+  void reset(size_t buttonCount);
+  void setInput(size_t index, bool state);
+  // Полный снимок состояния (retained), вызывается после подключения
+  void publishState(unsigned long now);
+  void loop(unsigned long now, bool connected);
+
+  uint32_t messages() const { return messageCount; }
+  uint32_t bytes() const { return byteCount; }
+
+private:
+  bool collect(JsonDocument &doc, bool all);
+  bool send(const char *suffix, JsonDocument &doc, bool retained);
+
+  char prefix[48];
+  PublishFn publish;
+  std::vector<int8_t> inputs;
+  std::vector<int8_t> sentInputs;
+  float sentTemps[TEMP_MAX_SENSORS];
+  bool sentValid[TEMP_MAX_SENSORS];
+  bool resync;
+  unsigned long lastBatch;
+  unsigned long lastHeartbeat;
+  uint32_t messageCount;
+  uint32_t byteCount;
+};
+
+extern Telemetry telemetry;
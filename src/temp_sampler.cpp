@@ -0,0 +1,213 @@
+#include "temp_sampler.h"
+
+// Значение DallasTemperature для отсутствующего датчика
+#define TEMP_DISCONNECTED -127
+
+TempSampler tempSampler;
+
+// Время конверсии DS18B20: 750 мс на 12 бит, вдвое меньше на каждый бит меньше
+static unsigned long conversionMillis(uint8_t bits) {
+  return 750UL >> (12 - constrain(bits, 9, 12));
+}
+
+TempSampler::TempSampler()
+  : busCount(0), sensorCount(0), resolutionCount(0), state(IDLE), started(0),
+    conversionTime(0), lastScan(0), scanned(false), rescanRequested(false), sampleCount(0), topologyVersion(0),
+    mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+void TempSampler::clear() {
+  portENTER_CRITICAL(&mux);
+  busCount = 0;
+  sensorCount = 0;
+  topologyVersion++;
+  portEXIT_CRITICAL(&mux);
+  state = IDLE;
+  scanned = false;
+  started = hal::millis() - TEMP_SAMPLE_INTERVAL;
+}
+
+bool TempSampler::addBus(TempBus *bus) {
+  if (busCount >= TEMP_MAX_BUSES) return false;
+  buses[busCount++] = bus;
+  scanned = false;
+  return true;
+}
+
+void TempSampler::clearResolutions() {
+  portENTER_CRITICAL(&mux);
+  resolutionCount = 0;
+  portEXIT_CRITICAL(&mux);
+}
+
+void TempSampler::setResolution(const uint8_t *address, uint8_t bits) {
+  portENTER_CRITICAL(&mux);
+  size_t i = 0;
+  while (i < resolutionCount && memcmp(resolutions[i].address, address, sizeof(TempAddress)) != 0) i++;
+  if (i < TEMP_MAX_SENSORS) {
+    memcpy(resolutions[i].address, address, sizeof(TempAddress));
+    resolutions[i].bits = constrain(bits, 9, 12);
+    if (i == resolutionCount) resolutionCount++;
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+// Вызывается под mux
+uint8_t TempSampler::wantedResolution(const uint8_t *address) const {
+  for (size_t i = 0; i < resolutionCount; i++) {
+    if (memcmp(resolutions[i].address, address, sizeof(TempAddress)) == 0) return resolutions[i].bits;
+  }
+  return TEMP_DEFAULT_RESOLUTION;
+}
+
+int TempSampler::findLocked(const uint8_t *address) const {
+  for (size_t i = 0; i < sensorCount; i++) {
+    if (memcmp(sensors[i].address, address, sizeof(TempAddress)) == 0) return i;
+  }
+  return -1;
+}
+
+// Поиск на всех шинах: новые датчики добавляются в конец списка,
+// вернувшиеся занимают прежний номер, ненайденные помечаются отсутствующими
+void TempSampler::scan(unsigned long now) {
+  bool seen[TEMP_MAX_SENSORS] = {};
+  TempAddress found[TEMP_MAX_SENSORS];
+  bool changed = false;
+
+  for (size_t b = 0; b < busCount; b++) {
+    uint8_t n = buses[b]->search(found, TEMP_MAX_SENSORS);
+    portENTER_CRITICAL(&mux);
+    for (uint8_t f = 0; f < n; f++) {
+      int i = findLocked(found[f]);
+      if (i < 0) {
+        if (sensorCount >= TEMP_MAX_SENSORS) continue;
+        i = sensorCount++;
+        TempSensor &sensor = sensors[i];
+        memcpy(sensor.address, found[f], sizeof(TempAddress));
+        sensor.reading = TempReading{TEMP_DISCONNECTED, 0, false};
+        sensor.present = false;
+      }
+      TempSensor &sensor = sensors[i];
+      seen[i] = true;
+      if (!sensor.present || sensor.bus != b) {
+        sensor.present = true;
+        sensor.bus = b;
+        sensor.resolution = 0;
+        sensor.misses = 0;
+        changed = true;
+      }
+    }
+    portEXIT_CRITICAL(&mux);
+  }
+
+  portENTER_CRITICAL(&mux);
+  for (size_t i = 0; i < sensorCount; i++) {
+    if (sensors[i].present && !seen[i]) {
+      sensors[i].present = false;
+      sensors[i].reading.valid = false;
+      changed = true;
+    }
+  }
+  if (changed) topologyVersion++;
+  portEXIT_CRITICAL(&mux);
+
+  lastScan = now;
+  scanned = true;
+  rescanRequested = false;
+}
+
+// Запись разрешения в датчики, у которых оно отличается от нужного
+void TempSampler::applyResolutions() {
+  for (size_t i = 0; i < sensorCount; i++) {
+    portENTER_CRITICAL(&mux);
+    TempSensor sensor = sensors[i];
+    uint8_t bits = wantedResolution(sensor.address);
+    portEXIT_CRITICAL(&mux);
+    if (!sensor.present || sensor.resolution == bits) continue;
+    if (buses[sensor.bus]->setResolution(sensor.address, bits)) {
+      portENTER_CRITICAL(&mux);
+      sensors[i].resolution = bits;
+      portEXIT_CRITICAL(&mux);
+    }
+  }
+}
+
+void TempSampler::loop(unsigned long now) {
+  if (!busCount) return;
+
+  switch (state) {
+    case IDLE: {
+      if (now - started < TEMP_SAMPLE_INTERVAL) break;
+      if (!scanned || rescanRequested || now - lastScan >= TEMP_RESCAN_INTERVAL) {
+        scan(now);
+      }
+      applyResolutions();
+
+      // Конверсия только на шинах с датчиками; ждём самый медленный
+      uint8_t busBits[TEMP_MAX_BUSES] = {};
+      for (size_t i = 0; i < sensorCount; i++) {
+        const TempSensor &sensor = sensors[i];
+        uint8_t bits = sensor.resolution ? sensor.resolution : TEMP_DEFAULT_RESOLUTION;
+        if (sensor.present && bits > busBits[sensor.bus]) busBits[sensor.bus] = bits;
+      }
+      conversionTime = 0;
+      for (size_t b = 0; b < busCount; b++) {
+        if (!busBits[b]) continue;
+        buses[b]->requestConversion();
+        conversionTime = max(conversionTime, conversionMillis(busBits[b]));
+      }
+      started = now;
+      state = CONVERTING;
+      break;
+    }
+
+    case CONVERTING:
+      if (now - started < conversionTime) break;
+      for (size_t i = 0; i < sensorCount; i++) {
+        portENTER_CRITICAL(&mux);
+        TempSensor sensor = sensors[i];
+        portEXIT_CRITICAL(&mux);
+        if (!sensor.present) continue;
+        float value = buses[sensor.bus]->read(sensor.address);
+        portENTER_CRITICAL(&mux);
+        TempSensor &slot = sensors[i];
+        if (value != TEMP_DISCONNECTED) {
+          slot.reading = TempReading{value, now, true};
+          slot.misses = 0;
+        } else {
+          slot.reading.valid = false;
+          // Пропавший датчик замечается без ожидания повторного поиска
+          if (++slot.misses >= TEMP_MISS_LIMIT) {
+            slot.present = false;
+            topologyVersion++;
+          }
+        }
+        portEXIT_CRITICAL(&mux);
+      }
+      sampleCount++;
+      state = IDLE;
+      break;
+  }
+}
+
+size_t TempSampler::count() const {
+  portENTER_CRITICAL(&mux);
+  size_t n = sensorCount;
+  portEXIT_CRITICAL(&mux);
+  return n;
+}
+
+bool TempSampler::sensor(size_t index, TempSensor &out) const {
+  portENTER_CRITICAL(&mux);
+  bool ok = index < sensorCount;
+  if (ok) out = sensors[index];
+  portEXIT_CRITICAL(&mux);
+  return ok;
+}
+
+int TempSampler::find(const uint8_t *address) const {
+  portENTER_CRITICAL(&mux);
+  int i = findLocked(address);
+  portEXIT_CRITICAL(&mux);
+  return i;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+#include "hal.h"
+
+// Максимальное число датчиков и шин 1-Wire
+#define TEMP_MAX_SENSORS 16
+#define TEMP_MAX_BUSES 4
+// Период опроса датчиков, мс
+#define TEMP_SAMPLE_INTERVAL 1000
+// Период повторного поиска датчиков на шинах, мс
+#define TEMP_RESCAN_INTERVAL 30000
+// Неудачных чтений подряд, после которых датчик считается пропавшим
+#define TEMP_MISS_LIMIT 3
+// Разрешение датчика без настроек, бит
+#define TEMP_DEFAULT_RESOLUTION 12
+
+// Последнее показание датчика
+struct TempReading {
+  float value;
+  unsigned long timestamp;  // millis() момента чтения
+  bool valid;
+};
+
+// Датчик, найденный на одной из шин
+struct TempSensor {
+  TempAddress address;
+  uint8_t bus;
+  uint8_t resolution;  // 0 - ещё не установлено
+  uint8_t misses;
+  bool present;
+  TempReading reading;
+};
+
+// Фоновый опрос DS18B20 на нескольких шинах. Датчики находятся поиском
+// при старте и затем раз в TEMP_RESCAN_INTERVAL, а читаются напрямую по
+// ROM-адресу. Конверсия запускается на всех шинах сразу без ожидания,
+// время ожидания определяется самым точным датчиком.
+// Номер датчика (индекс) не меняется, пока список не сброшен clear().
+class TempSampler {
+public:
+  TempSampler();
+
+  // Сброс шин и найденных датчиков
+  void clear();
+  bool addBus(TempBus *bus);
+  // Разрешения датчиков по адресу; применяются перед следующей конверсией,
+  // для ещё не найденных - при появлении
+  void clearResolutions();
+  void setResolution(const uint8_t *address, uint8_t bits);
+  // Внеочередной поиск датчиков
+  void rescan() { rescanRequested = true; }
+
+  // Вызывается из задачи опроса, никогда не блокирует на время конверсии
+  void loop(unsigned long now);
+
+  size_t count() const;
+  bool sensor(size_t index, TempSensor &out) const;
+  int find(const uint8_t *address) const;
+  // Количество завершённых циклов опроса
+  uint32_t samples() const { return sampleCount; }
+  // Меняется при появлении или пропаже датчика
+  uint32_t topology() const { return topologyVersion; }
+
+private:
+  enum State { IDLE, CONVERTING };
+
+  struct Resolution {
+    TempAddress address;
+    uint8_t bits;
+  };
+
+  void scan(unsigned long now);
+  void applyResolutions();
+  uint8_t wantedResolution(const uint8_t *address) const;
+  int findLocked(const uint8_t *address) const;
+
+  TempBus *buses[TEMP_MAX_BUSES];
+  size_t busCount;
+  TempSensor sensors[TEMP_MAX_SENSORS];
+  size_t sensorCount;
+  Resolution resolutions[TEMP_MAX_SENSORS];
+  size_t resolutionCount;
+  State state;
+  unsigned long started;
+  unsigned long conversionTime;
+  unsigned long lastScan;
+  bool scanned;
+  volatile bool rescanRequested;
+  volatile uint32_t sampleCount;
+  volatile uint32_t topologyVersion;
+  mutable portMUX_TYPE mux;
+};
+
+extern TempSampler tempSampler;
@@ -0,0 +1,124 @@
+#include "topic_index.h"
+#include <algorithm>
+
+TopicIndex topicIndex;
+
+// FNV-1a
+uint32_t TopicIndex::hash(const char *s) {
+  uint32_t h = 2166136261u;
+  while (*s) {
+    h ^= (uint8_t)*s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void TopicIndex::build(const ButtonList &buttons) {
+  source = &buttons;
+  entries.clear();
+  for (size_t i = 0; i < buttons.size(); i++) {
+    const ButtonConfig &button = buttons[i];
+    if (button.mode != OUTPUT || button.topic.isEmpty()) continue;
+    entries.push_back(Entry{hash(button.topic.c_str()), (uint8_t)i});
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+    return a.hash != b.hash ? a.hash < b.hash : a.button < b.button;
+  });
+}
+
+size_t TopicIndex::match(const char *topic, uint8_t *out, size_t max) const {
+  if (!source) return 0;
+  uint32_t h = hash(topic);
+  auto it = std::lower_bound(entries.begin(), entries.end(), h, [](const Entry &e, uint32_t value) {
+    return e.hash < value;
+  });
+  size_t n = 0;
+  for (; it != entries.end() && it->hash == h && n < max; ++it) {
+    if (strcmp((*source)[it->button].topic.c_str(), topic) == 0) {
+      out[n++] = it->button;
+    }
+  }
+  return n;
+}
+
+static const uint8_t *skipSpaces(const uint8_t *p, const uint8_t *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+  return p;
+}
+
+static bool equalsWord(const uint8_t *p, const uint8_t *end, const char *word) {
+  size_t len = strlen(word);
+  if ((size_t)(end - p) != len) return false;
+  return strncasecmp((const char *)p, word, len) == 0;
+}
+
+// Число в десятичной записи; false, если встречено что-то кроме цифр
+static bool parseNumber(const uint8_t *p, const uint8_t *end, unsigned long &value) {
+  if (p == end) return false;
+  unsigned long v = 0;
+  for (; p < end; p++) {
+    if (*p < '0' || *p > '9') return false;
+    if (v < 10UL * MQTT_PULSE_MAX) v = v * 10 + (*p - '0');
+  }
+  value = v;
+  return true;
+}
+
+// Ищет значение ключа "key" в плоском JSON-объекте; [vbegin, vend) без кавычек
+static bool findJsonValue(const uint8_t *p, const uint8_t *end, const char *key,
+                          const uint8_t *&vbegin, const uint8_t *&vend) {
+  size_t keyLen = strlen(key);
+  for (; p + keyLen + 2 <= end; p++) {
+    if (*p != '"' || p[keyLen + 1] != '"' || strncmp((const char *)p + 1, key, keyLen) != 0) continue;
+    const uint8_t *v = skipSpaces(p + keyLen + 2, end);
+    if (v == end || *v != ':') continue;
+    v = skipSpaces(v + 1, end);
+    if (v < end && *v == '"') {
+      const uint8_t *q = ++v;
+      while (q < end && *q != '"') q++;
+      if (q == end) return false;
+      vbegin = v;
+      vend = q;
+    } else {
+      const uint8_t *q = v;
+      while (q < end && *q != ',' && *q != '}' && *q != ' ') q++;
+      vbegin = v;
+      vend = q;
+    }
+    return true;
+  }
+  return false;
+}
+
+MqttCommand parseCommand(const uint8_t *payload, unsigned int length, unsigned long defaultDuration) {
+  MqttCommand cmd = {MqttCommand::PULSE, defaultDuration};
+  const uint8_t *end = payload + length;
+  const uint8_t *p = skipSpaces(payload, end);
+  while (end > p && (end[-1] == ' ' || end[-1] == '\r' || end[-1] == '\n')) end--;
+
+  unsigned long value;
+  if (p < end && *p == '{') {
+    const uint8_t *vb, *ve;
+    if (findJsonValue(p, end, "action", vb, ve) && equalsWord(vb, ve, "off")) {
+      cmd.action = MqttCommand::CANCEL;
+    }
+    if (findJsonValue(p, end, "duration", vb, ve) && parseNumber(vb, ve, value)) {
+      cmd.duration = value;
+    }
+  } else if (equalsWord(p, end, "off")) {
+    cmd.action = MqttCommand::CANCEL;
+  } else if (parseNumber(p, end, value)) {
+    cmd.duration = value;
+  }
+
+  if (cmd.duration > MQTT_PULSE_MAX) cmd.duration = MQTT_PULSE_MAX;
+  return cmd;
+}
+
+bool parseDuration(const char *text, unsigned long &duration) {
+  const uint8_t *p = (const uint8_t *)text;
+  unsigned long value;
+  if (!parseNumber(p, p + strlen(text), value) || value == 0) return false;
+  duration = value > MQTT_PULSE_MAX ? MQTT_PULSE_MAX : value;
+  return true;
+}
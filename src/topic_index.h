@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// Максимальное число кнопок, совпадающих с одним топиком
+#define TOPIC_MATCH_MAX 8
+// Предельная длительность импульса из MQTT, мс
+#define MQTT_PULSE_MAX 60000
+
+// Индекс топик -> кнопки, строится один раз при загрузке конфигурации.
+// Поиск идёт по отсортированной таблице хэшей и не выделяет память.
+class TopicIndex {
+public:
+  void build(const ButtonList &buttons);
+  // Заполняет out индексами кнопок с данным топиком, возвращает их число
+  size_t match(const char *topic, uint8_t *out, size_t max) const;
+  size_t size() const { return entries.size(); }
+
+  static uint32_t hash(const char *s);
+
+private:
+  struct Entry {
+    uint32_t hash;
+    uint8_t button;
+  };
+
+  FixedList<Entry, CONFIG_MAX_BUTTONS> entries;
+  const ButtonList *source = nullptr;
+};
+
+// Команда, разобранная из payload MQTT-сообщения
+struct MqttCommand {
+  enum Action { PULSE, CANCEL };
+  Action action;
+  unsigned long duration;
+};
+
+// Разбор payload на месте: "ON", "OFF", число миллисекунд или JSON вида
+// {"action":"on","duration":500}. Прочее трактуется как нажатие с
+// длительностью по умолчанию.
+MqttCommand parseCommand(const uint8_t *payload, unsigned int length, unsigned long defaultDuration);
+
+// Длительность импульса из текста запроса (/trigger): только цифры и
+// больше нуля, значения больше MQTT_PULSE_MAX урезаются, как в parseCommand()
+bool parseDuration(const char *text, unsigned long &duration);
+
+extern TopicIndex topicIndex;
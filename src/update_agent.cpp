@@ -0,0 +1,126 @@
+#include "update_agent.h"
+#include <ArduinoJson.h>
+#include <time.h>
+#include "config.h"
+#include "hal.h"
+#include "ota_job.h"
+#include "version.h"
+
+UpdateAgent updateAgent;
+
+UpdateAgent::UpdateAgent()
+  : lastResult(NONE), running(false), forced(false), lastCheck(0), nextCheck(0) {
+  latest[0] = 0;
+}
+
+const char *UpdateAgent::resultName(Result result) {
+  switch (result) {
+    case NONE: return "none";
+    case NOT_MODIFIED: return "not_modified";
+    case UP_TO_DATE: return "up_to_date";
+    case UPDATE_STARTED: return "update_started";
+    case OUTSIDE_WINDOW: return "outside_window";
+    case FAILED: return "failed";
+  }
+  return "unknown";
+}
+
+// Следующая проверка через интервал плюс случайный разброс, чтобы
+// устройства не обращались к серверу одновременно
+void UpdateAgent::schedule(unsigned long now) {
+  unsigned long jitter = config.update_jitter * 60000UL;
+  nextCheck = now + config.update_interval * 60000UL + (jitter ? esp_random() % jitter : 0);
+}
+
+void UpdateAgent::begin(unsigned long now) {
+  unsigned long jitter = config.update_jitter * 60000UL;
+  nextCheck = now + 60000UL + (jitter ? esp_random() % jitter : 0);
+}
+
+unsigned long UpdateAgent::nextCheckIn(unsigned long now) const {
+  long left = (long)(nextCheck - now);
+  return left > 0 ? left : 0;
+}
+
+bool UpdateAgent::inWindow() const {
+  uint8_t start = config.update_window_start;
+  uint8_t end = config.update_window_end;
+  if (start == end) return true;
+  time_t now = hal::utcTime();
+  if (now < 1600000000) return false; // время ещё не синхронизировано
+  struct tm utc;
+  gmtime_r(&now, &utc);
+  if (start < end) return utc.tm_hour >= start && utc.tm_hour < end;
+  return utc.tm_hour >= start || utc.tm_hour < end;
+}
+
+void UpdateAgent::loop(unsigned long now) {
+  if (running || config.update_url.isEmpty()) return;
+  if (!forced && (config.update_interval == 0 || (long)(now - nextCheck) < 0)) return;
+
+  if (!hal::networkUp() || otaJob.busy()) {
+    nextCheck = now + UPDATE_RETRY_DELAY;
+    return;
+  }
+  if (!forced && !inWindow()) {
+    lastResult = OUTSIDE_WINDOW;
+    nextCheck = now + UPDATE_RETRY_DELAY;
+    return;
+  }
+
+  forced = false;
+  lastCheck = now;
+  schedule(now);
+  manifestUrl = config.update_url.c_str();
+  running = true;
+  if (xTaskCreate(taskEntry, "update-check", 6144, this, 1, nullptr) != pdPASS) {
+    running = false;
+    lastResult = FAILED;
+  }
+}
+
+void UpdateAgent::taskEntry(void *arg) {
+  UpdateAgent *agent = static_cast<UpdateAgent *>(arg);
+  agent->check();
+  agent->running = false;
+  vTaskDelete(nullptr);
+}
+
+void UpdateAgent::check() {
+  std::string newTag, body;
+  int code = hal::httpGet(manifestUrl.c_str(), etag.c_str(), UPDATE_HTTP_TIMEOUT, newTag, body);
+  if (code == 304) {
+    lastResult = NOT_MODIFIED;
+    return;
+  }
+  if (code != 200) {
+    Serial.printf("Update manifest request failed, HTTP %d\n", code);
+    lastResult = FAILED;
+    return;
+  }
+
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, body.data(), body.size());
+  if (error || !doc["version"].is<const char *>() || !doc["url"].is<const char *>()) {
+    Serial.println("Invalid update manifest");
+    lastResult = FAILED;
+    return;
+  }
+
+  const char *version = doc["version"];
+  strlcpy(latest, version, sizeof(latest));
+  if (compareVersions(version, FIRMWARE_VERSION) <= 0) {
+    // ETag запоминается только когда обновлять нечего, иначе после неудачной
+    // установки следующая проверка получила бы 304
+    etag = newTag.c_str();
+    lastResult = UP_TO_DATE;
+    return;
+  }
+
+  Serial.printf("Update %s available (running %s)\n", version, FIRMWARE_VERSION);
+  if (otaJob.start(doc["url"].as<String>(), doc["sha256"] | "") == OtaJob::STARTED) {
+    lastResult = UPDATE_STARTED;
+  } else {
+    lastResult = FAILED;
+  }
+}
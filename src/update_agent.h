@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Повторная проверка, если окно обслуживания закрыто или нет сети, мс
+#define UPDATE_RETRY_DELAY 300000UL
+// Таймаут запроса манифеста, мс
+#define UPDATE_HTTP_TIMEOUT 5000
+
+// Периодическая проверка манифеста обновлений. Запрос идёт с If-None-Match,
+// так что обычный ответ "обновлений нет" - это 304 без тела. Если в манифесте
+// версия новее зашитой в прошивку, запускается OtaJob.
+// Манифест: {"version":"1.2.3","url":"http://.../firmware.bin.gz","sha256":"..."}
+class UpdateAgent {
+public:
+  enum Result { NONE, NOT_MODIFIED, UP_TO_DATE, UPDATE_STARTED, OUTSIDE_WINDOW, FAILED };
+
+  UpdateAgent();
+
+  void begin(unsigned long now);
+  void loop(unsigned long now);
+  // Внеочередная проверка без учёта окна обслуживания
+  void checkNow() { forced = true; }
+
+  Result result() const { return lastResult; }
+  static const char *resultName(Result result);
+  const char *latestVersion() const { return latest; }
+  unsigned long lastCheckAt() const { return lastCheck; }
+  unsigned long nextCheckIn(unsigned long now) const;
+  bool checking() const { return running; }
+
+private:
+  static void taskEntry(void *arg);
+  void check();
+  bool inWindow() const;
+  void schedule(unsigned long now);
+
+  String manifestUrl;
+  String etag;
+  char latest[24];
+  volatile Result lastResult;
+  volatile bool running;
+  volatile bool forced;
+  unsigned long lastCheck;
+  unsigned long nextCheck;
+};
+
+extern UpdateAgent updateAgent;
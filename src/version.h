@@ -0,0 +1,24 @@
+#pragma once
+
+// Версия прошивки, подставляется shared/get_version.py через BUILD_VERSION
+#ifndef BUILD_VERSION
+  #define BUILD_VERSION 0.0.1
+#endif
+
+#define VERSION_STRINGIFY(x) #x
+#define VERSION_TOSTRING(x) VERSION_STRINGIFY(x)
+#define FIRMWARE_VERSION VERSION_TOSTRING(BUILD_VERSION)
+
+// Сравнение версий вида "1.2.3" по числовым компонентам: <0, 0, >0.
+// Нецифровые символы ("v", ".", "-rc") служат разделителями.
+inline int compareVersions(const char *a, const char *b) {
+  while (*a || *b) {
+    while (*a && (*a < '0' || *a > '9')) a++;
+    while (*b && (*b < '0' || *b > '9')) b++;
+    unsigned long partA = 0, partB = 0;
+    while (*a >= '0' && *a <= '9') partA = partA * 10 + (*a++ - '0');
+    while (*b >= '0' && *b <= '9') partB = partB * 10 + (*b++ - '0');
+    if (partA != partB) return partA < partB ? -1 : 1;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "wifi_cache.h"
+#include <vector>
+#include "hal.h"
+
+static const char *cacheFile = "/wifi.cache";
+static const uint32_t CACHE_MAGIC = 0x31434657; // "WFC1"
+
+struct CacheRecord {
+  uint32_t magic;
+  uint32_t ssidHash;
+  WifiCache cache;
+};
+
+// FNV-1a
+static uint32_t ssidHash(const char *ssid) {
+  uint32_t h = 2166136261u;
+  while (*ssid) {
+    h ^= (uint8_t)*ssid++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool loadWifiCache(const char *ssid, WifiCache &cache) {
+  std::vector<uint8_t> data;
+  if (!hal::fileRead(cacheFile, data) || data.size() != sizeof(CacheRecord)) return false;
+  CacheRecord record;
+  memcpy(&record, data.data(), sizeof(record));
+  if (record.magic != CACHE_MAGIC || record.ssidHash != ssidHash(ssid) || !record.cache.channel) return false;
+  cache = record.cache;
+  return true;
+}
+
+bool saveWifiCache(const char *ssid, const WifiCache &cache) {
+  WifiCache current;
+  if (loadWifiCache(ssid, current) && current.channel == cache.channel &&
+      memcmp(current.bssid, cache.bssid, sizeof(cache.bssid)) == 0) {
+    return true;
+  }
+  CacheRecord record = {};
+  record.magic = CACHE_MAGIC;
+  record.ssidHash = ssidHash(ssid);
+  record.cache = cache;
+  return hal::fileWrite(cacheFile, (const uint8_t *)&record, sizeof(record));
+}
+
+void clearWifiCache() {
+  if (hal::fileExists(cacheFile)) hal::fileRemove(cacheFile);
+}
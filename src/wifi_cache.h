@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Точка доступа последнего успешного подключения. С ней следующая
+// загрузка подключается без сканирования каналов.
+struct WifiCache {
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+// Запись для данного SSID; false, если её нет или она от другой сети
+bool loadWifiCache(const char *ssid, WifiCache &cache);
+// Файл переписывается, только если точка доступа сменилась
+bool saveWifiCache(const char *ssid, const WifiCache &cache);
+void clearWifiCache();
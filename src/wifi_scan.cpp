@@ -0,0 +1,107 @@
+#include "wifi_scan.h"
+#include <WiFi.h>
+
+WifiScanner wifiScanner;
+
+WifiScanner::WifiScanner()
+  : count(0), completedAt(0), ttl(60000), pending(false), inFlight(false), scanCount(0),
+    mux(portMUX_INITIALIZER_UNLOCKED) {
+}
+
+// Запрос во время сканирования дожидается его результатов, а не
+// заказывает следующее: кэш устарел, пока сканирование не закончится
+bool WifiScanner::request(unsigned long now) {
+  portENTER_CRITICAL(&mux);
+  bool fresh = completedAt && now - completedAt < ttl;
+  if (!fresh && !inFlight) pending = true;
+  portEXIT_CRITICAL(&mux);
+  return fresh;
+}
+
+void WifiScanner::loop(unsigned long now) {
+  if (inFlight) {
+    int16_t result = WiFi.scanComplete();
+    if (result == WIFI_SCAN_RUNNING) return;
+    if (result >= 0) {
+      collect(result, now);
+    } else {
+      Serial.println("WiFi scan failed");
+    }
+    WiFi.scanDelete();
+    portENTER_CRITICAL(&mux);
+    inFlight = false;
+    pending = false;
+    portEXIT_CRITICAL(&mux);
+    return;
+  }
+  // Флаги меняются вместе, чтобы request() между ними не заказал
+  // второе сканирование
+  portENTER_CRITICAL(&mux);
+  bool start = pending;
+  pending = false;
+  if (start) inFlight = true;
+  portEXIT_CRITICAL(&mux);
+  if (!start) return;
+  if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED) {
+    Serial.println("WiFi scan failed to start");
+    portENTER_CRITICAL(&mux);
+    inFlight = false;
+    portEXIT_CRITICAL(&mux);
+    return;
+  }
+  scanCount++;
+}
+
+// Результаты драйвера сводятся по SSID и сортируются вставкой
+void WifiScanner::collect(int found, unsigned long now) {
+  ScanNetwork sorted[SCAN_MAX_NETWORKS];
+  size_t n = 0;
+  for (int i = 0; i < found; i++) {
+    String ssid = WiFi.SSID(i);
+    if (ssid.isEmpty()) continue;
+    int8_t rssi = WiFi.RSSI(i);
+    size_t j = 0;
+    while (j < n && sorted[j].ssid != ssid.c_str()) j++;
+    if (j < n) {
+      if (sorted[j].rssi >= rssi) continue;
+      for (; j + 1 < n; j++) sorted[j] = sorted[j + 1];
+      n--;
+    }
+    size_t pos = 0;
+    while (pos < n && sorted[pos].rssi >= rssi) pos++;
+    if (pos >= SCAN_MAX_NETWORKS) continue;
+    if (n == SCAN_MAX_NETWORKS) n--;
+    for (size_t k = n; k > pos; k--) sorted[k] = sorted[k - 1];
+    sorted[pos].ssid = ssid;
+    sorted[pos].rssi = rssi;
+    sorted[pos].channel = WiFi.channel(i);
+    sorted[pos].auth = WiFi.encryptionType(i);
+    n++;
+  }
+  portENTER_CRITICAL(&mux);
+  for (size_t i = 0; i < n; i++) networks[i] = sorted[i];
+  count = n;
+  completedAt = now ? now : 1;
+  portEXIT_CRITICAL(&mux);
+}
+
+size_t WifiScanner::snapshot(ScanNetwork *out, size_t max) const {
+  portENTER_CRITICAL(&mux);
+  size_t n = count < max ? count : max;
+  for (size_t i = 0; i < n; i++) out[i] = networks[i];
+  portEXIT_CRITICAL(&mux);
+  return n;
+}
+
+const char *WifiScanner::authName(uint8_t auth) {
+  switch (auth) {
+    case WIFI_AUTH_OPEN: return "open";
+    case WIFI_AUTH_WEP: return "wep";
+    case WIFI_AUTH_WPA_PSK: return "wpa";
+    case WIFI_AUTH_WPA2_PSK: return "wpa2";
+    case WIFI_AUTH_WPA_WPA2_PSK: return "wpa/wpa2";
+    case WIFI_AUTH_WPA2_ENTERPRISE: return "wpa2-enterprise";
+    case WIFI_AUTH_WPA3_PSK: return "wpa3";
+  }
+  return "other";
+}
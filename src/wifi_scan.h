@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include "fixed_string.h"
+
+// Максимум сетей в кэше результатов
+#define SCAN_MAX_NETWORKS 20
+
+struct ScanNetwork {
+  FixedString<32> ssid;
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t auth;  // wifi_auth_mode_t
+};
+
+// Кэш асинхронного сканирования Wi-Fi. Одновременно идёт не больше
+// одного сканирования; результаты без повторов SSID (остаётся самая
+// сильная точка), по убыванию RSSI, живут ttl секунд. request() можно
+// вызывать из любой задачи, само сканирование запускает и собирает
+// loop() сетевой задачи; запросы во время сканирования получают его
+// результаты.
+class WifiScanner {
+public:
+  WifiScanner();
+
+  void setTtl(uint16_t seconds) { ttl = seconds * 1000UL; }
+
+  // Запросить свежие результаты; true, если кэш ещё действителен
+  bool request(unsigned long now);
+  void loop(unsigned long now);
+
+  bool scanning() const { return inFlight || pending; }
+  bool hasResults() const { return completedAt != 0; }
+  unsigned long age(unsigned long now) const { return completedAt ? now - completedAt : 0; }
+  // Копия результатов в out, возвращает их число
+  size_t snapshot(ScanNetwork *out, size_t max) const;
+  uint32_t scans() const { return scanCount; }
+
+  static const char *authName(uint8_t auth);
+
+private:
+  void collect(int count, unsigned long now);
+
+  ScanNetwork networks[SCAN_MAX_NETWORKS];
+  size_t count;
+  unsigned long completedAt;
+  unsigned long ttl;
+  volatile bool pending;
+  volatile bool inFlight;
+  uint32_t scanCount;
+  mutable portMUX_TYPE mux;
+};
+
+extern WifiScanner wifiScanner;
@@ -0,0 +1,208 @@
+#pragma once
+
+// Замена ядра Arduino-ESP32 для сборки [env:native]: ровно то, чем
+// пользуются модули прошивки, - String, Print/Serial, константы GPIO,
+// спинлоки и задачи FreeRTOS поверх std::thread. Реализация - hal_host.cpp.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <ctype.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define HEX 16
+#define DEC 10
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// В glibc strlcpy появилась только в 2.38
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+uint32_t esp_random();
+
+class String {
+public:
+  String() {}
+  String(const char *s) : text(s ? s : "") {}
+  String(const std::string &s) : text(s) {}
+  String(char c) : text(1, c) {}
+  String(int value, unsigned char base = DEC) : text(number((long)value, base)) {}
+  String(unsigned int value, unsigned char base = DEC) : text(number((unsigned long)value, base)) {}
+  String(long value, unsigned char base = DEC) : text(number(value, base)) {}
+  String(unsigned long value, unsigned char base = DEC) : text(number(value, base)) {}
+  String(float value, unsigned int decimals = 2);
+  String(double value, unsigned int decimals = 2);
+
+  const char *c_str() const { return text.c_str(); }
+  unsigned int length() const { return text.length(); }
+  bool isEmpty() const { return text.empty(); }
+  char operator[](unsigned int i) const { return i < text.length() ? text[i] : 0; }
+  int indexOf(char c, unsigned int from = 0) const;
+  String substring(unsigned int from, unsigned int to) const;
+  void trim();
+  long toInt() const { return strtol(text.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(text.c_str(), nullptr); }
+  bool concat(const char *s) {
+    text += s;
+    return true;
+  }
+
+  String &operator+=(const String &s) {
+    text += s.text;
+    return *this;
+  }
+  String &operator+=(const char *s) {
+    text += s;
+    return *this;
+  }
+  String &operator+=(char c) {
+    text += c;
+    return *this;
+  }
+  friend String operator+(const String &a, const String &b) { return String(a.text + b.text); }
+  friend String operator+(const String &a, const char *b) { return String(a.text + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.text); }
+  bool operator==(const String &s) const { return text == s.text; }
+  bool operator==(const char *s) const { return text == s; }
+  bool operator!=(const String &s) const { return text != s.text; }
+  bool operator!=(const char *s) const { return text != s; }
+
+private:
+  static std::string number(long value, unsigned char base);
+  static std::string number(unsigned long value, unsigned char base);
+
+  std::string text;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*data++);
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(int value) { return printf("%d", value); }
+  size_t print(unsigned int value) { return printf("%u", value); }
+  size_t print(long value) { return printf("%ld", value); }
+  size_t print(unsigned long value) { return printf("%lu", value); }
+  size_t println() { return write("\n"); }
+  template <typename T>
+  size_t println(T value) {
+    return print(value) + println();
+  }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// Вывод Serial уходит в stderr, stdout остаётся для результатов тестов
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint64_t getEfuseMac() { return 0x0000a1b2c3d4e5f6ULL; }
+  // На хосте только отмечается, см. host::restarts()
+  void restart();
+};
+
+extern EspClass ESP;
+
+// Спинлок portMUX: на хосте - атомарный флаг
+struct portMUX_TYPE {
+  std::atomic_flag flag = ATOMIC_FLAG_INIT;
+
+  void lock() {
+    while (flag.test_and_set(std::memory_order_acquire)) {
+    }
+  }
+  void unlock() { flag.clear(std::memory_order_release); }
+};
+
+#define portMUX_INITIALIZER_UNLOCKED portMUX_TYPE()
+#define portENTER_CRITICAL(mux) (mux)->lock()
+#define portEXIT_CRITICAL(mux) (mux)->unlock()
+#define portENTER_CRITICAL_ISR(mux) (mux)->lock()
+#define portEXIT_CRITICAL_ISR(mux) (mux)->unlock()
+
+// Задачи FreeRTOS: поток на задачу, уведомления - счётчик под мьютексом.
+// Тики равны миллисекундам.
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+typedef struct HostTask *TaskHandle_t;
+
+#define pdPASS 1
+#define pdFAIL 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle);
+// Задача завершается возвратом из своей функции
+void vTaskDelete(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t handle);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle);
+
+// Мьютекс FreeRTOS (xSemaphoreCreateMutex) - std::timed_mutex
+typedef struct HostSemaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include <vector>
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTPC_ERROR_CONNECTION_REFUSED -1
+#define HTTPC_ERROR_READ_TIMEOUT -11
+
+// Подмножество HTTPClient из Arduino-ESP32: GET по http:// с заголовками
+// запроса, сбором заголовков ответа и чтением тела из сокета
+class HTTPClient {
+public:
+  HTTPClient() : client(nullptr), timeout(5000), size(-1) {}
+
+  bool begin(WiFiClient &client, const String &url);
+  void setTimeout(uint16_t ms) { timeout = ms; }
+  void collectHeaders(const char *names[], size_t count);
+  void addHeader(const String &name, const String &value);
+  int GET();
+  int getSize() const { return size; }
+  String header(const char *name) const;
+  String getString();
+  WiFiClient *getStreamPtr() { return client; }
+  bool connected() { return client && client->connected(); }
+  void end();
+
+private:
+  bool readLine(std::string &line);
+
+  WiFiClient *client;
+  std::string host;
+  uint16_t port;
+  std::string path;
+  std::string requestHeaders;
+  std::vector<std::string> wanted;
+  std::vector<std::pair<std::string, std::string>> received;
+  uint16_t timeout;
+  int size;
+};
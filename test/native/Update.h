@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+// Раздел OTA на хосте - буфер в памяти; после end() образ доступен
+// через image() до следующего begin()
+class UpdateClass {
+public:
+  bool begin(size_t size);
+  size_t write(uint8_t *data, size_t len);
+  bool end(bool evenIfRemaining = false);
+  void abort();
+  bool isRunning() const { return running; }
+  bool hasError() const { return error != nullptr; }
+  const char *errorString() const { return error ? error : "No Error"; }
+  void printError(Print &out) const { out.println(errorString()); }
+
+  const std::vector<uint8_t> &image() const { return data; }
+  bool finished() const { return done; }
+
+private:
+  std::vector<uint8_t> data;
+  size_t expected = 0;
+  bool running = false;
+  bool done = false;
+  const char *error = nullptr;
+};
+
+extern UpdateClass Update;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+  WIFI_AUTH_WPA_WPA2_PSK,
+  WIFI_AUTH_WPA2_ENTERPRISE,
+  WIFI_AUTH_WPA3_PSK
+} wifi_auth_mode_t;
+
+// Клиент TCP поверх сокетов POSIX; available() и connected() не блокируют
+class WiFiClient {
+public:
+  WiFiClient() : fd(-1) {}
+  ~WiFiClient() { stop(); }
+  WiFiClient(const WiFiClient &) = delete;
+  WiFiClient &operator=(const WiFiClient &) = delete;
+
+  int connect(const char *host, uint16_t port, int32_t timeoutMs = 3000);
+  size_t write(const uint8_t *data, size_t len);
+  int available();
+  int read();
+  size_t readBytes(uint8_t *buffer, size_t len);
+  uint8_t connected();
+  void stop();
+
+private:
+  int fd;
+};
+
+// Сеть на хосте всегда "подключена". Асинхронное сканирование
+// завершает тест через host::finishScan() (hal_host.h)
+class WiFiClass {
+public:
+  wl_status_t status() { return WL_CONNECTED; }
+  int8_t RSSI() { return -50; }
+
+  int16_t scanNetworks(bool async = false);
+  int16_t scanComplete();
+  void scanDelete();
+  String SSID(uint8_t i);
+  int32_t RSSI(uint8_t i);
+  uint8_t channel(uint8_t i);
+  wifi_auth_mode_t encryptionType(uint8_t i);
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+// Распаковщик tinfl из ROM ESP32 поверх raw inflate zlib. Как и в ROM,
+// вывод пишется в кольцевой словарь по смещению; собственное окно
+// zlib живёт во встроенном буфере, так что состояние освобождается
+// простым free(), как в GzipStream::end().
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+  z_stream stream;
+  bool started;
+  size_t arenaUsed;
+  alignas(16) uint8_t arena[64 * 1024];
+} tinfl_decompressor;
+
+void tinfl_init(tinfl_decompressor *r);
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in, size_t *inSize, uint8_t *outStart,
+                              uint8_t *outNext, size_t *outSize, uint32_t flags);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3), как crc32_le в ROM ESP32
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
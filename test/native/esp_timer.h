@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Периодический таймер esp_timer; на хосте - поток со sleep_for
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef struct HostTimer *esp_timer_handle_t;
+
+typedef struct {
+  void (*callback)(void *arg);
+  void *arg;
+  int dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
@@ -0,0 +1,11 @@
+#include "config.h"
+#include "hal_host.h"
+#include "handlers.h"
+
+// Глобальные объекты, которые в прошивке определены в main.cpp. Сам
+// main.cpp на хосте не собирается: ему нужны веб-сервер, WiFiManager
+// и PubSubClient. MQTT идёт через брокер в памяти.
+Config config;
+HostTransport hostTransport;
+MqttTransport &mqttTransport = hostTransport;
+MqttConnection mqtt(hostTransport);
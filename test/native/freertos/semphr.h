@@ -0,0 +1,4 @@
+#pragma once
+
+// Мьютексы объявлены в Arduino.h, как в ядре Arduino-ESP32
+#include <Arduino.h>
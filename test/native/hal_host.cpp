@@ -0,0 +1,554 @@
+#include "hal_host.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#define HOST_MAX_PINS 64
+
+// Часы
+
+static const std::chrono::steady_clock::time_point startedAt = std::chrono::steady_clock::now();
+static std::atomic<bool> manualClock(false);
+static std::atomic<uint64_t> manualMicros(0);
+
+static uint64_t nowMicros() {
+  if (manualClock.load()) return manualMicros.load();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startedAt).count();
+}
+
+unsigned long millis() {
+  return nowMicros() / 1000;
+}
+
+unsigned long micros() {
+  return (unsigned long)nowMicros();
+}
+
+// В ручном режиме пауза только сдвигает часы и уступает процессор
+void delay(unsigned long ms) {
+  if (manualClock.load()) {
+    manualMicros += (uint64_t)ms * 1000;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+namespace host {
+
+void setMillis(unsigned long ms) {
+  manualMicros = (uint64_t)ms * 1000;
+  manualClock = true;
+}
+
+void advanceMillis(unsigned long ms) {
+  manualMicros += (uint64_t)ms * 1000;
+}
+
+void useRealClock() {
+  manualClock = false;
+}
+
+}
+
+// Случайные числа
+
+static std::atomic<uint32_t> randomState(2463534242u);
+
+uint32_t esp_random() {
+  // xorshift32
+  uint32_t x = randomState.load(), next;
+  do {
+    next = x;
+    next ^= next << 13;
+    next ^= next >> 17;
+    next ^= next << 5;
+  } while (!randomState.compare_exchange_weak(x, next));
+  return next;
+}
+
+// Куча: операторы new/delete считают блоки
+
+static std::atomic<uint32_t> allocationCount(0);
+static std::atomic<uint32_t> freeCount(0);
+
+void *operator new(size_t size) {
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  if (!p) return;
+  freeCount.fetch_add(1, std::memory_order_relaxed);
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  operator delete(p);
+}
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t) {
+  memset(info, 0, sizeof(*info));
+  info->allocated_blocks = host::liveBlocks();
+}
+
+// Размеры кучи на хосте условные, как у ESP32-S2 без PSRAM
+uint32_t EspClass::getFreeHeap() {
+  return 200 * 1024;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return 180 * 1024;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return 100 * 1024;
+}
+
+static std::atomic<uint32_t> restartCount(0);
+
+void EspClass::restart() {
+  restartCount++;
+}
+
+EspClass ESP;
+
+// GPIO
+
+struct HostPin {
+  std::atomic<int> level;
+  std::atomic<int> mode;
+  void (*isr)(void *);
+  void *arg;
+};
+
+static HostPin pins[HOST_MAX_PINS];
+static std::mutex isrLock;
+static std::atomic<host::WriteHook> writeHook(nullptr);
+static std::atomic<uint32_t> modeCalls(0);
+
+static HostPin *pinAt(int pin) {
+  return pin >= 0 && pin < HOST_MAX_PINS ? &pins[pin] : nullptr;
+}
+
+// Файловая система
+
+static std::mutex filesLock;
+static std::map<std::string, std::vector<uint8_t>> files;
+
+namespace hal {
+
+unsigned long millis() {
+  return ::millis();
+}
+
+unsigned long micros() {
+  return ::micros();
+}
+
+void gpioMode(int pin, int mode) {
+  modeCalls++;
+  if (HostPin *p = pinAt(pin)) p->mode = mode;
+}
+
+void gpioWrite(int pin, int level) {
+  HostPin *p = pinAt(pin);
+  if (!p) return;
+  p->level = level;
+  host::WriteHook hook = writeHook.load();
+  if (hook) hook(pin, level, ::micros());
+}
+
+int gpioRead(int pin) {
+  HostPin *p = pinAt(pin);
+  return p ? p->level.load() : LOW;
+}
+
+void gpioAttach(int pin, void (*isr)(void *), void *arg) {
+  HostPin *p = pinAt(pin);
+  if (!p) return;
+  std::lock_guard<std::mutex> guard(isrLock);
+  p->isr = isr;
+  p->arg = arg;
+}
+
+void gpioDetach(int pin) {
+  HostPin *p = pinAt(pin);
+  if (!p) return;
+  std::lock_guard<std::mutex> guard(isrLock);
+  p->isr = nullptr;
+}
+
+bool fileExists(const char *path) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  return files.count(path) > 0;
+}
+
+bool fileRead(const char *path, std::vector<uint8_t> &data) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  auto it = files.find(path);
+  if (it == files.end()) return false;
+  data = it->second;
+  return true;
+}
+
+bool fileWrite(const char *path, const uint8_t *data, size_t len) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  files[path].assign(data, data + len);
+  return true;
+}
+
+bool fileAppend(const char *path, const uint8_t *data, size_t len) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  std::vector<uint8_t> &file = files[path];
+  file.insert(file.end(), data, data + len);
+  return true;
+}
+
+size_t fileReadAt(const char *path, size_t offset, uint8_t *data, size_t len) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  auto it = files.find(path);
+  if (it == files.end() || offset >= it->second.size()) return 0;
+  size_t n = std::min(len, it->second.size() - offset);
+  memcpy(data, it->second.data() + offset, n);
+  return n;
+}
+
+size_t fileSize(const char *path) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  auto it = files.find(path);
+  return it == files.end() ? 0 : it->second.size();
+}
+
+bool fileRemove(const char *path) {
+  std::lock_guard<std::mutex> guard(filesLock);
+  return files.erase(path) > 0;
+}
+
+}
+
+namespace host {
+
+int pinLevel(int pin) {
+  return hal::gpioRead(pin);
+}
+
+int pinMode(int pin) {
+  HostPin *p = pinAt(pin);
+  return p ? p->mode.load() : 0;
+}
+
+uint32_t modeChanges() {
+  return modeCalls;
+}
+
+void setInput(int pin, int level) {
+  HostPin *p = pinAt(pin);
+  if (!p) return;
+  p->level = level;
+  void (*isr)(void *);
+  void *arg;
+  {
+    std::lock_guard<std::mutex> guard(isrLock);
+    isr = p->isr;
+    arg = p->arg;
+  }
+  if (isr) isr(arg);
+}
+
+void onGpioWrite(WriteHook hook) {
+  writeHook = hook;
+}
+
+void clearFiles() {
+  std::lock_guard<std::mutex> guard(filesLock);
+  files.clear();
+}
+
+bool fileContents(const char *path, std::vector<uint8_t> &data) {
+  return hal::fileRead(path, data);
+}
+
+uint32_t allocations() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+uint32_t liveBlocks() {
+  return allocationCount.load(std::memory_order_relaxed) - freeCount.load(std::memory_order_relaxed);
+}
+
+void seedRandom(uint32_t seed) {
+  randomState = seed ? seed : 1;
+}
+
+uint32_t restarts() {
+  return restartCount.load();
+}
+
+}
+
+// String
+
+String::String(float value, unsigned int decimals) : String((double)value, decimals) {
+}
+
+String::String(double value, unsigned int decimals) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+  this->text = text;
+}
+
+std::string String::number(long value, unsigned char base) {
+  if (value < 0 && base == DEC) return "-" + number((unsigned long)-value, base);
+  return number((unsigned long)value, base);
+}
+
+std::string String::number(unsigned long value, unsigned char base) {
+  char text[34];
+  char *p = text + sizeof(text) - 1;
+  *p = 0;
+  do {
+    unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  return p;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t i = text.find(c, from);
+  return i == std::string::npos ? -1 : (int)i;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > text.length()) return String();
+  return String(text.substr(from, to > from ? to - from : 0));
+}
+
+void String::trim() {
+  size_t begin = text.find_first_not_of(" \t\r\n");
+  size_t end = text.find_last_not_of(" \t\r\n");
+  text = begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+// Print и Serial
+
+size_t Print::printf(const char *format, ...) {
+  char small[128];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len < sizeof(small)) return write((const uint8_t *)small, len);
+  std::vector<char> large(len + 1);
+  va_start(args, format);
+  vsnprintf(large.data(), large.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)large.data(), len);
+}
+
+static std::atomic<bool> serialMuted(false);
+
+namespace host {
+
+void muteSerial(bool mute) {
+  serialMuted = mute;
+}
+
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (serialMuted) return 1;
+  return fputc(c, stderr) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t len) {
+  if (serialMuted) return len;
+  return fwrite(data, 1, len, stderr);
+}
+
+HardwareSerial Serial;
+
+// Задачи FreeRTOS
+
+struct HostTask {
+  std::mutex lock;
+  std::condition_variable wake;
+  uint32_t notifications = 0;
+};
+
+static thread_local HostTask *currentTask = nullptr;
+
+static HostTask *selfTask() {
+  // Поток, созданный не через xTaskCreate (например, main теста)
+  if (!currentTask) currentTask = new HostTask();
+  return currentTask;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t, TaskHandle_t *handle) {
+  HostTask *task = new HostTask();
+  if (handle) *handle = task;
+  std::thread([task, fn, arg]() {
+    currentTask = task;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void xTaskNotifyGive(TaskHandle_t handle) {
+  if (!handle) return;
+  std::lock_guard<std::mutex> guard(handle->lock);
+  handle->notifications++;
+  handle->wake.notify_one();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  HostTask *task = selfTask();
+  std::unique_lock<std::mutex> guard(task->lock);
+  task->wake.wait_for(guard, std::chrono::milliseconds(ticks), [task]() { return task->notifications > 0; });
+  uint32_t value = task->notifications;
+  if (value) task->notifications = clear ? 0 : value - 1;
+  return value;
+}
+
+// Глубина стека потоков на хосте не отслеживается
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+  return 0;
+}
+
+struct HostSemaphore {
+  std::timed_mutex mutex;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new HostSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    semaphore->mutex.lock();
+    return pdTRUE;
+  }
+  return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  semaphore->mutex.unlock();
+  return pdTRUE;
+}
+
+// esp_timer
+
+struct HostTimer {
+  esp_timer_create_args_t args;
+  std::atomic<bool> running{false};
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+  HostTimer *timer = new HostTimer();
+  timer->args = *args;
+  *handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+  if (timer->running.exchange(true)) return ESP_FAIL;
+  std::thread([timer, period_us]() {
+    auto next = std::chrono::steady_clock::now();
+    while (timer->running) {
+      next += std::chrono::microseconds(period_us);
+      std::this_thread::sleep_until(next);
+      if (timer->running) timer->args.callback(timer->args.arg);
+    }
+  }).detach();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  return timer->running.exchange(false) ? ESP_OK : ESP_FAIL;
+}
+
+// Поток таймера держит указатель, поэтому объект не освобождается
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  timer->running = false;
+  return ESP_OK;
+}
+
+// Брокер MQTT в памяти
+
+bool HostTransport::connect(const char *, const char *, const char *) {
+  connectCalls++;
+  online = accept;
+  rc = accept ? 0 : -2;
+  return online;
+}
+
+void HostTransport::disconnect() {
+  online = false;
+  rc = -1;
+}
+
+bool HostTransport::publish(const char *topic, const char *payload, bool retained) {
+  if (!online) return false;
+  published.push_back(Message{topic, payload, retained});
+  return true;
+}
+
+bool HostTransport::subscribe(const char *topic) {
+  subscribeCalls++;
+  if (!online) return false;
+  if (!subscribed(topic)) subscriptions.push_back(topic);
+  return true;
+}
+
+bool HostTransport::unsubscribe(const char *topic) {
+  unsubscribeCalls++;
+  for (size_t i = 0; i < subscriptions.size(); i++) {
+    if (subscriptions[i] == topic) {
+      subscriptions.erase(subscriptions.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void HostTransport::drop() {
+  online = false;
+  rc = -3;
+  subscriptions.clear();
+}
+
+bool HostTransport::subscribed(const char *topic) const {
+  for (const std::string &s : subscriptions) {
+    if (s == topic) return true;
+  }
+  return false;
+}
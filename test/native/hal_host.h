@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+
+// Реализация hal.h для сборки [env:native] и управление ею из тестов:
+// часы, уровни пинов, файловая система в памяти и счётчики кучи.
+namespace host {
+
+// Часы по умолчанию идут в реальном времени от старта процесса.
+// setMillis() переводит их в ручной режим: время меняют только
+// setMillis(), advanceMillis() и delay()
+void setMillis(unsigned long ms);
+void advanceMillis(unsigned long ms);
+void useRealClock();
+
+// Уровень и режим пина, как их оставила прошивка
+int pinLevel(int pin);
+int pinMode(int pin);
+// Число вызовов hal::gpioMode() с начала работы
+uint32_t modeChanges();
+// Внешний сигнал на входе: меняет уровень и вызывает обработчик
+// прерывания, если он подключён
+void setInput(int pin, int level);
+// Вызывается при каждой записи в пин с micros() момента записи
+typedef void (*WriteHook)(int pin, int level, unsigned long us);
+void onGpioWrite(WriteHook hook);
+
+// Файловая система в памяти
+void clearFiles();
+bool fileContents(const char *path, std::vector<uint8_t> &data);
+
+// Выделения памяти через new: всего с начала работы и ещё не освобождённые
+uint32_t allocations();
+uint32_t liveBlocks();
+
+// Вывод Serial отбрасывается (бенчмарки, длительные прогоны)
+void muteSerial(bool mute);
+
+// Детерминированный esp_random()
+void seedRandom(uint32_t seed);
+// Число вызовов ESP.restart()
+uint32_t restarts();
+
+// Сканирование Wi-Fi: сети, которые найдёт следующее сканирование,
+// завершение идущего (ok = false - ошибка драйвера) и число запусков
+struct ScanResult {
+  std::string ssid;
+  int rssi;
+  int channel;
+  int auth;
+};
+void setScanResults(const std::vector<ScanResult> &networks);
+void finishScan(bool ok = true);
+uint32_t scanStarts();
+
+// Сеть для hal::networkUp() (по умолчанию есть) и время UTC
+// для hal::utcTime() (0 - системное время)
+void setNetworkUp(bool up);
+void setUtcTime(time_t utc);
+
+}
+
+// Брокер MQTT в памяти: принимает или отклоняет подключения, запоминает
+// подписки и опубликованные сообщения
+class HostTransport : public MqttTransport {
+public:
+  struct Message {
+    std::string topic;
+    std::string payload;
+    bool retained;
+  };
+
+  bool connect(const char *id, const char *user, const char *password) override;
+  void disconnect() override;
+  bool connected() override { return online; }
+  bool loop() override { return online; }
+  int state() override { return rc; }
+  bool publish(const char *topic, const char *payload, bool retained) override;
+  bool subscribe(const char *topic) override;
+  bool unsubscribe(const char *topic) override;
+
+  // Обрыв связи со стороны брокера
+  void drop();
+  bool subscribed(const char *topic) const;
+
+  bool accept = true;
+  bool online = false;
+  int rc = -1;
+  uint32_t connectCalls = 0;
+  uint32_t subscribeCalls = 0;
+  uint32_t unsubscribeCalls = 0;
+  std::vector<std::string> subscriptions;
+  std::vector<Message> published;
+};
+
+// Брокер за mqttTransport и mqtt из handlers.h
+extern HostTransport hostTransport;
@@ -0,0 +1,177 @@
+#include "host_http.h"
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+HostHttpServer::HostHttpServer() : listener(-1), port(0), running(false), dropCount(0), skipRange(false) {
+}
+
+HostHttpServer::~HostHttpServer() {
+  stop();
+}
+
+bool HostHttpServer::start() {
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) return false;
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(listener, (sockaddr *)&addr, len) != 0 || listen(listener, 8) != 0 ||
+      getsockname(listener, (sockaddr *)&addr, &len) != 0) {
+    close(listener);
+    listener = -1;
+    return false;
+  }
+  port = ntohs(addr.sin_port);
+  running = true;
+  worker = std::thread(&HostHttpServer::run, this);
+  return true;
+}
+
+void HostHttpServer::stop() {
+  if (!running.exchange(false)) return;
+  shutdown(listener, SHUT_RDWR);
+  close(listener);
+  worker.join();
+  listener = -1;
+}
+
+std::string HostHttpServer::url(const char *path) const {
+  return "http://127.0.0.1:" + std::to_string(port) + path;
+}
+
+void HostHttpServer::serve(const char *path, const std::vector<uint8_t> &body, const char *etag) {
+  std::lock_guard<std::mutex> guard(lock);
+  for (File &file : files) {
+    if (file.path == path) {
+      file.body = body;
+      file.etag = etag;
+      return;
+    }
+  }
+  files.push_back(File{path, body, etag});
+}
+
+void HostHttpServer::dropAfter(size_t count) {
+  std::lock_guard<std::mutex> guard(lock);
+  dropCount = count;
+}
+
+void HostHttpServer::ignoreRange(bool ignore) {
+  std::lock_guard<std::mutex> guard(lock);
+  skipRange = ignore;
+}
+
+std::vector<std::string> HostHttpServer::ranges() {
+  std::lock_guard<std::mutex> guard(lock);
+  return seenRanges;
+}
+
+std::vector<std::string> HostHttpServer::etags() {
+  std::lock_guard<std::mutex> guard(lock);
+  return seenEtags;
+}
+
+void HostHttpServer::run() {
+  while (running) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) continue;
+    handle(fd);
+    close(fd);
+  }
+}
+
+// Значение заголовка запроса без учёта регистра имени; "" - заголовка нет
+static std::string requestHeader(const std::string &request, const char *name) {
+  size_t length = strlen(name);
+  for (size_t line = request.find("\r\n"); line != std::string::npos; line = request.find("\r\n", line + 2)) {
+    size_t start = line + 2;
+    if (strncasecmp(request.c_str() + start, name, length) == 0 && request.compare(start + length, 2, ": ") == 0) {
+      start += length + 2;
+      return request.substr(start, request.find("\r\n", start) - start);
+    }
+  }
+  return "";
+}
+
+static void sendAll(int fd, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0) return;
+    p += n;
+    len -= n;
+  }
+}
+
+void HostHttpServer::handle(int fd) {
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return;
+    request.append(buffer, n);
+  }
+
+  std::string path = request.substr(4, request.find(' ', 4) - 4);
+  std::string range = requestHeader(request, "Range");
+  std::string ifNoneMatch = requestHeader(request, "If-None-Match");
+
+  std::vector<uint8_t> body;
+  std::string etag;
+  bool found = false;
+  size_t drop;
+  bool skip;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    seenRanges.push_back(range);
+    seenEtags.push_back(ifNoneMatch);
+    for (const File &file : files) {
+      if (file.path == path) {
+        body = file.body;
+        etag = file.etag;
+        found = true;
+      }
+    }
+    drop = dropCount;
+    dropCount = 0;
+    skip = skipRange;
+  }
+
+  if (!found) {
+    const char *missing = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    sendAll(fd, missing, strlen(missing));
+    return;
+  }
+
+  if (!etag.empty() && ifNoneMatch == etag) {
+    std::string head = "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\nConnection: close\r\n\r\n";
+    sendAll(fd, head.data(), head.size());
+    return;
+  }
+
+  size_t total = body.size();
+  size_t offset = 0;
+  std::string tag = etag.empty() ? "" : "ETag: " + etag + "\r\n";
+  char head[384];
+  if (!range.empty()) {
+    if (!skip) offset = strtoul(range.c_str() + strlen("bytes="), nullptr, 10);
+    if (offset > total) offset = total;
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 206 Partial Content\r\nContent-Length: %zu\r\nContent-Range: bytes %zu-%zu/%zu\r\n"
+             "%sConnection: close\r\n\r\n",
+             total - offset, offset, total ? total - 1 : 0, total, tag.c_str());
+  } else {
+    snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n%sConnection: close\r\n\r\n", total,
+             tag.c_str());
+  }
+  sendAll(fd, head, strlen(head));
+  size_t len = total - offset;
+  if (drop && drop < len) len = drop;
+  sendAll(fd, body.data() + offset, len);
+}
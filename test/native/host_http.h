@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// HTTP-сервер на 127.0.0.1 для тестов загрузки: отдаёт файлы из памяти,
+// понимает Range "bytes=N-" и If-None-Match, умеет обрывать соединение
+// и отвечать на Range не тем куском. Соединения обслуживаются по одному в своём потоке.
+class HostHttpServer {
+public:
+  HostHttpServer();
+  ~HostHttpServer();
+
+  // Порт выбирает система; false, если сокет не открылся
+  bool start();
+  void stop();
+  std::string url(const char *path) const;
+
+  // Непустой etag отдаётся в заголовке ETag; запрос с тем же
+  // If-None-Match получает 304 без тела
+  void serve(const char *path, const std::vector<uint8_t> &body, const char *etag = "");
+  // Следующий ответ обрывается после count байт тела
+  void dropAfter(size_t count);
+  // Ответы на Range идут с кодом 206, но с начала файла и с Content-Range от нуля
+  void ignoreRange(bool ignore);
+
+  // Заголовки Range всех запросов по порядку ("" - без Range)
+  std::vector<std::string> ranges();
+  // Заголовки If-None-Match всех запросов по порядку
+  std::vector<std::string> etags();
+
+private:
+  struct File {
+    std::string path;
+    std::vector<uint8_t> body;
+    std::string etag;
+  };
+
+  void run();
+  void handle(int fd);
+
+  int listener;
+  uint16_t port;
+  std::thread worker;
+  std::atomic<bool> running;
+  std::mutex lock;
+  std::vector<File> files;
+  size_t dropCount;
+  bool skipRange;
+  std::vector<std::string> seenRanges;
+  std::vector<std::string> seenEtags;
+};
@@ -0,0 +1,483 @@
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <WiFi.h>
+#include <esp_rom_crc.h>
+#include <mbedtls/sha256.h>
+#include "esp32/rom/miniz.h"
+#include "hal_host.h"
+#include <errno.h>
+#include <atomic>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+UpdateClass Update;
+
+// Сканирование Wi-Fi
+
+static std::mutex scanLock;
+static std::vector<host::ScanResult> scanFound;
+static std::vector<host::ScanResult> scanDone;
+static int16_t scanState = WIFI_SCAN_FAILED;
+static uint32_t scanStartCount = 0;
+
+int16_t WiFiClass::scanNetworks(bool) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  if (scanState == WIFI_SCAN_RUNNING) return WIFI_SCAN_FAILED;
+  scanState = WIFI_SCAN_RUNNING;
+  scanStartCount++;
+  return WIFI_SCAN_RUNNING;
+}
+
+int16_t WiFiClass::scanComplete() {
+  std::lock_guard<std::mutex> guard(scanLock);
+  return scanState;
+}
+
+void WiFiClass::scanDelete() {
+  std::lock_guard<std::mutex> guard(scanLock);
+  scanDone.clear();
+  if (scanState != WIFI_SCAN_RUNNING) scanState = WIFI_SCAN_FAILED;
+}
+
+String WiFiClass::SSID(uint8_t i) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  return i < scanDone.size() ? String(scanDone[i].ssid) : String();
+}
+
+int32_t WiFiClass::RSSI(uint8_t i) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  return i < scanDone.size() ? scanDone[i].rssi : 0;
+}
+
+uint8_t WiFiClass::channel(uint8_t i) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  return i < scanDone.size() ? scanDone[i].channel : 0;
+}
+
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t i) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  return i < scanDone.size() ? (wifi_auth_mode_t)scanDone[i].auth : WIFI_AUTH_OPEN;
+}
+
+namespace host {
+
+void setScanResults(const std::vector<ScanResult> &networks) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  scanFound = networks;
+}
+
+void finishScan(bool ok) {
+  std::lock_guard<std::mutex> guard(scanLock);
+  if (scanState != WIFI_SCAN_RUNNING) return;
+  scanDone = ok ? scanFound : std::vector<ScanResult>();
+  scanState = ok ? (int16_t)scanDone.size() : WIFI_SCAN_FAILED;
+}
+
+uint32_t scanStarts() {
+  std::lock_guard<std::mutex> guard(scanLock);
+  return scanStartCount;
+}
+
+}
+
+// WiFiClient
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t) {
+  stop();
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *found = nullptr;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(host, service, &hints, &found) != 0) return 0;
+  fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+  if (fd >= 0 && ::connect(fd, found->ai_addr, found->ai_addrlen) != 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(found);
+  if (fd < 0) return 0;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t *data, size_t len) {
+  size_t sent = 0;
+  while (fd >= 0 && sent < len) {
+    ssize_t n = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+    if (n <= 0) break;
+    sent += n;
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  int pending = 0;
+  if (fd < 0 || ioctl(fd, FIONREAD, &pending) != 0) return 0;
+  return pending;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return readBytes(&c, 1) == 1 ? c : -1;
+}
+
+size_t WiFiClient::readBytes(uint8_t *buffer, size_t len) {
+  if (fd < 0) return 0;
+  ssize_t n = recv(fd, buffer, len, MSG_DONTWAIT);
+  return n > 0 ? n : 0;
+}
+
+// Как на ESP32: соединение считается живым, пока в нём есть непрочитанные данные
+uint8_t WiFiClient::connected() {
+  if (fd < 0) return 0;
+  uint8_t c;
+  ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n > 0) return 1;
+  if (n == 0) return 0;
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+void WiFiClient::stop() {
+  if (fd >= 0) close(fd);
+  fd = -1;
+}
+
+// HTTPClient
+
+bool HTTPClient::begin(WiFiClient &client, const String &url) {
+  this->client = &client;
+  std::string text = url.c_str();
+  received.clear();
+  requestHeaders.clear();
+  size = -1;
+  if (text.compare(0, 7, "http://") != 0) return false;
+  text = text.substr(7);
+  size_t slash = text.find('/');
+  std::string authority = text.substr(0, slash);
+  path = slash == std::string::npos ? "/" : text.substr(slash);
+  size_t colon = authority.find(':');
+  host = authority.substr(0, colon);
+  port = colon == std::string::npos ? 80 : atoi(authority.c_str() + colon + 1);
+  return true;
+}
+
+void HTTPClient::collectHeaders(const char *names[], size_t count) {
+  wanted.assign(names, names + count);
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+  requestHeaders += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+}
+
+bool HTTPClient::readLine(std::string &line) {
+  line.clear();
+  unsigned long since = millis();
+  while (true) {
+    int c = client->read();
+    if (c < 0) {
+      if (!client->connected() || millis() - since > timeout) return false;
+      delay(1);
+      continue;
+    }
+    if (c == '\n') break;
+    if (c != '\r') line += (char)c;
+  }
+  return true;
+}
+
+int HTTPClient::GET() {
+  if (!client->connect(host.c_str(), port, timeout)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n" + requestHeaders + "\r\n";
+  client->write((const uint8_t *)request.data(), request.size());
+
+  std::string line;
+  if (!readLine(line) || line.compare(0, 5, "HTTP/") != 0) return HTTPC_ERROR_READ_TIMEOUT;
+  int code = atoi(line.c_str() + line.find(' ') + 1);
+  while (readLine(line) && !line.empty()) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string name = line.substr(0, colon);
+    std::string value = line.substr(line.find_first_not_of(' ', colon + 1));
+    if (strcasecmp(name.c_str(), "Content-Length") == 0) size = atoi(value.c_str());
+    for (const std::string &w : wanted) {
+      if (strcasecmp(w.c_str(), name.c_str()) == 0) received.push_back({w, value});
+    }
+  }
+  return code;
+}
+
+String HTTPClient::header(const char *name) const {
+  for (const auto &h : received) {
+    if (strcasecmp(h.first.c_str(), name) == 0) return String(h.second);
+  }
+  return String();
+}
+
+String HTTPClient::getString() {
+  std::string body;
+  unsigned long since = millis();
+  while ((size < 0 || (int)body.size() < size) && millis() - since <= timeout) {
+    uint8_t buffer[512];
+    size_t n = client->readBytes(buffer, sizeof(buffer));
+    if (n) {
+      body.append((const char *)buffer, n);
+      since = millis();
+    } else if (!client->connected()) {
+      break;
+    } else {
+      delay(1);
+    }
+  }
+  return String(body);
+}
+
+void HTTPClient::end() {
+  if (client) client->stop();
+}
+
+// Сеть для hal.h
+
+static std::atomic<bool> linkUp(true);
+static std::atomic<time_t> fixedUtc(0);
+
+namespace host {
+
+void setNetworkUp(bool up) {
+  linkUp = up;
+}
+
+void setUtcTime(time_t utc) {
+  fixedUtc = utc;
+}
+
+}
+
+namespace hal {
+
+bool networkUp() {
+  return linkUp;
+}
+
+time_t utcTime() {
+  time_t utc = fixedUtc;
+  return utc ? utc : time(nullptr);
+}
+
+int wifiRssi() {
+  return WiFi.RSSI();
+}
+
+int httpGet(const char *url, const char *ifNoneMatch, uint16_t timeout, std::string &etag, std::string &body) {
+  WiFiClient client;
+  HTTPClient http;
+  const char *headers[] = {"ETag"};
+  http.begin(client, url);
+  http.setTimeout(timeout);
+  http.collectHeaders(headers, 1);
+  if (*ifNoneMatch) {
+    http.addHeader("If-None-Match", ifNoneMatch);
+  }
+  int code = http.GET();
+  if (code == HTTP_CODE_OK) {
+    etag = http.header("ETag").c_str();
+    body = http.getString().c_str();
+  }
+  http.end();
+  return code;
+}
+
+}
+
+// Update
+
+bool UpdateClass::begin(size_t size) {
+  data.clear();
+  expected = size;
+  running = true;
+  done = false;
+  error = nullptr;
+  return true;
+}
+
+size_t UpdateClass::write(uint8_t *buffer, size_t len) {
+  if (!running) return 0;
+  if (expected != UPDATE_SIZE_UNKNOWN && data.size() + len > expected) {
+    error = "Image too large";
+    return 0;
+  }
+  data.insert(data.end(), buffer, buffer + len);
+  return len;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+  if (!running) return false;
+  running = false;
+  if (!evenIfRemaining && expected != UPDATE_SIZE_UNKNOWN && data.size() != expected) {
+    error = "Image size mismatch";
+    return false;
+  }
+  done = true;
+  return true;
+}
+
+void UpdateClass::abort() {
+  running = false;
+  error = "Aborted";
+}
+
+// SHA-256 (FIPS 180-4)
+
+static const uint32_t shaRound[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void shaBlock(mbedtls_sha256_context *ctx, const uint8_t *block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[4 * i] << 24 | block[4 * i + 1] << 16 | block[4 * i + 2] << 8 | block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+  uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + shaRound[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  ctx->state[0] += a;
+  ctx->state[1] += b;
+  ctx->state[2] += c;
+  ctx->state[3] += d;
+  ctx->state[4] += e;
+  ctx->state[5] += f;
+  ctx->state[6] += g;
+  ctx->state[7] += h;
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int) {
+  static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memcpy(ctx->state, initial, sizeof(initial));
+  ctx->length = 0;
+  ctx->used = 0;
+  return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen) {
+  ctx->length += ilen;
+  while (ilen > 0) {
+    size_t n = std::min(ilen, sizeof(ctx->block) - ctx->used);
+    memcpy(ctx->block + ctx->used, input, n);
+    ctx->used += n;
+    input += n;
+    ilen -= n;
+    if (ctx->used == sizeof(ctx->block)) {
+      shaBlock(ctx, ctx->block);
+      ctx->used = 0;
+    }
+  }
+  return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32]) {
+  uint64_t bits = ctx->length * 8;
+  uint8_t pad = 0x80;
+  mbedtls_sha256_update(ctx, &pad, 1);
+  pad = 0;
+  while (ctx->used != 56) mbedtls_sha256_update(ctx, &pad, 1);
+  uint8_t length[8];
+  for (int i = 0; i < 8; i++) length[i] = bits >> (56 - 8 * i);
+  mbedtls_sha256_update(ctx, length, 8);
+  for (int i = 0; i < 8; i++) {
+    output[4 * i] = ctx->state[i] >> 24;
+    output[4 * i + 1] = ctx->state[i] >> 16;
+    output[4 * i + 2] = ctx->state[i] >> 8;
+    output[4 * i + 3] = ctx->state[i];
+  }
+  return 0;
+}
+
+// tinfl поверх zlib
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  return crc32(crc, buf, len);
+}
+
+// Память zlib выделяется из буфера внутри самого распаковщика
+static voidpf arenaAlloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor *r = (tinfl_decompressor *)opaque;
+  size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+  if (r->arenaUsed + bytes > sizeof(r->arena)) return Z_NULL;
+  void *p = r->arena + r->arenaUsed;
+  r->arenaUsed += bytes;
+  return p;
+}
+
+static void arenaFree(voidpf, voidpf) {
+}
+
+void tinfl_init(tinfl_decompressor *r) {
+  memset(&r->stream, 0, sizeof(r->stream));
+  r->started = false;
+  r->arenaUsed = 0;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in, size_t *inSize, uint8_t *, uint8_t *outNext,
+                              size_t *outSize, uint32_t) {
+  if (!r->started) {
+    r->stream.zalloc = arenaAlloc;
+    r->stream.zfree = arenaFree;
+    r->stream.opaque = r;
+    if (inflateInit2(&r->stream, -15) != Z_OK) return TINFL_STATUS_FAILED;
+    r->started = true;
+  }
+  r->stream.next_in = (Bytef *)in;
+  r->stream.avail_in = *inSize;
+  r->stream.next_out = outNext;
+  r->stream.avail_out = *outSize;
+  int ret = inflate(&r->stream, Z_NO_FLUSH);
+  *inSize -= r->stream.avail_in;
+  *outSize -= r->stream.avail_out;
+  if (ret == Z_STREAM_END) return TINFL_STATUS_DONE;
+  if (ret != Z_OK && ret != Z_BUF_ERROR) return TINFL_STATUS_FAILED;
+  return r->stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
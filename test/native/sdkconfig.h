@@ -0,0 +1,3 @@
+#pragma once
+
+// Сборка для хоста: CONFIG_IDF_TARGET_* не заданы
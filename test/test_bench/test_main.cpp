@@ -0,0 +1,309 @@
+// Бенчмарки горячих путей прошивки на хосте: время и число выделений
+// памяти на операцию. Выделения считаются точно и не зависят от машины,
+// поэтому их бюджеты строгие; бюджеты времени с большим запасом ловят
+// только регрессии на порядок.
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <chrono>
+#include <vector>
+#include "config_store.h"
+#include "hal_host.h"
+#include "handlers.h"
+#include "metrics.h"
+#include "tasks.h"
+#include "temp_sampler.h"
+#include "topic_index.h"
+
+struct BenchResult {
+  double nsPerOp;
+  uint32_t allocs;  // за все итерации замера
+};
+
+// Первый вызов прогревает кэши и статические буферы и в замер не входит
+template <typename Fn>
+static BenchResult bench(const char *name, uint32_t iterations, Fn fn) {
+  fn();
+  uint32_t allocs = host::allocations();
+  auto started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    fn();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - started;
+  BenchResult result;
+  result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+  result.allocs = host::allocations() - allocs;
+  printf("bench %-22s %10.0f ns/op %8.2f allocs/op\n", name, result.nsPerOp, (double)result.allocs / iterations);
+  return result;
+}
+
+// Вывод в никуда: считает байты, память не выделяет
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override {
+    bytes++;
+    return 1;
+  }
+  size_t write(const uint8_t *, size_t len) override {
+    bytes += len;
+    return len;
+  }
+  using Print::write;
+  size_t bytes = 0;
+};
+
+// Конфигурация с заполненными списками - худший случай по размеру
+static void fillConfig(Config &c) {
+  c = Config();
+  c.ssid = "bench-network";
+  c.password = "bench-password";
+  c.mqtt_server = "192.168.1.10";
+  c.mqtt_user = "pcc";
+  c.mqtt_password = "secret";
+  c.static_ip = 0x0a01a8c0;
+  c.update_url = "http://updates.local/pcc/manifest.json";
+  c.ota_group = "hall";
+  for (int i = 0; i < CONFIG_MAX_BUTTONS; i++) {
+    ButtonConfig button;
+    char text[96];
+    snprintf(text, sizeof(text), "button-%02d", i);
+    button.name = text;
+    snprintf(text, sizeof(text), "home/hall/panel/button-%02d/set", i);
+    button.topic = text;
+    button.pin = i + 1;
+    button.duration = 250;
+    button.mode = i % 4 == 3 ? INPUT_PULLUP : OUTPUT;
+    button.debounce = 30;
+    c.buttons.push_back(button);
+  }
+  for (int i = 0; i < CONFIG_MAX_SENSORS; i++) {
+    SensorConfig sensor;
+    char text[32];
+    snprintf(text, sizeof(text), "sensor-%02d", i);
+    sensor.name = text;
+    for (int b = 0; b < 8; b++) sensor.address[b] = 0x28 + i + b;
+    sensor.resolution = 12;
+    c.sensors.push_back(sensor);
+  }
+  for (int i = 0; i < CONFIG_MAX_MACROS; i++) {
+    MacroConfig macro;
+    char text[96];
+    snprintf(text, sizeof(text), "macro-%d", i);
+    macro.name = text;
+    snprintf(text, sizeof(text), "home/hall/macro/%d", i);
+    macro.topic = text;
+    macro.script = "pulse 1 200; wait 100; pulse 2 200; wait 100; pulse 3 200";
+    c.macros.push_back(macro);
+  }
+}
+
+static Config source;
+static Config loaded;
+
+void setUp() {
+  host::clearFiles();
+  fillConfig(source);
+}
+
+void tearDown() {
+}
+
+void test_config_save_load() {
+  ConfigStore store;
+  TEST_ASSERT_TRUE(store.save(source));
+  BenchResult save = bench("config_save", 200, [&]() { store.save(source); });
+  BenchResult load = bench("config_load", 200, [&]() { store.load(loaded); });
+
+  TEST_ASSERT_TRUE(store.load(loaded));
+  TEST_ASSERT_EQUAL_STRING(source.ssid.c_str(), loaded.ssid.c_str());
+  TEST_ASSERT_EQUAL(CONFIG_MAX_BUTTONS, loaded.buttons.size());
+  TEST_ASSERT_EQUAL_STRING(source.macros[7].script.c_str(), loaded.macros[7].script.c_str());
+  // Запись: буфер кодирования, файл, проверочное чтение и снимок Config.
+  // Чтение: копия файла и Config-кандидат на каждый из двух слотов.
+  TEST_ASSERT_LESS_OR_EQUAL(12 * 200, save.allocs);
+  TEST_ASSERT_LESS_OR_EQUAL(4 * 200, load.allocs);
+  TEST_ASSERT_LESS_THAN(2000000, save.nsPerOp);
+  TEST_ASSERT_LESS_THAN(1000000, load.nsPerOp);
+}
+
+// Двоичный формат против прежнего config.json через ArduinoJson: тот же
+// Config, запись в файл и чтение обратно в структуру
+void test_config_binary_vs_json() {
+  ConfigStore store;
+  TEST_ASSERT_TRUE(store.save(source));
+  std::vector<uint8_t> binary;
+  TEST_ASSERT_TRUE(hal::fileRead("/config.0", binary));
+
+  BenchResult jsonSave = bench("config_json_save", 200, [&]() {
+    JsonDocument doc;
+    configToJson(source, doc);
+    String text;
+    serializeJson(doc, text);
+    hal::fileWrite("/config.json", (const uint8_t *)text.c_str(), text.length());
+  });
+  std::vector<uint8_t> json;
+  TEST_ASSERT_TRUE(hal::fileRead("/config.json", json));
+  BenchResult jsonLoad = bench("config_json_load", 200, [&]() {
+    std::vector<uint8_t> data;
+    hal::fileRead("/config.json", data);
+    JsonDocument doc;
+    if (!deserializeJson(doc, (const char *)data.data(), data.size())) configFromJson(doc, loaded);
+  });
+  TEST_ASSERT_EQUAL_STRING(source.macros[7].script.c_str(), loaded.macros[7].script.c_str());
+  TEST_ASSERT_EQUAL(CONFIG_MAX_BUTTONS, loaded.buttons.size());
+
+  BenchResult binarySave = bench("config_binary_save", 200, [&]() { store.save(source); });
+  BenchResult binaryLoad = bench("config_binary_load", 200, [&]() { store.load(loaded); });
+  printf("bench config_size            %u bytes binary, %u bytes json\n", (unsigned)binary.size(), (unsigned)json.size());
+
+  // Двоичная запись дороже одной записи JSON: она читает слот обратно и
+  // проверяет CRC. Чтение и размер должны выигрывать.
+  TEST_ASSERT_LESS_THAN(json.size(), binary.size());
+  TEST_ASSERT_LESS_THAN(jsonLoad.nsPerOp, binaryLoad.nsPerOp);
+  TEST_ASSERT_LESS_THAN(jsonLoad.allocs, binaryLoad.allocs);
+  TEST_ASSERT_GREATER_THAN(0, jsonSave.allocs);
+  TEST_ASSERT_GREATER_THAN(0, binarySave.allocs);
+}
+
+// Путь сообщения MQTT до очереди исполнительной задачи: handleMqttMessage()
+// с конфигурацией наибольшего размера, включая проход по макросам
+void test_mqtt_dispatch() {
+  config = source;
+  topicIndex.build(config.buttons);
+  const char *topic = "home/hall/panel/button-10/set";
+  const uint8_t payload[] = "{\"action\":\"on\",\"duration\":500}";
+  size_t dispatched = 0;
+  BenchResult result = bench("mqtt_dispatch", 100000, [&]() {
+    handleMqttMessage(topic, payload, sizeof(payload) - 1);
+    ActuationCommand taken;
+    while (actuationQueue.pop(taken)) {
+      if (taken.pin == 11 && taken.duration == 500) dispatched++;
+    }
+  });
+  TEST_ASSERT_EQUAL(100001, dispatched);
+  TEST_ASSERT_EQUAL(0, result.allocs);
+  TEST_ASSERT_LESS_THAN(20000, result.nsPerOp);
+}
+
+// Поиск кнопок по топику: индекс против линейного прохода по списку и
+// против прежнего callback(), который копировал payload и каждую кнопку
+// в String. Топик последней выходной кнопки - худший случай для прохода.
+struct LegacyButton {
+  String name;
+  int pin;
+  unsigned long duration;
+  String topic;
+  int mode;
+};
+
+void test_topic_lookup_indexed_vs_linear() {
+  topicIndex.build(source.buttons);
+  std::vector<LegacyButton> legacy;
+  for (const ButtonConfig &button : source.buttons) {
+    legacy.push_back(LegacyButton{button.name.c_str(), button.pin, button.duration, button.topic.c_str(), button.mode});
+  }
+  const char *topic = "home/hall/panel/button-14/set";
+  const uint8_t payload[] = "{\"action\":\"on\",\"duration\":500}";
+  size_t found = 0;
+
+  BenchResult indexed = bench("topic_indexed", 100000, [&]() {
+    uint8_t matches[TOPIC_MATCH_MAX];
+    found += topicIndex.match(topic, matches, TOPIC_MATCH_MAX);
+  });
+  BenchResult linear = bench("topic_linear", 100000, [&]() {
+    for (const ButtonConfig &button : source.buttons) {
+      if (button.mode == OUTPUT && strcmp(button.topic.c_str(), topic) == 0) found++;
+    }
+  });
+  BenchResult old = bench("topic_legacy_string", 100000, [&]() {
+    String message;
+    for (unsigned int i = 0; i < sizeof(payload) - 1; i++) {
+      message += (char)payload[i];
+    }
+    for (LegacyButton button : legacy) {
+      if (String(topic) == button.topic) found++;
+    }
+  });
+  TEST_ASSERT_EQUAL(3 * 100001, found);
+  TEST_ASSERT_EQUAL(0, indexed.allocs);
+  TEST_ASSERT_EQUAL(0, linear.allocs);
+  // Прежний путь выделял память на payload, топик и каждую кнопку
+  TEST_ASSERT_GREATER_THAN(CONFIG_MAX_BUTTONS * 100000, old.allocs);
+  TEST_ASSERT_LESS_THAN(old.nsPerOp, indexed.nsPerOp);
+  TEST_ASSERT_LESS_THAN(2000, indexed.nsPerOp);
+}
+
+// Шина с датчиками из конфигурации бенчмарка, все показывают 21.5 °C
+class BenchBus : public TempBus {
+public:
+  uint8_t search(TempAddress *found, uint8_t max) override {
+    uint8_t n = 0;
+    for (const SensorConfig &sensor : source.sensors) {
+      if (n == max) break;
+      memcpy(found[n++], sensor.address, sizeof(TempAddress));
+    }
+    return n;
+  }
+  bool setResolution(const uint8_t *, uint8_t) override { return true; }
+  void requestConversion() override {}
+  float read(const uint8_t *) override { return 21.5; }
+};
+
+// Тела /api/state, /button_state и /temp из handlers.cpp: 16 кнопок
+// и 16 датчиков с показаниями
+void test_state_json_render() {
+  config = source;
+  static BenchBus bus;
+  tempSampler.clear();
+  tempSampler.addBus(&bus);
+  tempSampler.loop(TEMP_SAMPLE_INTERVAL);
+  tempSampler.loop(2 * TEMP_SAMPLE_INTERVAL);
+  TempSensor sensor;
+  TEST_ASSERT_TRUE(tempSampler.sensor(CONFIG_MAX_SENSORS - 1, sensor));
+  TEST_ASSERT_TRUE(sensor.reading.valid);
+
+  NullPrint out;
+  BenchResult state = bench("state_json", 20000, [&]() { renderApiState(out, 123456, nullptr); });
+  char since[16];
+  snprintf(since, sizeof(since), "%u", currentStateVersion());
+  size_t before = out.bytes;
+  BenchResult unchanged = bench("state_json_unchanged", 20000, [&]() { renderApiState(out, 123456, since); });
+  size_t unchangedBytes = (out.bytes - before) / 20001;
+  BenchResult buttons = bench("button_state_json", 20000, [&]() { renderButtonState(out, 123456); });
+  BenchResult temps = bench("temp_json", 20000, [&]() { renderTemperature(out, 123456); });
+  tempSampler.clear();
+
+  TEST_ASSERT_GREATER_THAN(0, out.bytes);
+  TEST_ASSERT_LESS_THAN(64, unchangedBytes);
+  TEST_ASSERT_EQUAL(0, state.allocs);
+  TEST_ASSERT_EQUAL(0, unchanged.allocs);
+  TEST_ASSERT_EQUAL(0, buttons.allocs);
+  TEST_ASSERT_EQUAL(0, temps.allocs);
+  TEST_ASSERT_LESS_THAN(200000, state.nsPerOp);
+  TEST_ASSERT_LESS_THAN(state.nsPerOp, unchanged.nsPerOp);
+  TEST_ASSERT_LESS_THAN(200000, temps.nsPerOp);
+}
+
+// Страница /metrics целиком, как её отдаёт handleMetrics()
+void test_metrics_render() {
+  for (uint32_t us = 50; us < 2000000; us *= 2) metrics.recordLoop(us);
+  static const char *routes[] = {"/", "/api/state", "/save", "/metrics", "/trigger"};
+  for (const char *path : routes) metrics.recordRoute(metrics.route(path), 1500);
+  NullPrint out;
+  BenchResult result = bench("metrics_render", 20000, [&]() { renderMetrics(out); });
+  TEST_ASSERT_GREATER_THAN(0, out.bytes);
+  TEST_ASSERT_EQUAL(0, result.allocs);
+  TEST_ASSERT_LESS_THAN(500000, result.nsPerOp);
+}
+
+int main() {
+  // Журнал обработчиков не должен попадать в замер
+  host::muteSerial(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_config_save_load);
+  RUN_TEST(test_config_binary_vs_json);
+  RUN_TEST(test_mqtt_dispatch);
+  RUN_TEST(test_topic_lookup_indexed_vs_linear);
+  RUN_TEST(test_state_json_render);
+  RUN_TEST(test_metrics_render);
+  return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include <unity.h>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_fifo_order() {
+  BoundedQueue<int, 4> queue;
+  int item = -1;
+  TEST_ASSERT_FALSE(queue.pop(item));
+  for (int i = 0; i < 4; i++) TEST_ASSERT_TRUE(queue.push(i));
+  TEST_ASSERT_EQUAL(4, queue.size());
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(i, item);
+  }
+  TEST_ASSERT_FALSE(queue.pop(item));
+  TEST_ASSERT_EQUAL(0, queue.size());
+}
+
+void test_full_queue_drops() {
+  BoundedQueue<int, 4> queue;
+  for (int i = 0; i < 4; i++) queue.push(i);
+  TEST_ASSERT_FALSE(queue.push(99));
+  TEST_ASSERT_FALSE(queue.push(100));
+  TEST_ASSERT_EQUAL(2, queue.dropped());
+  TEST_ASSERT_EQUAL(4, queue.highWater());
+  // Отклонённые элементы не попадают в очередь
+  int item = -1;
+  for (int i = 0; i < 4; i++) {
+    queue.pop(item);
+    TEST_ASSERT_EQUAL(i, item);
+  }
+  TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+// Счётчики поколений ячеек переживают много оборотов кольца
+void test_wraparound() {
+  BoundedQueue<uint32_t, 8> queue;
+  uint32_t next = 0, expected = 0, item = 0;
+  for (int round = 0; round < 10000; round++) {
+    for (int i = 0; i < 5; i++) TEST_ASSERT_TRUE(queue.push(next++));
+    for (int i = 0; i < 5; i++) {
+      TEST_ASSERT_TRUE(queue.pop(item));
+      TEST_ASSERT_EQUAL(expected++, item);
+    }
+  }
+  TEST_ASSERT_EQUAL(0, queue.dropped());
+  TEST_ASSERT_EQUAL(5, queue.highWater());
+}
+
+// Несколько писателей и читателей одновременно: каждый элемент доставлен
+// ровно один раз, элементы одного писателя приходят по порядку
+void test_mpmc_stress() {
+  const int producers = 4, consumers = 4;
+  const uint32_t perProducer = 200000;
+  static BoundedQueue<uint32_t, 16> queue;
+  std::vector<std::vector<uint32_t>> received(consumers);
+  std::atomic<uint32_t> delivered(0);
+  std::atomic<bool> orderBroken(false);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([p, perProducer]() {
+      for (uint32_t i = 0; i < perProducer; i++) {
+        uint32_t item = (uint32_t)p << 24 | i;
+        while (!queue.push(item)) std::this_thread::yield();
+      }
+    });
+  }
+  for (int c = 0; c < consumers; c++) {
+    threads.emplace_back([c, &received, &delivered, &orderBroken, producers, perProducer]() {
+      std::vector<int64_t> last(producers, -1);
+      while (delivered.load() < producers * perProducer) {
+        uint32_t item;
+        if (!queue.pop(item)) {
+          std::this_thread::yield();
+          continue;
+        }
+        uint32_t p = item >> 24, seq = item & 0xffffff;
+        if ((int64_t)seq <= last[p]) orderBroken = true;
+        last[p] = seq;
+        received[c].push_back(item);
+        delivered++;
+      }
+    });
+  }
+  for (std::thread &t : threads) t.join();
+
+  TEST_ASSERT_FALSE(orderBroken.load());
+  std::vector<uint8_t> seen(producers * perProducer, 0);
+  for (const std::vector<uint32_t> &items : received) {
+    for (uint32_t item : items) {
+      seen[(item >> 24) * perProducer + (item & 0xffffff)]++;
+    }
+  }
+  for (size_t i = 0; i < seen.size(); i++) {
+    if (seen[i] != 1) TEST_FAIL_MESSAGE("item lost or delivered twice");
+  }
+  TEST_ASSERT_EQUAL(0, queue.size());
+  TEST_ASSERT_LESS_OR_EQUAL(16, queue.highWater());
+  // Писатели упирались в полную очередь и повторяли попытку
+  TEST_ASSERT_GREATER_THAN(0, queue.dropped());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_full_queue_drops);
+  RUN_TEST(test_wraparound);
+  RUN_TEST(test_mpmc_stress);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+// Применение новой конфигурации по разнице с прежней: режимы пинов через
+// hal::gpioMode, подписки и переподключение через брокер HostTransport.
+#include <unity.h>
+#include "config_apply.h"
+#include "hal_host.h"
+#include "handlers.h"
+#include "input_engine.h"
+#include "pulse_scheduler.h"
+#include "topic_index.h"
+
+#define RELAY_PIN 12
+#define DOOR_PIN 14
+#define LIGHT_PIN 15
+
+static Config previous;
+
+static void addButton(Config &target, const char *name, int pin, int mode, const char *topic) {
+  ButtonConfig button = {};
+  button.name = name;
+  button.pin = pin;
+  button.duration = 200;
+  button.topic = topic;
+  button.mode = mode;
+  button.debounce = 20;
+  target.buttons.push_back(button);
+}
+
+// Новая конфигурация вступает в силу так же, как в сетевой задаче:
+// config заменяется, затем применяется разница с previous
+static ConfigChanges apply(const Config &next) {
+  previous = config;
+  config = next;
+  return applyChanges(previous, config);
+}
+
+// Кнопки настроены, устройство подключено к брокеру и подписано на
+// топики команд, как после mqttConnect
+void setUp() {
+  host::setMillis(1000);
+  pulses.clear();
+  inputs.clear();
+  hostTransport.drop();
+  Config initial;
+  initial.mqtt_server = "broker.local";
+  initial.mqtt_user = "pcc";
+  addButton(initial, "relay", RELAY_PIN, OUTPUT, "home/relay");
+  addButton(initial, "door", DOOR_PIN, INPUT_PULLUP, "home/door");
+  config = Config();
+  config.mqtt_server = initial.mqtt_server;
+  config.mqtt_user = initial.mqtt_user;
+  apply(initial);
+  TEST_ASSERT_TRUE(hostTransport.connect("test", "pcc", ""));
+  TopicList topics;
+  commandTopics(config, topics);
+  for (const char *topic : topics) hostTransport.subscribe(topic);
+}
+
+void tearDown() {
+}
+
+// Переименованный топик: одна отписка и одна подписка без переподключения
+void test_renamed_topic_resubscribes() {
+  uint32_t subscribes = hostTransport.subscribeCalls;
+  uint32_t unsubscribes = hostTransport.unsubscribeCalls;
+  uint32_t connects = hostTransport.connectCalls;
+  Config next = config;
+  next.buttons[0].topic = "home/gate";
+  ConfigChanges changes = apply(next);
+
+  TEST_ASSERT_FALSE(changes.broker);
+  TEST_ASSERT_EQUAL(unsubscribes + 1, hostTransport.unsubscribeCalls);
+  TEST_ASSERT_EQUAL(subscribes + 1, hostTransport.subscribeCalls);
+  TEST_ASSERT_TRUE(hostTransport.subscribed("home/gate"));
+  TEST_ASSERT_FALSE(hostTransport.subscribed("home/relay"));
+  TEST_ASSERT_TRUE(hostTransport.online);
+  TEST_ASSERT_EQUAL(connects, hostTransport.connectCalls);
+  uint8_t matches[TOPIC_MATCH_MAX];
+  TEST_ASSERT_EQUAL(1, topicIndex.match("home/gate", matches, TOPIC_MATCH_MAX));
+  TEST_ASSERT_EQUAL(0, matches[0]);
+  TEST_ASSERT_EQUAL(0, topicIndex.match("home/relay", matches, TOPIC_MATCH_MAX));
+}
+
+// Кнопка с тем же пином и режимом не перенастраивается, и идущий
+// импульс не обрывается; gpioMode получает только новая кнопка
+void test_unchanged_button_keeps_pin_mode() {
+  TEST_ASSERT_EQUAL(OUTPUT, host::pinMode(RELAY_PIN));
+  TEST_ASSERT_TRUE(pulses.request(RELAY_PIN, 500));
+  pulses.service(hal::millis());
+  TEST_ASSERT_TRUE(pulses.isActive(RELAY_PIN));
+
+  uint32_t modes = host::modeChanges();
+  Config next = config;
+  next.buttons[0].duration = 300;
+  next.buttons[1].name = "front door";
+  ConfigChanges changes = apply(next);
+  TEST_ASSERT_EQUAL(modes, host::modeChanges());
+  TEST_ASSERT_FALSE(changes.inputs);
+  TEST_ASSERT_TRUE(pulses.isActive(RELAY_PIN));
+
+  next = config;
+  addButton(next, "light", LIGHT_PIN, OUTPUT, "home/light");
+  changes = apply(next);
+  TEST_ASSERT_EQUAL(modes + 1, host::modeChanges());
+  TEST_ASSERT_EQUAL(OUTPUT, host::pinMode(LIGHT_PIN));
+  TEST_ASSERT_TRUE(pulses.owns(LIGHT_PIN));
+  TEST_ASSERT_TRUE(pulses.isActive(RELAY_PIN));
+  // Номера входов те же, но кнопок стало больше
+  TEST_ASSERT_TRUE(changes.inputs);
+
+  // Без изменений ничего не трогается
+  uint32_t subscribes = hostTransport.subscribeCalls;
+  uint32_t unsubscribes = hostTransport.unsubscribeCalls;
+  changes = apply(config);
+  TEST_ASSERT_EQUAL(modes + 1, host::modeChanges());
+  TEST_ASSERT_EQUAL(subscribes, hostTransport.subscribeCalls);
+  TEST_ASSERT_EQUAL(unsubscribes, hostTransport.unsubscribeCalls);
+  TEST_ASSERT_FALSE(changes.inputs || changes.buses || changes.broker || changes.wifi);
+}
+
+// Смена учётных данных MQTT закрывает сессию: подписки оформит новое
+// подключение, поэтому по одной они не меняются
+void test_mqtt_credentials_reconnect() {
+  uint32_t disconnects = mqtt.disconnects();
+  uint32_t unsubscribes = hostTransport.unsubscribeCalls;
+  Config next = config;
+  next.mqtt_password = "secret";
+  next.buttons[0].topic = "home/gate";
+  ConfigChanges changes = apply(next);
+
+  TEST_ASSERT_TRUE(changes.broker);
+  TEST_ASSERT_FALSE(hostTransport.online);
+  TEST_ASSERT_EQUAL(disconnects + 1, mqtt.disconnects());
+  TEST_ASSERT_EQUAL(MqttConnection::DISCONNECTED, mqtt.state());
+  TEST_ASSERT_EQUAL(unsubscribes, hostTransport.unsubscribeCalls);
+
+  TEST_ASSERT_TRUE(hostTransport.connect("test", "pcc", "secret"));
+  next = config;
+  next.mqtt_user = "pcc2";
+  TEST_ASSERT_TRUE(apply(next).broker);
+  TEST_ASSERT_FALSE(hostTransport.online);
+}
+
+int main() {
+  host::muteSerial(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_renamed_topic_resubscribes);
+  RUN_TEST(test_unchanged_button_keeps_pin_mode);
+  RUN_TEST(test_mqtt_credentials_reconnect);
+  return UNITY_END();
+}
@@ -0,0 +1,190 @@
+// Ёмкость строк конфигурации и поведение кучи при долгой работе: правка
+// конфигурации, запись, чтение и горячие пути на каждом круге не должны
+// оставлять за собой живых блоков.
+#include <unity.h>
+#include <ArduinoJson.h>
+#include "config_store.h"
+#include "hal_host.h"
+#include "json_writer.h"
+#include "tasks.h"
+#include "topic_index.h"
+
+static const uint32_t soakRounds = 10000;
+
+// Вывод в никуда: считает байты, память не выделяет
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override {
+    bytes++;
+    return 1;
+  }
+  size_t write(const uint8_t *, size_t len) override {
+    bytes += len;
+    return len;
+  }
+  using Print::write;
+  size_t bytes = 0;
+};
+
+static void fillConfig(Config &c) {
+  c = Config();
+  c.ssid = "soak-network";
+  c.mqtt_server = "192.168.1.10";
+  for (int i = 0; i < CONFIG_MAX_BUTTONS; i++) {
+    ButtonConfig button;
+    char text[96];
+    snprintf(text, sizeof(text), "button-%02d", i);
+    button.name = text;
+    snprintf(text, sizeof(text), "home/soak/button-%02d/set", i);
+    button.topic = text;
+    button.pin = i + 1;
+    button.duration = 100;
+    button.mode = OUTPUT;
+    c.buttons.push_back(button);
+  }
+}
+
+static String repeat(char c, size_t count) {
+  String s;
+  for (size_t i = 0; i < count; i++) s += c;
+  return s;
+}
+
+static bool importJson(const String &json, Config &out) {
+  JsonDocument doc;
+  if (deserializeJson(doc, json)) return false;
+  return configFromJson(doc, out);
+}
+
+void setUp() {
+  host::clearFiles();
+}
+
+void tearDown() {
+}
+
+void test_assign_reports_overflow() {
+  FixedString<8> s;
+  TEST_ASSERT_TRUE(s.assign("12345678"));
+  TEST_ASSERT_FALSE(s.assign("123456789"));
+  // Значение обрезано, но вызывающий узнаёт об этом и отклоняет его
+  TEST_ASSERT_EQUAL_STRING("12345678", s.c_str());
+}
+
+void test_import_accepts_strings_at_capacity() {
+  Config imported;
+  String json = "{\"ssid\":\"" + repeat('s', 32) + "\",\"buttons\":[{\"name\":\"" + repeat('n', 32) +
+                "\",\"topic\":\"" + repeat('t', 96) + "\",\"pin\":4,\"duration\":100,\"mode\":3}]}";
+  TEST_ASSERT_TRUE(importJson(json, imported));
+  TEST_ASSERT_EQUAL(32, imported.ssid.length());
+  TEST_ASSERT_EQUAL(96, imported.buttons[0].topic.length());
+}
+
+// Каждое строковое поле: на символ длиннее ёмкости - импорт отклонён
+void test_import_rejects_overlong_strings() {
+  const String cases[] = {
+    "{\"ssid\":\"" + repeat('s', 33) + "\"}",
+    "{\"password\":\"" + repeat('p', 65) + "\"}",
+    "{\"mqtt_server\":\"" + repeat('m', 65) + "\"}",
+    "{\"mqtt_user\":\"" + repeat('u', 33) + "\"}",
+    "{\"mqtt_password\":\"" + repeat('p', 65) + "\"}",
+    "{\"update_url\":\"" + repeat('h', 129) + "\"}",
+    "{\"ota_group\":\"" + repeat('g', 33) + "\"}",
+    "{\"buttons\":[{\"name\":\"" + repeat('n', 33) + "\",\"topic\":\"a\"}]}",
+    "{\"buttons\":[{\"name\":\"a\",\"topic\":\"" + repeat('t', 97) + "\"}]}",
+    "{\"sensors\":[{\"name\":\"" + repeat('n', 33) + "\"}]}",
+    "{\"macros\":[{\"name\":\"" + repeat('n', 33) + "\"}]}",
+    "{\"macros\":[{\"name\":\"m\",\"topic\":\"" + repeat('t', 97) + "\"}]}",
+    "{\"macros\":[{\"name\":\"m\",\"script\":\"" + repeat('w', 257) + "\"}]}",
+  };
+  for (const String &json : cases) {
+    Config imported;
+    TEST_ASSERT_FALSE_MESSAGE(importJson(json, imported), json.substring(0, 40).c_str());
+  }
+}
+
+// Старый config.json переносится и с длинными строками: лучше обрезанное
+// имя, чем потерянные настройки сети
+void test_legacy_migration_truncates() {
+  String json = "{\"ssid\":\"home\",\"buttons\":[{\"name\":\"" + repeat('n', 40) +
+                "\",\"topic\":\"home/a\",\"pin\":4,\"duration\":100,\"mode\":3}]}";
+  hal::fileWrite("/config.json", (const uint8_t *)json.c_str(), json.length());
+  ConfigStore store;
+  Config loaded;
+  TEST_ASSERT_TRUE(store.load(loaded));
+  TEST_ASSERT_EQUAL_STRING("home", loaded.ssid.c_str());
+  TEST_ASSERT_EQUAL(32, loaded.buttons[0].name.length());
+  TEST_ASSERT_FALSE(hal::fileExists("/config.json"));
+}
+
+// Круг работы платы: правка конфигурации как в handleSaveConfig, запись,
+// чтение, команды MQTT и отрисовка состояния. После прогрева число живых
+// блоков не меняется от круга к кругу, горячие пути не выделяют память.
+void test_heap_soak() {
+  Config config;
+  fillConfig(config);
+  ConfigStore store;
+  Config loaded;
+  NullPrint out;
+  uint32_t hotAllocs = 0, dispatched = 0, baseline = 0, maxLive = 0, minLive = UINT32_MAX;
+  const uint8_t payload[] = "{\"action\":\"on\",\"duration\":50}";
+
+  for (uint32_t round = 0; round < soakRounds; round++) {
+    {
+      Config *updated = new Config(config);
+      String name = "renamed-" + String(round % 100);
+      TEST_ASSERT_TRUE(updated->buttons[round % CONFIG_MAX_BUTTONS].name.assign(name.c_str(), name.length()));
+      String password = String("pw-") + String(round);
+      TEST_ASSERT_TRUE(updated->password.assign(password.c_str(), password.length()));
+      TEST_ASSERT_TRUE(store.save(*updated));
+      config = *updated;
+      delete updated;
+    }
+    TEST_ASSERT_TRUE(store.load(loaded));
+    topicIndex.build(loaded.buttons);
+
+    uint32_t before = host::allocations();
+    char topic[64];
+    snprintf(topic, sizeof(topic), "home/soak/button-%02u/set", (unsigned)(round % CONFIG_MAX_BUTTONS));
+    uint8_t matches[TOPIC_MATCH_MAX];
+    size_t n = topicIndex.match(topic, matches, TOPIC_MATCH_MAX);
+    for (size_t i = 0; i < n; i++) {
+      const ButtonConfig &button = loaded.buttons[matches[i]];
+      MqttCommand cmd = parseCommand(payload, sizeof(payload) - 1, button.duration);
+      ActuationCommand command = {ActuationCommand::PULSE, (uint8_t)button.pin, (uint32_t)cmd.duration, 0};
+      ActuationCommand taken;
+      if (enqueueActuation(command) && actuationQueue.pop(taken)) dispatched++;
+    }
+    JsonWriter json(out);
+    json.beginObject().beginArray("outputs");
+    for (size_t i = 0; i < loaded.buttons.size(); i++) {
+      json.beginObject().field("id", i).field("name", loaded.buttons[i].name.c_str()).endObject();
+    }
+    json.endArray().endObject();
+    hotAllocs += host::allocations() - before;
+
+    // Первые круги заполняют оба слота хранилища в файловой системе
+    uint32_t live = host::liveBlocks();
+    if (round < 2) continue;
+    if (round == 2) baseline = live;
+    if (live > maxLive) maxLive = live;
+    if (live < minLive) minLive = live;
+  }
+  printf("soak rounds=%u live=%u..%u baseline=%u\n", (unsigned)soakRounds, (unsigned)minLive,
+         (unsigned)maxLive, (unsigned)baseline);
+  TEST_ASSERT_EQUAL(soakRounds, dispatched);
+  TEST_ASSERT_EQUAL(0, hotAllocs);
+  TEST_ASSERT_EQUAL(baseline, maxLive);
+  TEST_ASSERT_EQUAL(baseline, minLive);
+  TEST_ASSERT_EQUAL_STRING(config.password.c_str(), loaded.password.c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_assign_reports_overflow);
+  RUN_TEST(test_import_accepts_strings_at_capacity);
+  RUN_TEST(test_import_rejects_overlong_strings);
+  RUN_TEST(test_legacy_migration_truncates);
+  RUN_TEST(test_heap_soak);
+  return UNITY_END();
+}
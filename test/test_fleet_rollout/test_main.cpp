@@ -0,0 +1,287 @@
+// Раскатка прошивки целиком на хосте: команда приходит как из MQTT,
+// образ качается OtaJob с локального HTTP-сервера, статусы уходят в
+// брокер в памяти, итог установки читается из /rollout.state "после
+// перезагрузки" новым экземпляром FleetRollout.
+#include <unity.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "fleet_rollout.h"
+#include "hal_host.h"
+#include "host_http.h"
+#include "ota_job.h"
+#include "version.h"
+
+static HostHttpServer server;
+static HostTransport broker;
+static std::vector<uint8_t> image;
+static std::string imageHash;
+
+static bool publishToBroker(const char *topic, const char *payload, bool retained) {
+  return broker.publish(topic, payload, retained);
+}
+
+static std::string sha256Hex(const std::vector<uint8_t> &data) {
+  mbedtls_sha256_context ctx;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, data.data(), data.size());
+  mbedtls_sha256_finish(&ctx, digest);
+  char hex[65];
+  for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  return hex;
+}
+
+static std::string announcement(const char *version, unsigned long window, const std::string &hash) {
+  char text[512];
+  snprintf(text, sizeof(text), "{\"version\":\"%s\",\"url\":\"%s\",\"sha256\":\"%s\",\"window\":%lu}", version,
+           server.url("/firmware.bin").c_str(), hash.c_str(), window);
+  return text;
+}
+
+static void announce(FleetRollout &rollout, const std::string &payload) {
+  rollout.announce((const uint8_t *)payload.data(), payload.size(), hal::millis());
+}
+
+// Сетевая задача крутит loop(); загрузка идёт в своём потоке по реальному
+// времени, поэтому ожидание ограничено реальным временем
+static void loopUntil(FleetRollout &rollout, FleetRollout::State state) {
+  for (int i = 0; i < 20000 && rollout.status(hal::millis()).state != state; i++) {
+    rollout.loop(hal::millis(), broker.connected());
+    host::advanceMillis(10);
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  rollout.loop(hal::millis(), broker.connected());
+  TEST_ASSERT_EQUAL_STRING(FleetRollout::stateName(state), FleetRollout::stateName(rollout.status(hal::millis()).state));
+}
+
+// Задача OTA перезагружает плату через секунду после DONE
+static void waitForRestart(uint32_t before) {
+  for (int i = 0; i < 2000 && host::restarts() == before; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  TEST_ASSERT_EQUAL(before + 1, host::restarts());
+}
+
+// Статусы, опубликованные в pcc/<id>/ota/status, по порядку
+static std::vector<std::string> statuses() {
+  std::vector<std::string> result;
+  for (const HostTransport::Message &message : broker.published) {
+    TEST_ASSERT_EQUAL_STRING("pcc/pcc-test/ota/status", message.topic.c_str());
+    TEST_ASSERT_TRUE(message.retained);
+    result.push_back(message.payload);
+  }
+  return result;
+}
+
+static bool contains(const std::string &text, const char *part) {
+  return text.find(part) != std::string::npos;
+}
+
+void setUp() {
+  host::setMillis(1000);
+  host::clearFiles();
+  broker = HostTransport();
+  broker.connect("pcc-test", "", "");
+}
+
+void tearDown() {
+}
+
+void test_topics() {
+  FleetRollout rollout;
+  rollout.begin("pcc-test", publishToBroker);
+  rollout.setGroup("hall");
+  TEST_ASSERT_TRUE(rollout.matches("pcc/pcc-test/ota"));
+  TEST_ASSERT_TRUE(rollout.matches("pcc/group/hall/ota"));
+  TEST_ASSERT_FALSE(rollout.matches("pcc/group/yard/ota"));
+  rollout.setGroup("");
+  TEST_ASSERT_FALSE(rollout.matches("pcc/group/hall/ota"));
+}
+
+// Версия не новее текущей отклоняется без загрузки
+void test_refuses_old_version() {
+  FleetRollout rollout;
+  rollout.begin("pcc-test", publishToBroker);
+  size_t requests = server.ranges().size();
+  announce(rollout, announcement(FIRMWARE_VERSION, 0, imageHash));
+  rollout.loop(hal::millis(), true);
+  FleetRollout::Status status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::REFUSED, status.state);
+  TEST_ASSERT_EQUAL_STRING("not newer than " FIRMWARE_VERSION, status.error);
+
+  announce(rollout, announcement("0.0.0", 0, imageHash));
+  rollout.loop(hal::millis(), true);
+  TEST_ASSERT_EQUAL(FleetRollout::REFUSED, rollout.status(hal::millis()).state);
+  TEST_ASSERT_EQUAL(requests, server.ranges().size());
+  TEST_ASSERT_FALSE(hal::fileExists("/rollout.state"));
+  std::vector<std::string> published = statuses();
+  TEST_ASSERT_EQUAL(2, published.size());
+  TEST_ASSERT_TRUE(contains(published[0], "\"state\":\"refused\""));
+  TEST_ASSERT_TRUE(contains(published[0], "\"current\":\"" FIRMWARE_VERSION "\""));
+}
+
+void test_invalid_announcement() {
+  FleetRollout rollout;
+  rollout.begin("pcc-test", publishToBroker);
+  announce(rollout, "{\"version\":\"9.9.9\",\"url\":\"http://x/\",\"sha256\":\"abc\"}");
+  FleetRollout::Status status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::FAILED, status.state);
+  TEST_ASSERT_EQUAL_STRING("invalid announcement", status.error);
+  // Версия с кавычкой сломала бы JSON статуса
+  announce(rollout, announcement("9.9\\\"9", 0, imageHash));
+  status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::FAILED, status.state);
+  TEST_ASSERT_EQUAL_STRING("invalid announcement", status.error);
+  // Хэш нужной длины, но не hex, отклоняется сразу, а не при загрузке
+  std::string notHex = imageHash;
+  notHex[0] = 'z';
+  announce(rollout, announcement("9.9.9", 0, notHex));
+  status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::FAILED, status.state);
+  TEST_ASSERT_EQUAL_STRING("invalid announcement", status.error);
+}
+
+// Слот пришёл во время загрузки из браузера: раскатка ждёт, а не падает
+// с чужой причиной, и не оставляет файла состояния
+void test_browser_upload_defers_slot() {
+  FleetRollout rollout;
+  rollout.begin("pcc-test", publishToBroker);
+  size_t requests = server.ranges().size();
+  TEST_ASSERT_TRUE(Update.begin(UPDATE_SIZE_UNKNOWN));
+  announce(rollout, announcement("9.9.9", 0, imageHash));
+  rollout.loop(hal::millis(), true);
+  FleetRollout::Status status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::SCHEDULED, status.state);
+  TEST_ASSERT_EQUAL(ROLLOUT_RETRY_MS, status.slotIn);
+  TEST_ASSERT_FALSE(hal::fileExists("/rollout.state"));
+  TEST_ASSERT_EQUAL(requests, server.ranges().size());
+  Update.abort();
+}
+
+// Полный цикл: 9.9.9 с нулевым окном качается сразу, после загрузки
+// устройство перезагружается, а после перезагрузки всё ещё 0.0.1 - значит
+// загрузчик откатился, и итог установки - FAILED
+void test_rollout_reboot_and_report() {
+  uint32_t restarts = host::restarts();
+  std::string command = announcement("9.9.9", 0, imageHash);
+  {
+    FleetRollout rollout;
+    rollout.begin("pcc-test", publishToBroker);
+    announce(rollout, command);
+    TEST_ASSERT_EQUAL(FleetRollout::SCHEDULED, rollout.status(hal::millis()).state);
+    rollout.loop(hal::millis(), true);
+    TEST_ASSERT_EQUAL(FleetRollout::DOWNLOADING, rollout.status(hal::millis()).state);
+    TEST_ASSERT_TRUE(hal::fileExists("/rollout.state"));
+    loopUntil(rollout, FleetRollout::REBOOTING);
+    waitForRestart(restarts);
+    TEST_ASSERT_TRUE(Update.image() == image);
+
+    std::vector<std::string> published = statuses();
+    TEST_ASSERT_GREATER_OR_EQUAL(2, published.size());
+    TEST_ASSERT_TRUE(contains(published.front(), "\"state\":\"downloading\""));
+    TEST_ASSERT_TRUE(contains(published.front(), "\"version\":\"9.9.9\""));
+    TEST_ASSERT_TRUE(contains(published.back(), "\"state\":\"rebooting\""));
+    char total[32];
+    snprintf(total, sizeof(total), "\"total\":%u", (unsigned)image.size());
+    TEST_ASSERT_TRUE(contains(published.back(), total));
+  }
+
+  broker = HostTransport();
+  broker.connect("pcc-test", "", "");
+  FleetRollout rebooted;
+  rebooted.begin("pcc-test", publishToBroker);
+  FleetRollout::Status status = rebooted.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::FAILED, status.state);
+  TEST_ASSERT_EQUAL_STRING("running " FIRMWARE_VERSION " after install", status.error);
+  TEST_ASSERT_EQUAL_STRING("9.9.9", status.version);
+  TEST_ASSERT_FALSE(hal::fileExists("/rollout.state"));
+  rebooted.loop(hal::millis(), true);
+  std::vector<std::string> published = statuses();
+  TEST_ASSERT_EQUAL(1, published.size());
+  TEST_ASSERT_TRUE(contains(published[0], "\"state\":\"failed\""));
+
+  // Та же команда, снова пришедшая retained, не запускает загрузку повторно
+  announce(rebooted, command);
+  TEST_ASSERT_EQUAL(FleetRollout::FAILED, rebooted.status(hal::millis()).state);
+}
+
+// Файл состояния с версией, которая и запущена, - установка удалась
+void test_installed_after_reboot() {
+  uint32_t restarts = host::restarts();
+  {
+    FleetRollout rollout;
+    rollout.begin("pcc-test", publishToBroker);
+    announce(rollout, announcement("9.9.9", 0, imageHash));
+    rollout.loop(hal::millis(), true);
+    loopUntil(rollout, FleetRollout::REBOOTING);
+    waitForRestart(restarts);
+  }
+  // Новая прошивка - это та версия, что записана в файл
+  std::vector<uint8_t> record;
+  TEST_ASSERT_TRUE(hal::fileRead("/rollout.state", record));
+  const size_t versionAt = 8, versionSize = 24;
+  TEST_ASSERT_EQUAL(versionAt + versionSize, record.size());
+  TEST_ASSERT_EQUAL_STRING("9.9.9", (const char *)record.data() + versionAt);
+  memset(record.data() + versionAt, 0, versionSize);
+  memcpy(record.data() + versionAt, FIRMWARE_VERSION, strlen(FIRMWARE_VERSION));
+  hal::fileWrite("/rollout.state", record.data(), record.size());
+
+  FleetRollout rebooted;
+  rebooted.begin("pcc-test", publishToBroker);
+  FleetRollout::Status status = rebooted.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::INSTALLED, status.state);
+  TEST_ASSERT_EQUAL_STRING("", status.error);
+  TEST_ASSERT_EQUAL_STRING(FIRMWARE_VERSION, status.version);
+}
+
+// Окно раскатки: загрузка начинается в слоте внутри окна, не раньше
+void test_window_delays_download() {
+  FleetRollout rollout;
+  rollout.begin("pcc-test", publishToBroker);
+  size_t requests = server.ranges().size();
+  announce(rollout, announcement("9.9.10", 600, "0" + imageHash.substr(1)));
+  FleetRollout::Status status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL(FleetRollout::SCHEDULED, status.state);
+  TEST_ASSERT_LESS_THAN(600000, status.slotIn);
+  unsigned long slot = status.slotIn;
+  if (slot > 10) {
+    host::advanceMillis(slot - 10);
+    rollout.loop(hal::millis(), true);
+    TEST_ASSERT_EQUAL(FleetRollout::SCHEDULED, rollout.status(hal::millis()).state);
+  }
+  host::advanceMillis(10);
+  rollout.loop(hal::millis(), true);
+  TEST_ASSERT_EQUAL(FleetRollout::DOWNLOADING, rollout.status(hal::millis()).state);
+  // Хэш намеренно неверный: загрузка проваливается, файл состояния удаляется
+  loopUntil(rollout, FleetRollout::FAILED);
+  status = rollout.status(hal::millis());
+  TEST_ASSERT_EQUAL_STRING("SHA-256 mismatch", status.error);
+  TEST_ASSERT_FALSE(hal::fileExists("/rollout.state"));
+  TEST_ASSERT_EQUAL(requests + 1, server.ranges().size());
+}
+
+int main() {
+  host::seedRandom(22);
+  image.resize(30000);
+  for (uint8_t &b : image) b = esp_random();
+  image[0] = 0xe9;
+  imageHash = sha256Hex(image);
+  server.serve("/firmware.bin", image);
+  if (!server.start()) return 1;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_topics);
+  RUN_TEST(test_refuses_old_version);
+  RUN_TEST(test_invalid_announcement);
+  RUN_TEST(test_browser_upload_defers_slot);
+  RUN_TEST(test_rollout_reboot_and_report);
+  RUN_TEST(test_installed_after_reboot);
+  RUN_TEST(test_window_delays_download);
+  int failures = UNITY_END();
+  server.stop();
+  return failures;
+}
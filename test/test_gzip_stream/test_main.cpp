@@ -0,0 +1,230 @@
+// Распаковка GzipStream против потоков, сжатых zlib: вывод сверяется с
+// исходником байт в байт при подаче входа порциями любой длины, в том
+// числе с необязательными полями заголовка gzip и повреждёнными потоками.
+#include <unity.h>
+#include <zlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "gzip_stream.h"
+#include "hal_host.h"
+
+static std::vector<uint8_t> original;
+
+struct HeaderFields {
+  bool extra;
+  bool name;
+  bool comment;
+  bool hcrc;
+};
+
+// Сжатие в формат gzip (windowBits 31) с заданными полями заголовка
+static std::vector<uint8_t> compress(const std::vector<uint8_t> &data, HeaderFields fields, int level = 6) {
+  z_stream zs = {};
+  TEST_ASSERT_EQUAL(Z_OK, deflateInit2(&zs, level, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY));
+  static uint8_t extra[300];
+  for (size_t i = 0; i < sizeof(extra); i++) extra[i] = i * 7;
+  static char name[] = "firmware.bin";
+  static char comment[] = "pcc build for lolin_s2_mini";
+  gz_header header = {};
+  header.os = 3;
+  if (fields.extra) {
+    header.extra = extra;
+    header.extra_len = sizeof(extra);
+  }
+  if (fields.name) header.name = (Bytef *)name;
+  if (fields.comment) header.comment = (Bytef *)comment;
+  header.hcrc = fields.hcrc;
+  TEST_ASSERT_EQUAL(Z_OK, deflateSetHeader(&zs, &header));
+
+  std::vector<uint8_t> out(deflateBound(&zs, data.size()) + 1024);
+  zs.next_in = (Bytef *)data.data();
+  zs.avail_in = data.size();
+  zs.next_out = out.data();
+  zs.avail_out = out.size();
+  TEST_ASSERT_EQUAL(Z_STREAM_END, deflate(&zs, Z_FINISH));
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+struct Result {
+  bool ok;
+  bool finished;
+  std::string error;
+  std::vector<uint8_t> output;
+};
+
+static Result inflate(const std::vector<uint8_t> &gz, size_t chunk) {
+  Result result;
+  GzipStream stream;
+  TEST_ASSERT_TRUE(stream.begin([&](uint8_t *data, size_t len) {
+    result.output.insert(result.output.end(), data, data + len);
+    return true;
+  }));
+  result.ok = true;
+  for (size_t offset = 0; offset < gz.size() && result.ok; offset += chunk) {
+    size_t len = std::min(chunk, gz.size() - offset);
+    result.ok = stream.write(gz.data() + offset, len);
+  }
+  result.finished = stream.finished();
+  result.error = stream.error() ? stream.error() : "";
+  return result;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_is_gzip() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  TEST_ASSERT_TRUE(GzipStream::isGzip(gz.data(), gz.size()));
+  TEST_ASSERT_FALSE(GzipStream::isGzip(original.data(), original.size()));
+  TEST_ASSERT_FALSE(GzipStream::isGzip(gz.data(), 1));
+}
+
+// Все сочетания FEXTRA/FNAME/FCOMMENT/FHCRC, вход целиком
+void test_header_fields() {
+  for (int mask = 0; mask < 16; mask++) {
+    HeaderFields fields = {(mask & 1) != 0, (mask & 2) != 0, (mask & 4) != 0, (mask & 8) != 0};
+    std::vector<uint8_t> gz = compress(original, fields);
+    Result result = inflate(gz, gz.size());
+    TEST_ASSERT_TRUE_MESSAGE(result.ok, result.error.c_str());
+    TEST_ASSERT_TRUE(result.finished);
+    TEST_ASSERT_TRUE(result.output == original);
+  }
+}
+
+// Порции от 1 байта: границы порций приходятся на каждое поле заголовка,
+// на тело и на хвост с CRC и размером
+void test_chunk_sizes() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{true, true, true, true});
+  const size_t chunks[] = {1, 2, 3, 5, 7, 10, 11, 13, 64, 333, 1024, 4096, 32768, 65537};
+  for (size_t chunk : chunks) {
+    Result result = inflate(gz, chunk);
+    char message[64];
+    snprintf(message, sizeof(message), "chunk %u: %s", (unsigned)chunk, result.error.c_str());
+    TEST_ASSERT_TRUE_MESSAGE(result.ok, message);
+    TEST_ASSERT_TRUE_MESSAGE(result.finished, message);
+    TEST_ASSERT_EQUAL(original.size(), result.output.size());
+    TEST_ASSERT_TRUE_MESSAGE(result.output == original, message);
+  }
+}
+
+// Без сжатия (level 0) и с максимальным: stored- и huffman-блоки
+void test_compression_levels() {
+  for (int level : {0, 1, 9}) {
+    std::vector<uint8_t> gz = compress(original, HeaderFields{false, true, false, false}, level);
+    Result result = inflate(gz, 1500);
+    TEST_ASSERT_TRUE_MESSAGE(result.ok, result.error.c_str());
+    TEST_ASSERT_TRUE(result.output == original);
+  }
+}
+
+void test_empty_payload() {
+  std::vector<uint8_t> gz = compress(std::vector<uint8_t>(), HeaderFields{false, true, false, false});
+  Result result = inflate(gz, 1);
+  TEST_ASSERT_TRUE(result.ok);
+  TEST_ASSERT_TRUE(result.finished);
+  TEST_ASSERT_EQUAL(0, result.output.size());
+}
+
+void test_corrupt_crc() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  gz[gz.size() - 8] ^= 0x01;
+  Result result = inflate(gz, 4096);
+  TEST_ASSERT_FALSE(result.ok);
+  TEST_ASSERT_FALSE(result.finished);
+  TEST_ASSERT_EQUAL_STRING("gzip CRC mismatch", result.error.c_str());
+}
+
+void test_corrupt_size() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  gz[gz.size() - 1] ^= 0x01;
+  Result result = inflate(gz, 4096);
+  TEST_ASSERT_FALSE(result.ok);
+  TEST_ASSERT_EQUAL_STRING("gzip size mismatch", result.error.c_str());
+}
+
+// Порча тела: либо ошибка deflate, либо не сойдётся CRC - но не успех
+void test_corrupt_body() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  for (size_t i = 20; i < 60; i++) gz[i] ^= 0x5a;
+  Result result = inflate(gz, 4096);
+  TEST_ASSERT_FALSE(result.ok);
+  TEST_ASSERT_FALSE(result.finished);
+}
+
+// Оборванный поток: ошибки нет, но и завершения нет - вызывающий
+// (загрузка прошивки) сам отвергает образ
+void test_truncated_stream() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{true, true, false, false});
+  const size_t cuts[] = {5, 12, gz.size() / 2, gz.size() - 8, gz.size() - 1};
+  for (size_t cut : cuts) {
+    std::vector<uint8_t> partial(gz.begin(), gz.begin() + cut);
+    Result result = inflate(partial, 777);
+    TEST_ASSERT_TRUE(result.ok);
+    TEST_ASSERT_FALSE(result.finished);
+    TEST_ASSERT_TRUE(result.output.size() <= original.size());
+    TEST_ASSERT_TRUE(std::equal(result.output.begin(), result.output.end(), original.begin()));
+  }
+}
+
+void test_not_deflate() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  gz[2] = 7;
+  Result result = inflate(gz, 3);
+  TEST_ASSERT_FALSE(result.ok);
+  TEST_ASSERT_EQUAL_STRING("Not a gzip deflate stream", result.error.c_str());
+}
+
+void test_sink_failure_stops_stream() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  GzipStream stream;
+  size_t calls = 0;
+  stream.begin([&](uint8_t *, size_t) { return ++calls < 2; });
+  TEST_ASSERT_FALSE(stream.write(gz.data(), gz.size()));
+  TEST_ASSERT_EQUAL_STRING("Output write failed", stream.error());
+  TEST_ASSERT_EQUAL(2, calls);
+}
+
+// Данные после хвоста (например, выравнивание при загрузке) не мешают
+void test_trailing_bytes_ignored() {
+  std::vector<uint8_t> gz = compress(original, HeaderFields{false, false, false, false});
+  gz.insert(gz.end(), 100, 0xff);
+  Result result = inflate(gz, 999);
+  TEST_ASSERT_TRUE(result.ok);
+  TEST_ASSERT_TRUE(result.finished);
+  TEST_ASSERT_TRUE(result.output == original);
+}
+
+int main() {
+  // Сжимаемый текст вперемешку со случайными блоками, больше словаря 32 КБ
+  host::seedRandom(10);
+  for (int block = 0; original.size() < 150000; block++) {
+    if (block % 3 == 2) {
+      for (int i = 0; i < 2000; i++) original.push_back(esp_random());
+    } else {
+      char line[80];
+      int n = snprintf(line, sizeof(line), "pulse %d 250; wait %d; line %d\n", block % 16, block * 7, block);
+      for (int r = 0; r < 20; r++) original.insert(original.end(), line, line + n);
+    }
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(test_is_gzip);
+  RUN_TEST(test_header_fields);
+  RUN_TEST(test_chunk_sizes);
+  RUN_TEST(test_compression_levels);
+  RUN_TEST(test_empty_payload);
+  RUN_TEST(test_corrupt_crc);
+  RUN_TEST(test_corrupt_size);
+  RUN_TEST(test_corrupt_body);
+  RUN_TEST(test_truncated_stream);
+  RUN_TEST(test_not_deflate);
+  RUN_TEST(test_sink_failure_stops_stream);
+  RUN_TEST(test_trailing_bytes_ignored);
+  return UNITY_END();
+}
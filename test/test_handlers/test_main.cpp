@@ -0,0 +1,92 @@
+// Обработчики из handlers.cpp без веб-сервера: ответы /trigger и команды,
+// которые они ставят в очередь задачи actuation.
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "hal_host.h"
+#include "handlers.h"
+#include "pulse_scheduler.h"
+#include "tasks.h"
+#include "topic_index.h"
+
+#define OUTPUT_PIN 12
+
+static char message[64];
+
+static std::vector<ActuationCommand> takeCommands() {
+  std::vector<ActuationCommand> commands;
+  ActuationCommand command;
+  while (actuationQueue.pop(command)) commands.push_back(command);
+  return commands;
+}
+
+static int trigger(const char *pin, const char *duration) {
+  return handleTrigger(pin, duration, message, sizeof(message));
+}
+
+void setUp() {
+  host::setMillis(1000);
+  pulses.clear();
+  pulses.addPin(OUTPUT_PIN);
+  takeCommands();
+}
+
+void tearDown() {
+}
+
+void test_trigger_queues_pulse() {
+  TEST_ASSERT_EQUAL(200, trigger("12", "250"));
+  TEST_ASSERT_EQUAL_STRING("PIN 12 Triggered for 250 ms", message);
+  std::vector<ActuationCommand> commands = takeCommands();
+  TEST_ASSERT_EQUAL(1, commands.size());
+  TEST_ASSERT_EQUAL(ActuationCommand::PULSE, commands[0].action);
+  TEST_ASSERT_EQUAL(OUTPUT_PIN, commands[0].pin);
+  TEST_ASSERT_EQUAL(250, commands[0].duration);
+}
+
+// Прежний toInt() превращал "-5" в импульс почти на 50 суток, а "abc" - в нулевой
+void test_trigger_rejects_bad_duration() {
+  const char *bad[] = {"0", "-5", "+5", "abc", "", "12x", " 5", "5 "};
+  for (const char *duration : bad) {
+    TEST_ASSERT_EQUAL_MESSAGE(400, trigger("12", duration), duration);
+  }
+  TEST_ASSERT_EQUAL_STRING("Invalid duration '5 '", message);
+  TEST_ASSERT_EQUAL(0, takeCommands().size());
+}
+
+// Предел тот же, что у команд MQTT
+void test_trigger_caps_duration() {
+  TEST_ASSERT_EQUAL(200, trigger("12", "600000"));
+  TEST_ASSERT_EQUAL(200, trigger("12", "99999999999999999999999"));
+  char expected[64];
+  snprintf(expected, sizeof(expected), "PIN 12 Triggered for %d ms", MQTT_PULSE_MAX);
+  TEST_ASSERT_EQUAL_STRING(expected, message);
+  std::vector<ActuationCommand> commands = takeCommands();
+  TEST_ASSERT_EQUAL(2, commands.size());
+  TEST_ASSERT_EQUAL(MQTT_PULSE_MAX, commands[0].duration);
+  TEST_ASSERT_EQUAL(MQTT_PULSE_MAX, commands[1].duration);
+  const uint8_t payload[] = "600000";
+  TEST_ASSERT_EQUAL(MQTT_PULSE_MAX, parseCommand(payload, sizeof(payload) - 1, 100).duration);
+}
+
+void test_trigger_rejects_bad_pin() {
+  TEST_ASSERT_EQUAL(404, trigger("13", "100"));
+  TEST_ASSERT_EQUAL_STRING("PIN 13 is not an output button", message);
+  TEST_ASSERT_EQUAL(400, trigger("abc", "100"));
+  TEST_ASSERT_EQUAL_STRING("Invalid pin 'abc'", message);
+  TEST_ASSERT_EQUAL(400, trigger("268", "100"));
+  TEST_ASSERT_EQUAL(400, trigger(nullptr, "100"));
+  TEST_ASSERT_EQUAL(400, trigger("12", nullptr));
+  TEST_ASSERT_EQUAL_STRING("Invalid parameters", message);
+  TEST_ASSERT_EQUAL(0, takeCommands().size());
+}
+
+int main() {
+  host::muteSerial(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_trigger_queues_pulse);
+  RUN_TEST(test_trigger_rejects_bad_duration);
+  RUN_TEST(test_trigger_caps_duration);
+  RUN_TEST(test_trigger_rejects_bad_pin);
+  return UNITY_END();
+}
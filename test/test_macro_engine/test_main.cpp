@@ -0,0 +1,218 @@
+// Компиляция макросов и их исполнение на ручных часах: импульсы идут
+// через общий планировщик pulses с записью фронтов, входы - через
+// inputs и прерывание host::setInput().
+#include <unity.h>
+#include <vector>
+#include "hal_host.h"
+#include "macro_engine.h"
+#include "pulse_scheduler.h"
+#include "input_engine.h"
+
+#define RELAY_PIN 12
+#define DOOR_PIN 14
+#define DOOR_DEBOUNCE 20
+
+struct Edge {
+  uint8_t pin;
+  uint8_t level;
+  unsigned long at;
+};
+
+static std::vector<Edge> edges;
+
+static void recordWrite(uint8_t pin, uint8_t level) {
+  edges.push_back(Edge{pin, level, hal::millis()});
+}
+
+// Такты задачи actuation до момента until: планировщик, входы, макросы
+static void runUntil(unsigned long until) {
+  while (hal::millis() + PULSE_TICK_MS <= until) {
+    host::advanceMillis(PULSE_TICK_MS);
+    unsigned long now = hal::millis();
+    pulses.service(now);
+    inputs.loop(now);
+    macroEngine.loop(now);
+  }
+}
+
+static void addButton(const char *name, int pin, int mode) {
+  ButtonConfig button = {};
+  button.name = name;
+  button.pin = pin;
+  button.duration = 200;
+  button.mode = mode;
+  button.debounce = DOOR_DEBOUNCE;
+  config.buttons.push_back(button);
+}
+
+static bool compile(const char *script, MacroProgram &program) {
+  MacroConfig macro = {};
+  macro.name = "test";
+  macro.script = script;
+  return compileMacro(config, macro, program);
+}
+
+// Текст ошибки компиляции; пустой, если скрипт скомпилировался
+static const char *compileError(const char *script) {
+  static MacroProgram program;
+  compile(script, program);
+  return program.error;
+}
+
+void setUp() {
+  host::setMillis(0);
+  edges.clear();
+  config = Config();
+  addButton("relay", RELAY_PIN, OUTPUT);
+  addButton("front door", DOOR_PIN, INPUT_PULLUP);
+}
+
+void tearDown() {
+}
+
+void test_compile_steps() {
+  MacroProgram program;
+  TEST_ASSERT_TRUE(compile("pulse relay; pulse relay 50\nwait 100; wait \"front door\" on 500;"
+                           " if \"FRONT DOOR\" off goto 1", program));
+  TEST_ASSERT_EQUAL(5, program.count);
+  TEST_ASSERT_EQUAL(MacroStep::PULSE, program.steps[0].op);
+  TEST_ASSERT_EQUAL(RELAY_PIN, program.steps[0].arg);
+  TEST_ASSERT_EQUAL(200, program.steps[0].ms);
+  TEST_ASSERT_EQUAL(50, program.steps[1].ms);
+  TEST_ASSERT_EQUAL(MacroStep::WAIT, program.steps[2].op);
+  TEST_ASSERT_EQUAL(MacroStep::WAIT_INPUT, program.steps[3].op);
+  TEST_ASSERT_EQUAL(1, program.steps[3].arg);
+  TEST_ASSERT_EQUAL(1, program.steps[3].state);
+  TEST_ASSERT_EQUAL(500, program.steps[3].ms);
+  TEST_ASSERT_EQUAL(MacroStep::BRANCH, program.steps[4].op);
+  TEST_ASSERT_EQUAL(0, program.steps[4].state);
+  TEST_ASSERT_EQUAL(0, program.steps[4].target);
+}
+
+// Переход вперёд разрешается после разбора всех шагов,
+// переход за последний шаг равен end
+void test_compile_branch_targets() {
+  MacroProgram program;
+  TEST_ASSERT_TRUE(compile("if \"front door\" on goto 3; pulse relay; if \"front door\" off goto end;"
+                           " if \"front door\" on goto 5", program));
+  TEST_ASSERT_EQUAL(2, program.steps[0].target);
+  TEST_ASSERT_EQUAL(MACRO_END, program.steps[2].target);
+  TEST_ASSERT_EQUAL(MACRO_END, program.steps[3].target);
+  TEST_ASSERT_EQUAL_STRING("step 2: no step 4", compileError("pulse relay; if \"front door\" on goto 4"));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad step number '0'",
+                           compileError("if \"front door\" on goto 0"));
+}
+
+void test_compile_errors() {
+  TEST_ASSERT_EQUAL_STRING("no steps", compileError(" ; \n "));
+  TEST_ASSERT_EQUAL_STRING("step 1: unknown step 'jump'", compileError("jump 5"));
+  TEST_ASSERT_EQUAL_STRING("step 2: 'front door' is not an output",
+                           compileError("wait 10; pulse \"front door\""));
+  TEST_ASSERT_EQUAL_STRING("step 1: 'relay' is not an input", compileError("wait relay on 100"));
+  TEST_ASSERT_EQUAL_STRING("step 1: 'front' is not an input", compileError("wait front door on"));
+  TEST_ASSERT_EQUAL_STRING("step 1: expected on/off, got 'open'",
+                           compileError("wait \"front door\" open 100"));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad timeout 'soon'", compileError("wait \"front door\" on soon"));
+  TEST_ASSERT_EQUAL_STRING("step 1: too many words",
+                           compileError("if \"front door\" on goto 1 now please"));
+}
+
+// Знак и переполнение не проходят: "wait -1" не должен превращаться в 49 суток
+void test_compile_rejects_signed_and_huge_numbers() {
+  TEST_ASSERT_EQUAL_STRING("step 1: bad delay '-1'", compileError("wait -1"));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad delay '+5'", compileError("wait +5"));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad delay ' 5'", compileError("wait \" 5\""));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad duration '-200'", compileError("pulse relay -200"));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad delay '4294967296'", compileError("wait 4294967296"));
+  TEST_ASSERT_EQUAL_STRING("step 1: bad step number '-1'",
+                           compileError("if \"front door\" on goto -1"));
+  MacroProgram program;
+  TEST_ASSERT_TRUE(compile("wait 4294967295", program));
+  TEST_ASSERT_EQUAL_UINT32(4294967295u, program.steps[0].ms);
+}
+
+void test_compile_step_limit() {
+  std::string script;
+  for (int i = 0; i < MACRO_MAX_STEPS; i++) script += "wait 1;";
+  MacroProgram program;
+  TEST_ASSERT_TRUE(compile(script.c_str(), program));
+  TEST_ASSERT_EQUAL(MACRO_MAX_STEPS, program.count);
+  script += "wait 1";
+  TEST_ASSERT_EQUAL_STRING("more than 16 steps", compileError(script.c_str()));
+}
+
+// Импульс, ожидание двери, переход: пока дверь закрыта, макрос
+// повторяет импульс; открытие двери завершает его
+void test_run_pulse_wait_branch() {
+  pulses.clear();
+  pulses.setWriter(recordWrite);
+  TEST_ASSERT_TRUE(pulses.addPin(RELAY_PIN));
+  edges.clear();
+  inputs.clear();
+  host::setInput(DOOR_PIN, HIGH);
+  TEST_ASSERT_TRUE(inputs.addPin(1, DOOR_PIN, DOOR_DEBOUNCE));
+
+  MacroConfig macro = {};
+  macro.name = "open gate";
+  macro.script = "pulse relay 100; wait \"front door\" off 300; wait 50; if \"front door\" off goto 1";
+  config.macros.push_back(macro);
+  macroEngine.load(config);
+  TEST_ASSERT_TRUE(macroEngine.valid(0));
+  TEST_ASSERT_TRUE(macroEngine.start(0, hal::millis()));
+  TEST_ASSERT_FALSE(macroEngine.start(0, hal::millis()));
+
+  // Первый импульс; дверь закрыта, после паузы переход на шаг 1
+  runUntil(150);
+  TEST_ASSERT_EQUAL(2, edges.size());
+  TEST_ASSERT_EQUAL(HIGH, edges[0].level);
+  TEST_ASSERT_EQUAL(LOW, edges[1].level);
+  TEST_ASSERT_EQUAL(100, edges[1].at - edges[0].at);
+  runUntil(270);
+  TEST_ASSERT_EQUAL(4, edges.size());
+  MacroEngine::Status status = macroEngine.status(0, hal::millis());
+  TEST_ASSERT_EQUAL(MacroEngine::RUNNING, status.result);
+  TEST_ASSERT_EQUAL(2, status.step);
+
+  // Дверь открылась во время паузы: переход не срабатывает
+  host::setInput(DOOR_PIN, LOW);
+  runUntil(600);
+  TEST_ASSERT_TRUE(inputs.state(1));
+  status = macroEngine.status(0, hal::millis());
+  TEST_ASSERT_EQUAL(MacroEngine::DONE, status.result);
+  TEST_ASSERT_EQUAL(1, status.runs);
+  TEST_ASSERT_EQUAL(4, edges.size());
+  TEST_ASSERT_FALSE(pulses.isActive(RELAY_PIN));
+}
+
+// Вход не пришёл за тайм-аут: макрос прерывается без новых импульсов
+void test_run_wait_input_timeout() {
+  pulses.clear();
+  pulses.setWriter(recordWrite);
+  TEST_ASSERT_TRUE(pulses.addPin(RELAY_PIN));
+  edges.clear();
+  inputs.clear();
+  host::setInput(DOOR_PIN, HIGH);
+  TEST_ASSERT_TRUE(inputs.addPin(1, DOOR_PIN, DOOR_DEBOUNCE));
+
+  MacroConfig macro = {};
+  macro.name = "wait door";
+  macro.script = "wait \"front door\" on 100; pulse relay";
+  config.macros.push_back(macro);
+  macroEngine.load(config);
+  TEST_ASSERT_TRUE(macroEngine.start(0, hal::millis()));
+  runUntil(300);
+  TEST_ASSERT_EQUAL(MacroEngine::TIMEOUT, macroEngine.status(0, hal::millis()).result);
+  TEST_ASSERT_EQUAL(0, edges.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_compile_steps);
+  RUN_TEST(test_compile_branch_targets);
+  RUN_TEST(test_compile_errors);
+  RUN_TEST(test_compile_rejects_signed_and_huge_numbers);
+  RUN_TEST(test_compile_step_limit);
+  RUN_TEST(test_run_pulse_wait_branch);
+  RUN_TEST(test_run_wait_input_timeout);
+  return UNITY_END();
+}
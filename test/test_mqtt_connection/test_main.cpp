@@ -0,0 +1,162 @@
+// Переподключение к MQTT против брокера в памяти (HostTransport) на ручных
+// часах: loop() вызывается как из главного цикла, каждые 10 мс.
+#include <unity.h>
+#include <vector>
+#include "hal_host.h"
+#include "mqtt_connection.h"
+
+static const unsigned long loopStep = 10;
+
+static HostTransport broker;
+static MqttConnection *connection;
+static std::vector<unsigned long> attemptTimes;
+
+static bool connectAndSubscribe() {
+  attemptTimes.push_back(hal::millis());
+  if (!broker.connect("pcc-test", "user", "secret")) return false;
+  broker.subscribe("home/hall/+/set");
+  return true;
+}
+
+// Один вызов loop() - не больше одной попытки подключения
+static void runFor(unsigned long ms) {
+  unsigned long until = hal::millis() + ms;
+  while (hal::millis() < until) {
+    size_t before = attemptTimes.size();
+    connection->loop(hal::millis());
+    TEST_ASSERT_LESS_OR_EQUAL(before + 1, attemptTimes.size());
+    host::advanceMillis(loopStep);
+  }
+}
+
+void setUp() {
+  host::setMillis(1000);
+  host::seedRandom(7);
+  broker = HostTransport();
+  attemptTimes.clear();
+  connection = new MqttConnection(broker);
+}
+
+void tearDown() {
+  delete connection;
+}
+
+void test_connects_on_first_loop() {
+  connection->begin(connectAndSubscribe);
+  TEST_ASSERT_EQUAL(MqttConnection::DISCONNECTED, connection->state());
+  runFor(loopStep);
+  TEST_ASSERT_EQUAL(MqttConnection::CONNECTED, connection->state());
+  TEST_ASSERT_EQUAL(1, connection->connects());
+  TEST_ASSERT_TRUE(broker.subscribed("home/hall/+/set"));
+  runFor(10000);
+  TEST_ASSERT_EQUAL(1, broker.connectCalls);
+}
+
+// Брокер недоступен: паузы растут вдвое от MQTT_BACKOFF_MIN до
+// MQTT_BACKOFF_MAX, каждая выбирается в [backoff/2, backoff)
+void test_backoff_doubles_up_to_cap() {
+  broker.accept = false;
+  connection->begin(connectAndSubscribe);
+  runFor(15UL * 60 * 1000);
+  TEST_ASSERT_GREATER_THAN(10, attemptTimes.size());
+  unsigned long backoff = MQTT_BACKOFF_MIN;
+  for (size_t i = 1; i < attemptTimes.size(); i++) {
+    unsigned long gap = attemptTimes[i] - attemptTimes[i - 1];
+    // Попытка идёт на первом проходе loop() после срока
+    TEST_ASSERT_GREATER_OR_EQUAL(backoff / 2, gap);
+    TEST_ASSERT_LESS_THAN(backoff + loopStep, gap);
+    if (backoff < MQTT_BACKOFF_MAX) backoff = min<unsigned long>(backoff * 2, MQTT_BACKOFF_MAX);
+  }
+  TEST_ASSERT_EQUAL(attemptTimes.size(), connection->failures());
+  TEST_ASSERT_EQUAL(MqttConnection::BACKOFF, connection->state());
+  TEST_ASSERT_LESS_OR_EQUAL(MQTT_BACKOFF_MAX, connection->retryIn(hal::millis()));
+}
+
+// Брокер поднялся: подключение на ближайшей попытке, счётчик неудач
+// подряд сбрасывается
+void test_recovers_when_broker_returns() {
+  broker.accept = false;
+  connection->begin(connectAndSubscribe);
+  runFor(20000);
+  TEST_ASSERT_GREATER_THAN(2, connection->streak());
+  broker.accept = true;
+  runFor(MQTT_BACKOFF_MAX);
+  TEST_ASSERT_EQUAL(MqttConnection::CONNECTED, connection->state());
+  TEST_ASSERT_EQUAL(0, connection->streak());
+  TEST_ASSERT_TRUE(broker.subscribed("home/hall/+/set"));
+}
+
+// Обрыв со стороны брокера: первая попытка через [MIN/2, MIN), подписки
+// восстанавливаются
+void test_reconnects_after_drop() {
+  connection->begin(connectAndSubscribe);
+  runFor(1000);
+  broker.drop();
+  TEST_ASSERT_FALSE(broker.subscribed("home/hall/+/set"));
+  unsigned long dropped = hal::millis();
+  runFor(5000);
+  TEST_ASSERT_EQUAL(2, attemptTimes.size());
+  unsigned long gap = attemptTimes[1] - dropped;
+  TEST_ASSERT_GREATER_OR_EQUAL(MQTT_BACKOFF_MIN / 2, gap);
+  TEST_ASSERT_LESS_THAN(MQTT_BACKOFF_MIN + 2 * loopStep, gap);
+  TEST_ASSERT_EQUAL(MqttConnection::CONNECTED, connection->state());
+  TEST_ASSERT_EQUAL(1, connection->disconnects());
+  TEST_ASSERT_EQUAL(2, connection->connects());
+  TEST_ASSERT_TRUE(broker.subscribed("home/hall/+/set"));
+}
+
+// Смена настроек: сессия закрывается, новая попытка без паузы даже
+// посреди длинного ожидания
+void test_manual_reconnect_skips_backoff() {
+  broker.accept = false;
+  connection->begin(connectAndSubscribe);
+  runFor(60000);
+  TEST_ASSERT_GREATER_THAN(1000, connection->retryIn(hal::millis()));
+  broker.accept = true;
+  connection->reconnect();
+  size_t before = attemptTimes.size();
+  runFor(loopStep);
+  TEST_ASSERT_EQUAL(before + 1, attemptTimes.size());
+  TEST_ASSERT_EQUAL(MqttConnection::CONNECTED, connection->state());
+
+  connection->reconnect();
+  TEST_ASSERT_FALSE(broker.connected());
+  TEST_ASSERT_EQUAL(1, connection->disconnects());
+  runFor(loopStep);
+  TEST_ASSERT_EQUAL(MqttConnection::CONNECTED, connection->state());
+}
+
+// Разброс пауз: устройства, потерявшие брокер одновременно, не приходят
+// к нему все в один момент
+void test_jitter_spreads_devices() {
+  const int devices = 32;
+  std::vector<HostTransport> brokers(devices);
+  std::vector<unsigned long> firstRetry;
+  for (int d = 0; d < devices; d++) {
+    host::setMillis(1000);
+    MqttConnection device(brokers[d]);
+    brokers[d].accept = false;
+    device.begin([]() { return false; });
+    device.loop(hal::millis());
+    firstRetry.push_back(device.retryIn(hal::millis()));
+  }
+  unsigned long lo = firstRetry[0], hi = firstRetry[0];
+  for (unsigned long retry : firstRetry) {
+    TEST_ASSERT_GREATER_OR_EQUAL(MQTT_BACKOFF_MIN / 2, retry);
+    TEST_ASSERT_LESS_THAN(MQTT_BACKOFF_MIN, retry);
+    lo = min(lo, retry);
+    hi = max(hi, retry);
+  }
+  TEST_ASSERT_GREATER_THAN(MQTT_BACKOFF_MIN / 4, hi - lo);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_connects_on_first_loop);
+  RUN_TEST(test_backoff_doubles_up_to_cap);
+  RUN_TEST(test_recovers_when_broker_returns);
+  RUN_TEST(test_reconnects_after_drop);
+  RUN_TEST(test_manual_reconnect_skips_backoff);
+  RUN_TEST(test_jitter_spreads_devices);
+  return UNITY_END();
+}
@@ -0,0 +1,182 @@
+#include <unity.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <chrono>
+#include <thread>
+#include "hal_host.h"
+#include "host_http.h"
+#include "ota_job.h"
+
+static HostHttpServer server;
+static std::vector<uint8_t> image;
+static String imageHash;
+
+static String sha256Hex(const std::vector<uint8_t> &data) {
+  mbedtls_sha256_context ctx;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, data.data(), data.size());
+  mbedtls_sha256_finish(&ctx, digest);
+  char hex[65];
+  for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  return String(hex);
+}
+
+// Ожидание конца загрузки по реальному времени: часы прошивки идут вручную
+static OtaJob::Status waitForJob() {
+  for (int i = 0; i < 20000 && otaJob.busy(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  TEST_ASSERT_FALSE_MESSAGE(otaJob.busy(), "OTA job did not finish");
+  return otaJob.status();
+}
+
+// После DONE задача ещё выжидает секунду и только потом перезагружает плату
+static uint32_t waitForRestart(uint32_t before) {
+  for (int i = 0; i < 2000 && host::restarts() == before; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return host::restarts();
+}
+
+void setUp() {
+  // Паузы между попытками (секунды) на ручных часах проходят мгновенно
+  host::setMillis(1000);
+  host::clearFiles();
+  server.dropAfter(0);
+  server.ignoreRange(false);
+}
+
+void tearDown() {
+}
+
+void test_full_download_verifies_hash() {
+  uint32_t restarts = host::restarts();
+  size_t requests = server.ranges().size();
+  TEST_ASSERT_EQUAL(OtaJob::STARTED, otaJob.start(server.url("/firmware.bin").c_str(), imageHash));
+  OtaJob::Status status = waitForJob();
+  TEST_ASSERT_EQUAL_STRING("", status.error);
+  TEST_ASSERT_EQUAL(OtaJob::DONE, status.state);
+  TEST_ASSERT_EQUAL(image.size(), status.written);
+  TEST_ASSERT_EQUAL(0, status.retries);
+  TEST_ASSERT_EQUAL_STRING(imageHash.c_str(), status.sha256);
+  TEST_ASSERT_TRUE(Update.finished());
+  TEST_ASSERT_TRUE(Update.image() == image);
+  TEST_ASSERT_EQUAL(restarts + 1, waitForRestart(restarts));
+  TEST_ASSERT_EQUAL(requests + 1, server.ranges().size());
+}
+
+// Обрыв посреди тела: вторая попытка докачивает остаток через Range
+void test_dropped_connection_resumes_with_range() {
+  uint32_t restarts = host::restarts();
+  server.dropAfter(3000);
+  TEST_ASSERT_EQUAL(OtaJob::STARTED, otaJob.start(server.url("/firmware.bin").c_str(), imageHash));
+  OtaJob::Status status = waitForJob();
+  TEST_ASSERT_EQUAL_STRING("", status.error);
+  TEST_ASSERT_EQUAL(OtaJob::DONE, status.state);
+  TEST_ASSERT_EQUAL(1, status.retries);
+  TEST_ASSERT_TRUE(Update.image() == image);
+  waitForRestart(restarts);
+  std::vector<std::string> ranges = server.ranges();
+  TEST_ASSERT_EQUAL_STRING("", ranges[ranges.size() - 2].c_str());
+  TEST_ASSERT_EQUAL_STRING("bytes=3000-", ranges.back().c_str());
+}
+
+// Сервер ответил 206, но с начала файла: докачка отвергается, загрузка
+// начинается заново без Range, образ не склеивается из двух кусков
+void test_mismatched_content_range_restarts_from_zero() {
+  uint32_t restarts = host::restarts();
+  server.dropAfter(3000);
+  server.ignoreRange(true);
+  TEST_ASSERT_EQUAL(OtaJob::STARTED, otaJob.start(server.url("/firmware.bin").c_str(), imageHash));
+  OtaJob::Status status = waitForJob();
+  TEST_ASSERT_EQUAL_STRING("", status.error);
+  TEST_ASSERT_EQUAL(OtaJob::DONE, status.state);
+  TEST_ASSERT_EQUAL(2, status.retries);
+  TEST_ASSERT_TRUE(Update.image() == image);
+  waitForRestart(restarts);
+  std::vector<std::string> ranges = server.ranges();
+  TEST_ASSERT_EQUAL_STRING("", ranges[ranges.size() - 3].c_str());
+  TEST_ASSERT_EQUAL_STRING("bytes=3000-", ranges[ranges.size() - 2].c_str());
+  TEST_ASSERT_EQUAL_STRING("", ranges.back().c_str());
+}
+
+void test_hash_mismatch_fails() {
+  uint32_t restarts = host::restarts();
+  String wrong = imageHash;
+  wrong = String(wrong[0] == '0' ? "1" : "0") + wrong.substring(1, 64);
+  TEST_ASSERT_EQUAL(OtaJob::STARTED, otaJob.start(server.url("/firmware.bin").c_str(), wrong));
+  OtaJob::Status status = waitForJob();
+  TEST_ASSERT_EQUAL(OtaJob::FAILED, status.state);
+  TEST_ASSERT_EQUAL_STRING("SHA-256 mismatch", status.error);
+  TEST_ASSERT_FALSE(Update.finished());
+  TEST_ASSERT_EQUAL(restarts, host::restarts());
+}
+
+void test_bad_hash_text_is_rejected() {
+  TEST_ASSERT_FALSE(OtaJob::validDigest("abc"));
+  TEST_ASSERT_FALSE(OtaJob::validDigest(String("z") + imageHash.substring(1, 64)));
+  TEST_ASSERT_TRUE(OtaJob::validDigest(imageHash));
+  TEST_ASSERT_TRUE(OtaJob::validDigest(""));
+  TEST_ASSERT_EQUAL(OtaJob::BAD_DIGEST, otaJob.start(server.url("/firmware.bin").c_str(), "abc"));
+  TEST_ASSERT_FALSE(otaJob.busy());
+}
+
+// Раздел OTA занят загрузкой из браузера: отказ с этой причиной, а не
+// "неверный хэш"
+void test_browser_upload_blocks_start() {
+  TEST_ASSERT_TRUE(Update.begin(UPDATE_SIZE_UNKNOWN));
+  TEST_ASSERT_EQUAL(OtaJob::UPLOAD_RUNNING, otaJob.start(server.url("/firmware.bin").c_str(), imageHash));
+  TEST_ASSERT_EQUAL_STRING("browser upload running", OtaJob::startError(OtaJob::UPLOAD_RUNNING));
+  TEST_ASSERT_FALSE(otaJob.busy());
+  Update.abort();
+}
+
+// Одновременные вызовы start() из разных задач: загрузку получает один
+void test_concurrent_start_claims_once() {
+  const int callers = 8;
+  std::atomic<int> accepted(0), busy(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  std::string url = server.url("/firmware.bin");
+  for (int i = 0; i < callers; i++) {
+    threads.emplace_back([&]() {
+      while (!go) {
+      }
+      OtaJob::StartResult result = otaJob.start(url.c_str(), imageHash);
+      if (result == OtaJob::STARTED) accepted++;
+      if (result == OtaJob::BUSY) busy++;
+    });
+  }
+  go = true;
+  for (std::thread &t : threads) t.join();
+  TEST_ASSERT_EQUAL(1, accepted.load());
+  TEST_ASSERT_EQUAL(callers - 1, busy.load());
+  OtaJob::Status status = waitForJob();
+  TEST_ASSERT_EQUAL(OtaJob::DONE, status.state);
+  TEST_ASSERT_TRUE(Update.image() == image);
+}
+
+int main() {
+  host::seedRandom(1);
+  image.resize(20000);
+  for (uint8_t &b : image) b = esp_random();
+  // Не gzip: образ пишется в раздел как есть
+  image[0] = 0xe9;
+  imageHash = sha256Hex(image);
+  server.serve("/firmware.bin", image);
+  if (!server.start()) return 1;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_full_download_verifies_hash);
+  RUN_TEST(test_dropped_connection_resumes_with_range);
+  RUN_TEST(test_mismatched_content_range_restarts_from_zero);
+  RUN_TEST(test_hash_mismatch_fails);
+  RUN_TEST(test_bad_hash_text_is_rejected);
+  RUN_TEST(test_browser_upload_blocks_start);
+  RUN_TEST(test_concurrent_start_claims_once);
+  int failures = UNITY_END();
+  server.stop();
+  return failures;
+}
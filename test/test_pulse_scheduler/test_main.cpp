@@ -0,0 +1,174 @@
+// Планировщик импульсов на ручных часах: service() вызывается с шагом
+// таймера PULSE_TICK_MS, фронты пишутся через setWriter() вместе с
+// моментом записи, так что длительности проверяются точно.
+#include <unity.h>
+#include <vector>
+#include "hal_host.h"
+#include "pulse_scheduler.h"
+
+struct Edge {
+  uint8_t pin;
+  uint8_t level;
+  unsigned long at;
+};
+
+static std::vector<Edge> edges;
+static PulseScheduler *scheduler;
+
+static void recordWrite(uint8_t pin, uint8_t level) {
+  edges.push_back(Edge{pin, level, hal::millis()});
+}
+
+// Тики таймера до момента until включительно
+static void runUntil(unsigned long until) {
+  while (hal::millis() + PULSE_TICK_MS <= until) {
+    host::advanceMillis(PULSE_TICK_MS);
+    scheduler->service(hal::millis());
+  }
+}
+
+static std::vector<Edge> edgesOf(uint8_t pin) {
+  std::vector<Edge> result;
+  for (const Edge &edge : edges) {
+    if (edge.pin == pin) result.push_back(edge);
+  }
+  return result;
+}
+
+void setUp() {
+  host::setMillis(0);
+  edges.clear();
+  scheduler = new PulseScheduler();
+  scheduler->setWriter(recordWrite);
+}
+
+void tearDown() {
+  delete scheduler;
+}
+
+void test_pulse_duration_on_tick_grid() {
+  TEST_ASSERT_TRUE(scheduler->addPin(5));
+  edges.clear();
+  TEST_ASSERT_TRUE(scheduler->request(5, 100));
+  // До первого тика пин не трогается: запрос только ставится в очередь
+  TEST_ASSERT_EQUAL(0, edges.size());
+  TEST_ASSERT_EQUAL(1, scheduler->stats().queued);
+  runUntil(200);
+  std::vector<Edge> pin5 = edgesOf(5);
+  TEST_ASSERT_EQUAL(2, pin5.size());
+  TEST_ASSERT_EQUAL(HIGH, pin5[0].level);
+  TEST_ASSERT_EQUAL(PULSE_TICK_MS, pin5[0].at);
+  TEST_ASSERT_EQUAL(LOW, pin5[1].level);
+  TEST_ASSERT_EQUAL(100, pin5[1].at - pin5[0].at);
+  PulseStats stats = scheduler->stats();
+  TEST_ASSERT_EQUAL(1, stats.completed);
+  TEST_ASSERT_EQUAL(0, stats.active);
+  TEST_ASSERT_EQUAL(0, stats.queued);
+}
+
+// Длительность не кратна тику: импульс заканчивается на первом тике после
+void test_duration_rounds_up_to_tick() {
+  scheduler->addPin(5);
+  edges.clear();
+  scheduler->request(5, 12);
+  runUntil(100);
+  std::vector<Edge> pin5 = edgesOf(5);
+  TEST_ASSERT_EQUAL(2, pin5.size());
+  TEST_ASSERT_EQUAL(15, pin5[1].at - pin5[0].at);
+}
+
+// Запрос на активном пине ждёт конца текущего импульса, последующие
+// запросы до запуска заменяют ожидающий
+void test_pending_request_follows_active_pulse() {
+  scheduler->addPin(5);
+  edges.clear();
+  scheduler->request(5, 50);
+  runUntil(20);
+  TEST_ASSERT_TRUE(scheduler->isActive(5));
+  scheduler->request(5, 30);
+  scheduler->request(5, 40);
+  runUntil(300);
+  std::vector<Edge> pin5 = edgesOf(5);
+  TEST_ASSERT_EQUAL(4, pin5.size());
+  TEST_ASSERT_EQUAL(50, pin5[1].at - pin5[0].at);
+  // Второй импульс стартует на том же тике, где закончился первый
+  TEST_ASSERT_EQUAL(pin5[1].at, pin5[2].at);
+  TEST_ASSERT_EQUAL(HIGH, pin5[2].level);
+  TEST_ASSERT_EQUAL(40, pin5[3].at - pin5[2].at);
+  PulseStats stats = scheduler->stats();
+  TEST_ASSERT_EQUAL(2, stats.completed);
+  TEST_ASSERT_EQUAL(1, stats.replaced);
+}
+
+void test_cancel_and_remove_drive_low() {
+  scheduler->addPin(5);
+  scheduler->addPin(6);
+  scheduler->request(5, 1000);
+  scheduler->request(6, 1000);
+  runUntil(10);
+  edges.clear();
+  scheduler->request(5, 500);
+  TEST_ASSERT_TRUE(scheduler->cancel(5));
+  TEST_ASSERT_TRUE(scheduler->removePin(6));
+  TEST_ASSERT_EQUAL(2, edges.size());
+  TEST_ASSERT_EQUAL(LOW, edges[0].level);
+  TEST_ASSERT_EQUAL(LOW, edges[1].level);
+  // Отменён и отложенный импульс, снятый пин больше не обслуживается
+  runUntil(2000);
+  TEST_ASSERT_EQUAL(2, edges.size());
+  TEST_ASSERT_FALSE(scheduler->owns(6));
+  TEST_ASSERT_FALSE(scheduler->cancel(6));
+}
+
+void test_unowned_pin_is_dropped() {
+  scheduler->addPin(5);
+  TEST_ASSERT_FALSE(scheduler->request(7, 100));
+  TEST_ASSERT_EQUAL(1, scheduler->stats().dropped);
+  runUntil(200);
+  TEST_ASSERT_EQUAL(0, edgesOf(7).size());
+}
+
+// Все пины одновременно с разными длительностями: импульсы не мешают
+// друг другу, лишний пин не принимается
+void test_parallel_pins() {
+  for (int pin = 0; pin < PULSE_MAX_PINS; pin++) TEST_ASSERT_TRUE(scheduler->addPin(pin + 1));
+  TEST_ASSERT_FALSE(scheduler->addPin(PULSE_MAX_PINS + 1));
+  edges.clear();
+  for (int pin = 0; pin < PULSE_MAX_PINS; pin++) scheduler->request(pin + 1, 20 * (pin + 1));
+  runUntil(1000);
+  for (int pin = 0; pin < PULSE_MAX_PINS; pin++) {
+    std::vector<Edge> e = edgesOf(pin + 1);
+    TEST_ASSERT_EQUAL(2, e.size());
+    TEST_ASSERT_EQUAL(PULSE_TICK_MS, e[0].at);
+    TEST_ASSERT_EQUAL(20 * (pin + 1), e[1].at - e[0].at);
+  }
+  TEST_ASSERT_EQUAL(PULSE_MAX_PINS, scheduler->stats().completed);
+}
+
+// Задержка от прихода команды до фронта попадает в гистограмму
+void test_latency_recorded_for_idle_pin() {
+  // received == 0 означает "не учитывать", поэтому часы не с нуля
+  host::setMillis(1000);
+  scheduler->addPin(5);
+  scheduler->request(5, 20, hal::micros());
+  runUntil(1000 + PULSE_TICK_MS);
+  DurationHistogram latency = scheduler->latency();
+  TEST_ASSERT_EQUAL(1, latency.count());
+  TEST_ASSERT_EQUAL(PULSE_TICK_MS * 1000, latency.maxUs());
+  // Ожидание за активным импульсом не считается задержкой прошивки
+  scheduler->request(5, 20, hal::micros());
+  runUntil(1200);
+  TEST_ASSERT_EQUAL(1, scheduler->latency().count());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pulse_duration_on_tick_grid);
+  RUN_TEST(test_duration_rounds_up_to_tick);
+  RUN_TEST(test_pending_request_follows_active_pulse);
+  RUN_TEST(test_cancel_and_remove_drive_low);
+  RUN_TEST(test_unowned_pin_is_dropped);
+  RUN_TEST(test_parallel_pins);
+  RUN_TEST(test_latency_recorded_for_idle_pin);
+  return UNITY_END();
+}
@@ -0,0 +1,354 @@
+// Симуляция soak-прогона (shared/soak.py) на хосте, без платы и брокера.
+// Поток "брокера" шлёт команды MQTT с заданной частотой, сетевая задача
+// передаёт их handleMqttMessage() из handlers.cpp, задача исполнительных
+// механизмов ставит импульсы в PulseScheduler, таймер которого работает в
+// реальном времени. Параллельно потоки "HTTP" отрисовывают под ConfigLock
+// тела /api/state, /button_state, /temp и /metrics теми же функциями, что
+// и веб-сервер, и дёргают handleTrigger() на отдельном пине. Статические
+// страницы (/) отдаёт веб-сервер из LittleFS, на хосте их нет. Фронты на
+// пинах снимаются хуком записи GPIO.
+// Итог - один JSON, как у soak.py: p50/p99 задержки команды до фронта,
+// длительности импульсов, потери, выделения памяти.
+//
+// Длительность задаётся PCC_SOAK_SECONDS (по умолчанию 3 с), JSON также
+// пишется в файл PCC_SOAK_OUTPUT, если он задан.
+#include <unity.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "hal_host.h"
+#include "handlers.h"
+#include "input_engine.h"
+#include "pulse_scheduler.h"
+#include "tasks.h"
+#include "temp_sampler.h"
+#include "topic_index.h"
+
+static const int mqttPin = 10;
+static const int triggerPin = 11;
+static const int doorPin = 12;
+static const char *mqttTopic = "soak/hall/pump/set";
+// Импульс короче периода команд: на свободном пине замен быть не должно
+static const uint32_t pulseMs = 20;
+static const uint32_t mqttPeriodMs = 50;
+static const uint32_t triggerPeriodMs = 120;
+static const int httpClients = 4;
+
+// Фронты пишет таймер планировщика, поэтому место под них выделено заранее
+struct PinTrace {
+  std::atomic<uint32_t> sentAt{0};  // micros() последней команды на пин
+  std::atomic<uint32_t> risingAt{0};
+  std::vector<uint32_t> latencyUs;
+  std::vector<uint32_t> widthUs;
+  std::atomic<size_t> rising{0};
+  std::atomic<size_t> falling{0};
+};
+
+static PinTrace traces[2];
+static std::atomic<bool> running(false);
+
+static PinTrace *traceOf(int pin) {
+  return pin == mqttPin ? &traces[0] : pin == triggerPin ? &traces[1] : nullptr;
+}
+
+static void onWrite(int pin, int level, unsigned long us) {
+  PinTrace *trace = traceOf(pin);
+  if (!trace || !running) return;
+  if (level == HIGH) {
+    size_t n = trace->rising++;
+    if (n < trace->latencyUs.size()) trace->latencyUs[n] = (uint32_t)us - trace->sentAt;
+    trace->risingAt = us;
+  } else {
+    size_t n = trace->falling++;
+    if (n < trace->widthUs.size()) trace->widthUs[n] = (uint32_t)us - trace->risingAt;
+  }
+}
+
+// Входящие сообщения MQTT между "брокером" и сетевой задачей
+struct InboxMessage {
+  uint32_t sentAt;
+};
+static BoundedQueue<InboxMessage, 8> inbox;
+
+static void actuationTask(void *) {
+  while (running) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ACTUATION_TICK_MS));
+    ActuationCommand command;
+    while (actuationQueue.pop(command)) {
+      pulses.request(command.pin, command.duration, command.received);
+    }
+  }
+}
+
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t len) override { return len; }
+  using Print::write;
+};
+
+struct RouteSamples {
+  const char *name;
+  std::vector<uint32_t> us;
+  size_t count = 0;
+  void add(uint32_t value) {
+    if (count < us.size()) us[count] = value;
+    count++;
+  }
+};
+
+// Два датчика на одной шине, оба показывают 21.5 °C
+class SoakBus : public TempBus {
+public:
+  uint8_t search(TempAddress *found, uint8_t max) override {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < 2 && n < max; i++) {
+      const TempAddress address = {0x28, 0x50, 0x4b, 0x00, 0x00, 0x00, i, 0x00};
+      memcpy(found[n++], address, sizeof(TempAddress));
+    }
+    return n;
+  }
+  bool setResolution(const uint8_t *, uint8_t) override { return true; }
+  void requestConversion() override {}
+  float read(const uint8_t *) override { return 21.5; }
+};
+
+static uint32_t quantile(std::vector<uint32_t> values, size_t count, double q) {
+  count = std::min(count, values.size());
+  if (!count) return 0;
+  values.resize(count);
+  std::sort(values.begin(), values.end());
+  return values[std::min(count - 1, (size_t)(q * count))];
+}
+
+static unsigned long soakSeconds() {
+  const char *text = getenv("PCC_SOAK_SECONDS");
+  unsigned long seconds = text ? strtoul(text, nullptr, 10) : 0;
+  return seconds ? seconds : 3;
+}
+
+static void configure() {
+  config = Config();
+  const int pins[] = {mqttPin, triggerPin};
+  for (int i = 0; i < 2; i++) {
+    ButtonConfig button;
+    char text[64];
+    snprintf(text, sizeof(text), "soak-%d", pins[i]);
+    button.name = text;
+    button.topic = i == 0 ? mqttTopic : "soak/hall/trigger-only/set";
+    button.pin = pins[i];
+    button.duration = pulseMs;
+    button.mode = OUTPUT;
+    config.buttons.push_back(button);
+  }
+  // Вход для /button_state и /api/state
+  ButtonConfig door;
+  door.name = "soak-door";
+  door.pin = doorPin;
+  door.duration = 0;
+  door.mode = INPUT_PULLUP;
+  door.debounce = 20;
+  config.buttons.push_back(door);
+  topicIndex.build(config.buttons);
+  pulses.clear();
+  inputs.clear();
+  for (size_t i = 0; i < config.buttons.size(); i++) {
+    const ButtonConfig &button = config.buttons[i];
+    if (button.mode == OUTPUT) {
+      pulses.addPin(button.pin);
+    } else {
+      inputs.addPin(i, button.pin, button.debounce);
+    }
+  }
+  static SoakBus bus;
+  tempSampler.clear();
+  tempSampler.addBus(&bus);
+  tempSampler.loop(TEMP_SAMPLE_INTERVAL);
+  tempSampler.loop(2 * TEMP_SAMPLE_INTERVAL);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_soak() {
+  unsigned long seconds = soakSeconds();
+  size_t expectedMqtt = seconds * 1000 / mqttPeriodMs + 2;
+  size_t expectedTrigger = seconds * 1000 / triggerPeriodMs + 2;
+  traces[0].latencyUs.assign(expectedMqtt, 0);
+  traces[0].widthUs.assign(expectedMqtt, 0);
+  traces[1].latencyUs.assign(expectedTrigger, 0);
+  traces[1].widthUs.assign(expectedTrigger, 0);
+  std::vector<RouteSamples> routes(5);
+  routes[0].name = "/api/state";
+  routes[1].name = "/button_state";
+  routes[2].name = "/temp";
+  routes[3].name = "/metrics";
+  routes[4].name = "/trigger";
+  for (RouteSamples &route : routes) route.us.assign(200000 * seconds, 0);
+
+  configure();
+  host::onGpioWrite(onWrite);
+  pulses.begin();
+  running = true;
+  startTask(TASK_ACTUATION, actuationTask);
+
+  std::atomic<uint32_t> mqttSent(0), mqttRejected(0), triggerSent(0), triggerRejected(0), httpRequests(0);
+  std::vector<std::thread> threads;
+  std::atomic<bool> loadRunning(true);
+  std::mutex routesLock;
+
+  // Сетевая задача: забирает сообщения "брокера" и раздаёт их
+  threads.emplace_back([&]() {
+    static const uint8_t payload[] = "20";
+    while (loadRunning || inbox.size()) {
+      InboxMessage message;
+      if (!inbox.pop(message)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        continue;
+      }
+      handleMqttMessage(mqttTopic, payload, sizeof(payload) - 1);
+    }
+  });
+
+  // "HTTP": тела страниц под ConfigLock, как обработчики через timed()
+  for (int c = 0; c < httpClients; c++) {
+    threads.emplace_back([&, c]() {
+      NullPrint out;
+      for (uint32_t i = c; loadRunning; i++) {
+        size_t route = i % 4;
+        auto started = std::chrono::steady_clock::now();
+        if (route == 3) {
+          // /metrics config не читает и идёт без блокировки
+          renderMetrics(out);
+        } else {
+          ConfigLock lock;
+          unsigned long now = millis();
+          if (route == 0) renderApiState(out, now, nullptr);
+          if (route == 1) renderButtonState(out, now);
+          if (route == 2) renderTemperature(out, now);
+        }
+        uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+        {
+          std::lock_guard<std::mutex> guard(routesLock);
+          routes[route].add(us);
+        }
+        httpRequests++;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    });
+  }
+
+  // /trigger на своём пине: его импульсы не заменяют импульсы MQTT
+  threads.emplace_back([&]() {
+    char pin[8], duration[16], message[64];
+    snprintf(pin, sizeof(pin), "%d", triggerPin);
+    snprintf(duration, sizeof(duration), "%u", pulseMs);
+    auto next = std::chrono::steady_clock::now();
+    while (loadRunning) {
+      next += std::chrono::milliseconds(triggerPeriodMs);
+      std::this_thread::sleep_until(next);
+      auto started = std::chrono::steady_clock::now();
+      traceOf(triggerPin)->sentAt = micros();
+      {
+        ConfigLock lock;
+        (handleTrigger(pin, duration, message, sizeof(message)) == 200 ? triggerSent : triggerRejected)++;
+      }
+      uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+      std::lock_guard<std::mutex> guard(routesLock);
+      routes[4].add(us);
+    }
+  });
+
+  // Прогрев: потоки запущены, статические буферы заполнены
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  PulseStats startStats = pulses.stats();
+  uint32_t startAllocs = host::allocations();
+  uint32_t startLive = host::liveBlocks();
+  uint32_t startDropped = actuationQueue.dropped();
+
+  // "Брокер": команды с фиксированным периодом
+  auto began = std::chrono::steady_clock::now();
+  auto next = began;
+  while (std::chrono::steady_clock::now() - began < std::chrono::seconds(seconds)) {
+    next += std::chrono::milliseconds(mqttPeriodMs);
+    std::this_thread::sleep_until(next);
+    uint32_t sentAt = micros();
+    traceOf(mqttPin)->sentAt = sentAt;
+    (inbox.push(InboxMessage{sentAt}) ? mqttSent : mqttRejected)++;
+  }
+  // Куча снимается под нагрузкой: завершение потоков освобождает их память
+  uint32_t allocs = host::allocations() - startAllocs;
+  int32_t liveDrift = (int32_t)(host::liveBlocks() - startLive);
+  loadRunning = false;
+  for (std::thread &t : threads) t.join();
+  // Последние импульсы успевают закончиться
+  std::this_thread::sleep_for(std::chrono::milliseconds(pulseMs * 3));
+  running = false;
+  wakeTask(TASK_ACTUATION);
+
+  PulseStats endStats = pulses.stats();
+  DurationHistogram firmwareLatency = pulses.latency();
+  PinTrace &mqtt = traces[0], &trigger = traces[1];
+  char json[2048];
+  int n = snprintf(json, sizeof(json),
+    "{\"run_seconds\":%lu,"
+    "\"commands\":{\"mqtt_sent\":%u,\"mqtt_rejected\":%u,\"edges\":%u,"
+    "\"latency_p50_us\":%u,\"latency_p99_us\":%u,\"latency_max_us\":%u,"
+    "\"width_p50_us\":%u,\"width_max_us\":%u,"
+    "\"firmware_p50_us\":%u,\"firmware_p99_us\":%u,"
+    "\"dropped_queue\":%u,\"dropped_pin\":%u,\"replaced\":%u},"
+    "\"trigger\":{\"sent\":%u,\"rejected\":%u,\"edges\":%u,\"latency_p99_us\":%u},"
+    "\"http\":{\"requests\":%u",
+    seconds, mqttSent.load(), mqttRejected.load(), (unsigned)mqtt.rising.load(),
+    quantile(mqtt.latencyUs, mqtt.rising, 0.5), quantile(mqtt.latencyUs, mqtt.rising, 0.99),
+    quantile(mqtt.latencyUs, mqtt.rising, 1.0), quantile(mqtt.widthUs, mqtt.falling, 0.5),
+    quantile(mqtt.widthUs, mqtt.falling, 1.0), firmwareLatency.quantileUs(0.5f), firmwareLatency.quantileUs(0.99f),
+    actuationQueue.dropped() - startDropped, endStats.dropped - startStats.dropped,
+    endStats.replaced - startStats.replaced, triggerSent.load(), triggerRejected.load(),
+    (unsigned)trigger.rising.load(), quantile(trigger.latencyUs, trigger.rising, 0.99), httpRequests.load());
+  for (const RouteSamples &route : routes) {
+    n += snprintf(json + n, sizeof(json) - n, ",\"%s\":{\"p50_us\":%u,\"p99_us\":%u}", route.name,
+                  quantile(route.us, route.count, 0.5), quantile(route.us, route.count, 0.99));
+  }
+  snprintf(json + n, sizeof(json) - n, "},\"heap\":{\"allocs\":%u,\"blocks_drift\":%d}}", allocs, liveDrift);
+  printf("%s\n", json);
+  if (const char *path = getenv("PCC_SOAK_OUTPUT")) {
+    if (FILE *file = fopen(path, "w")) {
+      fprintf(file, "%s\n", json);
+      fclose(file);
+    }
+  }
+
+  // Каждая команда дала ровно один импульс нужной длины
+  TEST_ASSERT_EQUAL(0, mqttRejected.load());
+  TEST_ASSERT_EQUAL(mqttSent.load(), mqtt.rising.load());
+  TEST_ASSERT_EQUAL(mqtt.rising.load(), mqtt.falling.load());
+  TEST_ASSERT_EQUAL(triggerSent.load(), trigger.rising.load());
+  TEST_ASSERT_EQUAL(0, actuationQueue.dropped() - startDropped);
+  TEST_ASSERT_EQUAL(0, endStats.dropped - startStats.dropped);
+  TEST_ASSERT_EQUAL(0, endStats.replaced - startStats.replaced);
+  // Длительность - с точностью до тика, таймер хоста тоже дрожит
+  TEST_ASSERT_GREATER_THAN((pulseMs - PULSE_TICK_MS) * 1000, quantile(mqtt.widthUs, mqtt.falling, 0.5));
+  TEST_ASSERT_LESS_THAN((pulseMs + PULSE_TICK_MS) * 1000, quantile(mqtt.widthUs, mqtt.falling, 0.5));
+  // Фронт ждёт тика таймера (PULSE_TICK_MS); остальное - с запасом на
+  // загруженную машину CI
+  TEST_ASSERT_LESS_THAN(PULSE_TICK_MS * 1000 + 5000, quantile(mqtt.latencyUs, mqtt.rising, 0.5));
+  TEST_ASSERT_LESS_THAN(50000, quantile(mqtt.latencyUs, mqtt.rising, 0.99));
+  // Горячие пути команды и страниц не выделяют память
+  TEST_ASSERT_EQUAL(0, allocs);
+  TEST_ASSERT_EQUAL(0, liveDrift);
+}
+
+int main() {
+  // Журнал обработчиков не должен попадать в замер
+  host::muteSerial(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_soak);
+  return UNITY_END();
+}
@@ -0,0 +1,226 @@
+// Агент обновлений против HostHttpServer: манифест с ETag, загрузка
+// прошивки через настоящий OtaJob, время UTC и сеть задаёт тест.
+#include <unity.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <chrono>
+#include <thread>
+#include "config.h"
+#include "hal_host.h"
+#include "host_http.h"
+#include "ota_job.h"
+#include "update_agent.h"
+#include "version.h"
+
+// 2026-01-01 00:00:00 UTC
+#define NEW_YEAR 1767225600
+#define HOUR 3600
+
+static HostHttpServer server;
+static std::vector<uint8_t> image;
+static String imageHash;
+static UpdateAgent *agent;
+
+static String sha256Hex(const std::vector<uint8_t> &data) {
+  mbedtls_sha256_context ctx;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, data.data(), data.size());
+  mbedtls_sha256_finish(&ctx, digest);
+  char hex[65];
+  for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  return String(hex);
+}
+
+static void serveManifest(const char *version, const char *path, const char *sha256, const char *etag) {
+  char text[256];
+  snprintf(text, sizeof(text), "{\"version\":\"%s\",\"url\":\"%s\",\"sha256\":\"%s\"}", version,
+           server.url(path).c_str(), sha256);
+  server.serve("/manifest.json", std::vector<uint8_t>(text, text + strlen(text)), etag);
+}
+
+// Проверка идёт в своей задаче; ждём её по реальному времени
+static void waitForCheck() {
+  for (int i = 0; i < 5000 && agent->checking(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  TEST_ASSERT_FALSE_MESSAGE(agent->checking(), "manifest check did not finish");
+}
+
+static UpdateAgent::Result checkNow() {
+  agent->checkNow();
+  agent->loop(hal::millis());
+  waitForCheck();
+  return agent->result();
+}
+
+static void waitForJob() {
+  for (int i = 0; i < 20000 && otaJob.busy(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  TEST_ASSERT_FALSE_MESSAGE(otaJob.busy(), "OTA job did not finish");
+}
+
+void setUp() {
+  host::setMillis(1000);
+  host::setNetworkUp(true);
+  host::setUtcTime(NEW_YEAR + 3 * HOUR);
+  host::seedRandom(1);
+  config = Config();
+  config.update_url = server.url("/manifest.json").c_str();
+  config.update_interval = 60;
+  agent = new UpdateAgent();
+}
+
+void tearDown() {
+  delete agent;
+}
+
+// Манифест не менялся: 304 по сохранённому ETag, загрузка не начинается
+void test_matching_etag_gets_not_modified() {
+  serveManifest(FIRMWARE_VERSION, "/firmware.bin", "", "\"v1\"");
+  size_t requests = server.etags().size();
+  TEST_ASSERT_EQUAL(UpdateAgent::UP_TO_DATE, checkNow());
+  TEST_ASSERT_EQUAL_STRING(FIRMWARE_VERSION, agent->latestVersion());
+  TEST_ASSERT_EQUAL(UpdateAgent::NOT_MODIFIED, checkNow());
+  std::vector<std::string> etags = server.etags();
+  TEST_ASSERT_EQUAL(requests + 2, etags.size());
+  TEST_ASSERT_EQUAL_STRING("", etags[requests].c_str());
+  TEST_ASSERT_EQUAL_STRING("\"v1\"", etags.back().c_str());
+  TEST_ASSERT_FALSE(otaJob.busy());
+}
+
+// Новая версия, но установка не началась или сорвалась: ETag не
+// запоминается, и следующая проверка снова получает манифест целиком
+void test_etag_not_stored_when_install_fails_or_is_deferred() {
+  serveManifest("9.0.0", "/firmware.bin", "not-a-digest", "\"v2\"");
+  TEST_ASSERT_EQUAL(UpdateAgent::FAILED, checkNow());
+  TEST_ASSERT_EQUAL_STRING("9.0.0", agent->latestVersion());
+
+  // Загрузка через браузер откладывает установку
+  serveManifest("9.0.0", "/firmware.bin", imageHash.c_str(), "\"v2\"");
+  TEST_ASSERT_TRUE(Update.begin(UPDATE_SIZE_UNKNOWN));
+  TEST_ASSERT_EQUAL(UpdateAgent::FAILED, checkNow());
+  Update.abort();
+  TEST_ASSERT_EQUAL_STRING("", server.etags().back().c_str());
+
+  // Загрузка запустилась, но образа на сервере нет
+  serveManifest("9.0.0", "/missing.bin", "", "\"v2\"");
+  TEST_ASSERT_EQUAL(UpdateAgent::UPDATE_STARTED, checkNow());
+  waitForJob();
+  TEST_ASSERT_EQUAL(OtaJob::FAILED, otaJob.status().state);
+  TEST_ASSERT_EQUAL(UpdateAgent::UPDATE_STARTED, checkNow());
+  waitForJob();
+  TEST_ASSERT_EQUAL_STRING("", server.etags().back().c_str());
+}
+
+// Первая проверка через минуту плюс разброс, следующие - через интервал
+// плюс разброс и только внутри окна обслуживания
+void test_checks_scheduled_in_window_with_jitter() {
+  serveManifest(FIRMWARE_VERSION, "/firmware.bin", "", "\"v3\"");
+  config.update_jitter = 10;
+  config.update_window_start = 2;
+  config.update_window_end = 4;
+  unsigned long now = hal::millis();
+  unsigned long jitter = 10 * 60000UL;
+
+  agent->begin(now);
+  unsigned long first = agent->nextCheckIn(now);
+  TEST_ASSERT_TRUE(first >= 60000 && first < 60000 + jitter);
+  size_t requests = server.etags().size();
+  agent->loop(now + first - 1);
+  TEST_ASSERT_FALSE(agent->checking());
+  TEST_ASSERT_EQUAL(requests, server.etags().size());
+
+  now += first;
+  agent->loop(now);
+  waitForCheck();
+  TEST_ASSERT_EQUAL(UpdateAgent::UP_TO_DATE, agent->result());
+  TEST_ASSERT_EQUAL(now, agent->lastCheckAt());
+  unsigned long next = agent->nextCheckIn(now);
+  TEST_ASSERT_TRUE(next >= 60 * 60000UL && next < 60 * 60000UL + jitter);
+
+  // Разброс у разных устройств разный
+  UpdateAgent other;
+  other.begin(now);
+  TEST_ASSERT_NOT_EQUAL(first, other.nextCheckIn(now));
+
+  // Окно закрыто: запроса нет, повтор через UPDATE_RETRY_DELAY
+  host::setUtcTime(NEW_YEAR + 5 * HOUR);
+  now += next;
+  agent->loop(now);
+  TEST_ASSERT_FALSE(agent->checking());
+  TEST_ASSERT_EQUAL(UpdateAgent::OUTSIDE_WINDOW, agent->result());
+  TEST_ASSERT_EQUAL(UPDATE_RETRY_DELAY, agent->nextCheckIn(now));
+  TEST_ASSERT_EQUAL(requests + 1, server.etags().size());
+
+  // Окно через полночь и несинхронизированные часы
+  config.update_window_start = 22;
+  config.update_window_end = 3;
+  host::setUtcTime(1000);
+  now += UPDATE_RETRY_DELAY;
+  agent->loop(now);
+  TEST_ASSERT_EQUAL(UpdateAgent::OUTSIDE_WINDOW, agent->result());
+  host::setUtcTime(NEW_YEAR + 23 * HOUR);
+  now += UPDATE_RETRY_DELAY;
+  agent->loop(now);
+  waitForCheck();
+  TEST_ASSERT_EQUAL(UpdateAgent::NOT_MODIFIED, agent->result());
+  TEST_ASSERT_EQUAL(requests + 2, server.etags().size());
+}
+
+// Без сети проверка откладывается, окно не учитывается
+void test_no_network_defers_check() {
+  serveManifest(FIRMWARE_VERSION, "/firmware.bin", "", "\"v4\"");
+  host::setNetworkUp(false);
+  size_t requests = server.etags().size();
+  unsigned long now = hal::millis();
+  agent->checkNow();
+  agent->loop(now);
+  TEST_ASSERT_FALSE(agent->checking());
+  TEST_ASSERT_EQUAL(UPDATE_RETRY_DELAY, agent->nextCheckIn(now));
+  TEST_ASSERT_EQUAL(requests, server.etags().size());
+  host::setNetworkUp(true);
+  agent->loop(now + UPDATE_RETRY_DELAY);
+  waitForCheck();
+  TEST_ASSERT_EQUAL(UpdateAgent::UP_TO_DATE, agent->result());
+}
+
+// Новая версия в манифесте: OtaJob скачивает и проверяет образ
+void test_newer_version_starts_ota_job() {
+  serveManifest("9.0.0", "/firmware.bin", imageHash.c_str(), "\"v5\"");
+  uint32_t restarts = host::restarts();
+  TEST_ASSERT_EQUAL(UpdateAgent::UPDATE_STARTED, checkNow());
+  waitForJob();
+  OtaJob::Status status = otaJob.status();
+  TEST_ASSERT_EQUAL_STRING("", status.error);
+  TEST_ASSERT_EQUAL(OtaJob::DONE, status.state);
+  TEST_ASSERT_TRUE(Update.image() == image);
+  std::vector<std::string> ranges = server.ranges();
+  TEST_ASSERT_EQUAL_STRING("", ranges.back().c_str());
+  for (int i = 0; i < 2000 && host::restarts() == restarts; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  TEST_ASSERT_EQUAL(restarts + 1, host::restarts());
+}
+
+int main() {
+  host::seedRandom(1);
+  image.resize(20000);
+  for (uint8_t &b : image) b = esp_random();
+  image[0] = 0xe9;
+  imageHash = sha256Hex(image);
+  server.serve("/firmware.bin", image);
+  if (!server.start()) return 1;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_matching_etag_gets_not_modified);
+  RUN_TEST(test_etag_not_stored_when_install_fails_or_is_deferred);
+  RUN_TEST(test_checks_scheduled_in_window_with_jitter);
+  RUN_TEST(test_no_network_defers_check);
+  RUN_TEST(test_newer_version_starts_ota_job);
+  int failures = UNITY_END();
+  server.stop();
+  return failures;
+}
@@ -0,0 +1,131 @@
+// Кэш сканирования Wi-Fi против сканирования-заглушки из WiFi.h: loop()
+// вызывается как из сетевой задачи, завершение сканирования задаёт тест.
+#include <unity.h>
+#include <WiFi.h>
+#include "hal_host.h"
+#include "wifi_scan.h"
+
+static WifiScanner *scanner;
+static unsigned long now;
+
+// Тик сетевой задачи
+static void tick(unsigned long ms = 10) {
+  now += ms;
+  scanner->loop(now);
+}
+
+void setUp() {
+  now = 1000;
+  host::setScanResults({{"home", -60, 6, WIFI_AUTH_WPA2_PSK}, {"cafe", -80, 1, WIFI_AUTH_OPEN}});
+  host::finishScan(false);
+  scanner = new WifiScanner();
+  scanner->setTtl(60);
+}
+
+void tearDown() {
+  delete scanner;
+}
+
+void test_request_starts_one_scan() {
+  uint32_t starts = host::scanStarts();
+  TEST_ASSERT_FALSE(scanner->request(now));
+  TEST_ASSERT_TRUE(scanner->scanning());
+  tick();
+  TEST_ASSERT_EQUAL(starts + 1, host::scanStarts());
+  host::finishScan();
+  tick();
+  TEST_ASSERT_FALSE(scanner->scanning());
+  TEST_ASSERT_TRUE(scanner->hasResults());
+  ScanNetwork networks[SCAN_MAX_NETWORKS];
+  TEST_ASSERT_EQUAL(2, scanner->snapshot(networks, SCAN_MAX_NETWORKS));
+  TEST_ASSERT_EQUAL_STRING("home", networks[0].ssid.c_str());
+  TEST_ASSERT_EQUAL(-60, networks[0].rssi);
+  TEST_ASSERT_EQUAL_STRING("wpa2", WifiScanner::authName(networks[0].auth));
+  TEST_ASSERT_TRUE(scanner->request(now));
+  tick();
+  TEST_ASSERT_EQUAL(starts + 1, host::scanStarts());
+}
+
+// Запросы во время сканирования ждут его результатов: после завершения
+// второе сканирование не запускается
+void test_requests_share_scan_in_flight() {
+  uint32_t starts = host::scanStarts();
+  scanner->request(now);
+  tick();
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_FALSE(scanner->request(now));
+    tick();
+  }
+  host::finishScan();
+  tick();
+  for (int i = 0; i < 10; i++) tick();
+  TEST_ASSERT_EQUAL(starts + 1, host::scanStarts());
+  TEST_ASSERT_EQUAL(1, scanner->scans());
+  TEST_ASSERT_FALSE(scanner->scanning());
+}
+
+// Кэш устарел: новое сканирование только по запросу, старые сети
+// отдаются до его завершения
+void test_stale_cache_rescans_on_request() {
+  uint32_t starts = host::scanStarts();
+  scanner->request(now);
+  tick();
+  host::finishScan();
+  tick();
+  tick(61000);
+  TEST_ASSERT_EQUAL(starts + 1, host::scanStarts());
+  TEST_ASSERT_FALSE(scanner->request(now));
+  tick();
+  TEST_ASSERT_EQUAL(starts + 2, host::scanStarts());
+  ScanNetwork networks[SCAN_MAX_NETWORKS];
+  TEST_ASSERT_EQUAL(2, scanner->snapshot(networks, SCAN_MAX_NETWORKS));
+  host::finishScan();
+  tick();
+  TEST_ASSERT_TRUE(scanner->request(now));
+}
+
+// Ошибка драйвера: кэша нет, следующий запрос пробует снова
+void test_failed_scan_retries_on_next_request() {
+  uint32_t starts = host::scanStarts();
+  scanner->request(now);
+  tick();
+  host::finishScan(false);
+  tick();
+  TEST_ASSERT_FALSE(scanner->scanning());
+  TEST_ASSERT_FALSE(scanner->hasResults());
+  tick();
+  TEST_ASSERT_EQUAL(starts + 1, host::scanStarts());
+  scanner->request(now);
+  tick();
+  TEST_ASSERT_EQUAL(starts + 2, host::scanStarts());
+  host::finishScan();
+  tick();
+}
+
+// Повторы SSID сводятся к самой сильной точке, порядок - по RSSI
+void test_duplicate_ssids_keep_strongest() {
+  host::setScanResults({{"home", -70, 1, WIFI_AUTH_WPA2_PSK},
+                        {"cafe", -50, 11, WIFI_AUTH_OPEN},
+                        {"home", -40, 6, WIFI_AUTH_WPA2_PSK},
+                        {"", -30, 3, WIFI_AUTH_OPEN}});
+  scanner->request(now);
+  tick();
+  host::finishScan();
+  tick();
+  ScanNetwork networks[SCAN_MAX_NETWORKS];
+  TEST_ASSERT_EQUAL(2, scanner->snapshot(networks, SCAN_MAX_NETWORKS));
+  TEST_ASSERT_EQUAL_STRING("home", networks[0].ssid.c_str());
+  TEST_ASSERT_EQUAL(-40, networks[0].rssi);
+  TEST_ASSERT_EQUAL(6, networks[0].channel);
+  TEST_ASSERT_EQUAL_STRING("cafe", networks[1].ssid.c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_request_starts_one_scan);
+  RUN_TEST(test_requests_share_scan_in_flight);
+  RUN_TEST(test_stale_cache_rescans_on_request);
+  RUN_TEST(test_failed_scan_retries_on_next_request);
+  RUN_TEST(test_duplicate_ssids_keep_strongest);
+  return UNITY_END();
+}